@@ -1,46 +1,149 @@
 #include "Engine.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
 #include "Window.h"
 #include "Input.h"
 #include "Renderer.h"
+#include "Utilities/JobSystem.h"
+#include "Utilities/Clock.h"
+#include "Utilities/Profiler.h"
+#include "Utilities/Benchmark.h"
+#include "Math/MathBenchmark.h"
+#include "Rendering/AssetPacker.h"
+#include "Shaders/ShaderStructures.h"
+
+#define SIMULATION_RATE 60.0 // fixed steps per second
+#define FRAME_RATE_LIMIT 0.0 // frames per second, 0 leaves it to the present mode
+#define TURN_SPEED 6.0f // radians per second
+#define DEFAULT_TRACE_PATH "trace.json"
+#define DEFAULT_SCREENSHOT_PATH "screenshot.png"
+#define DEFAULT_HEADLESS_FRAMES 100
+#define DEFAULT_BENCHMARK_PATH "benchmark.json"
+#define DEFAULT_ARCHIVE_PATH "assets.pak"
+#define BENCHMARK_FRAMES 600 // measured
+#define BENCHMARK_WARMUP_FRAMES 60 // and every texture uploaded
+#define BENCHMARK_SPRITES 1000
+#define BENCHMARK_TEXTURES 16
 
 Window Engine::m_window;
 Input Engine::m_input;
 Renderer Engine::m_renderer;
+JobSystem Engine::m_jobs;
+Clock Engine::m_clock;
+EngineOptions Engine::m_options;
+Benchmark Engine::m_benchmark;
 
 bool cycled = false;
+bool traced = false;
 
-void Engine::init()
+bool Engine::init()
 {
-    m_window.init();
-    m_input.init(m_window.Get());
+    Profiler::init();
+    Profiler::setThreadName("Main");
+    m_jobs.init(); // the main thread becomes worker 0
+    if (!m_options.headless) m_window.init();
+    m_input.init(m_options.headless ? nullptr : m_window.Get());
     m_renderer.init();
+    m_clock.init(SIMULATION_RATE, FRAME_RATE_LIMIT); // after the slow inits so the first frame isn't a catch up
+    // Headless runs are compared image to image, one step per frame whatever the machine
+    if (m_options.headless) m_clock.setFrameTime(m_clock.fixedDelta());
+
+    if (m_options.benchmarkPath)
+    {
+        BenchmarkScene scene;
+        scene.sprites = m_options.sprites;
+        scene.textures = m_options.textures;
+#if EDITOR
+        scene.wireframe = m_options.wireframe;
+#else
+        scene.wireframe = false; // no wireframe pipeline
+#endif
+        scene.imgui = m_options.imgui;
+        scene.pipelined = true;
+        if (!m_renderer.startBenchmark(m_benchmark, scene))
+        {
+            m_options.benchmarkPath = nullptr; // nothing was measured or rendered
+            m_options.screenshotPath = nullptr;
+            return false;
+        }
+    }
+    return true;
 }
 
 void Engine::cleanup()
 {
+    if (m_options.screenshotPath && m_renderer.saveScreenshot(m_options.screenshotPath))
+    {
+        std::cout << "Wrote " << m_options.screenshotPath << std::endl;
+    }
     m_renderer.cleanup();
+    if (m_options.tracePath) Profiler::writeChromeTrace(m_options.tracePath); // the render thread has been joined
+    if (m_options.benchmarkPath)
+    {
+        if (m_benchmark.write(m_options.benchmarkPath)) std::cout << "Wrote " << m_options.benchmarkPath << std::endl;
+        m_benchmark.cleanup();
+    }
     m_input.cleanup();
-    m_window.cleanup();
+    if (!m_options.headless) m_window.cleanup();
+    m_jobs.cleanup();
+    Profiler::cleanup();
 }
 
 void Engine::update()
 {
-    m_window.update();
+    Profiler::beginFrame();
+    PROFILE_ZONE("Engine::update");
+    uint64_t frameStart = Profiler::now();
+    m_clock.tick();
+    if (!m_options.headless) m_window.update();
     m_input.update();
-    gameUpdate();
-    m_renderer.update();
+
+    if (m_input.isKeyPressed(301) && !traced) // F12
+    {
+        traced = true;
+        char path[64];
+        snprintf(path, sizeof(path), "trace_%llu.json", (unsigned long long)m_clock.frame());
+        if (Profiler::writeChromeTrace(path)) std::cout << "Wrote " << path << std::endl;
+    } else if (m_input.isKeyReleased(301)) {
+        traced = false;
+    }
+    {
+        PROFILE_ZONE("Simulate");
+        while (m_clock.advance())
+        {
+            m_renderer.step(); // keeps the previous step around to interpolate from
+            gameUpdate(m_clock.fixedDelta());
+        }
+    }
+    m_renderer.update(); // draws at m_clock.alpha() between the last two steps
+    {
+        PROFILE_ZONE("Pace");
+        m_clock.pace();
+    }
+
+    if (m_options.benchmarkPath)
+    {
+        m_benchmark.frame((Profiler::now() - frameStart) / 1e6);
+        if (!m_benchmark.isMeasuring() && m_clock.frame() >= BENCHMARK_WARMUP_FRAMES && m_renderer.m_assets.pendingCount() == 0)
+        {
+            m_benchmark.start();
+        }
+    }
 }
 
-void Engine::gameUpdate()
+void Engine::gameUpdate(float deltaTime)
 {
     // TODO: remove
     if (m_input.isKeyPressed(65))
     {
-        m_renderer.angle += 0.1;
+        m_renderer.angle += TURN_SPEED * deltaTime;
     } else if (m_input.isKeyPressed(68))
     {
-        m_renderer.angle -= 0.1;
+        m_renderer.angle -= TURN_SPEED * deltaTime;
     }
 
     if (m_input.isKeyPressed(32) && !cycled)
@@ -52,12 +155,115 @@ void Engine::gameUpdate()
     }
 }
 
-void Engine::run()
+bool Engine::parseOptions(int argc, char** argv)
+{
+    m_options = {};
+    m_options.sprites = BENCHMARK_SPRITES;
+    m_options.textures = BENCHMARK_TEXTURES;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--trace") == 0)
+        {
+            m_options.tracePath = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : DEFAULT_TRACE_PATH;
+        }
+        else if (strcmp(argv[i], "--headless") == 0)
+        {
+            m_options.headless = true;
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            m_options.frames = strtoull(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--imgui") == 0)
+        {
+            m_options.imgui = true;
+        }
+        else if (strcmp(argv[i], "--benchmark") == 0)
+        {
+            m_options.benchmarkPath = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : DEFAULT_BENCHMARK_PATH;
+            m_options.headless = true;
+        }
+        else if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc)
+        {
+            m_options.sprites = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--textures") == 0 && i + 1 < argc)
+        {
+            m_options.textures = strtoul(argv[++i], nullptr, 10);
+        }
+        else if (strcmp(argv[i], "--wireframe") == 0)
+        {
+            m_options.wireframe = true;
+        }
+        else if (strcmp(argv[i], "--bench-math") == 0)
+        {
+            m_options.benchMath = true;
+        }
+        else if (strcmp(argv[i], "--archive") == 0)
+        {
+            m_options.archivePath = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : DEFAULT_ARCHIVE_PATH;
+        }
+        else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+        {
+            m_options.packPath = argv[++i];
+            m_options.packInputs = argv + i + 1;
+            while (i + 1 < argc && argv[i + 1][0] != '-')
+            {
+                m_options.packInputCount++;
+                i++;
+            }
+        }
+        else if (strcmp(argv[i], "--screenshot") == 0)
+        {
+            m_options.screenshotPath = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : DEFAULT_SCREENSHOT_PATH;
+        }
+        else
+        {
+            std::cerr << "Unknown option: " << argv[i] << std::endl;
+        }
+    }
+    if (m_options.benchmarkPath && m_options.frames == 0) m_options.frames = BENCHMARK_FRAMES;
+    if (m_options.headless && m_options.frames == 0) m_options.frames = DEFAULT_HEADLESS_FRAMES; // nothing to close
+    if (m_options.screenshotPath && !m_options.headless)
+    {
+        std::cerr << "--screenshot needs --headless, swapchain images can't be read back" << std::endl;
+        m_options.screenshotPath = nullptr;
+    }
+    if (m_options.sprites > MAX_INSTANCES)
+    {
+        std::cerr << "--sprites can be at most " << MAX_INSTANCES << std::endl;
+        return false;
+    }
+    if (m_options.textures >= MAX_BINDLESS_TEXTURES) // on any device, startBenchmark() checks what this one has left
+    {
+        std::cerr << "--textures must be less than " << MAX_BINDLESS_TEXTURES << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool Engine::isRunning()
 {
-    init();
-    while(!m_window.isClosing())
+    if (!m_options.headless && m_window.isClosing()) return false;
+    if (m_options.benchmarkPath) return m_benchmark.frameCount() < m_options.frames; // warm up doesn't count
+    return m_options.frames == 0 || m_clock.frame() < m_options.frames;
+}
+
+int Engine::run(int argc, char** argv)
+{
+    if (!parseOptions(argc, argv)) return EXIT_FAILURE;
+    if (m_options.benchMath) return runMathBenchmark() ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (m_options.packPath) return packAssets(m_options.packPath, m_options.packInputs, m_options.packInputCount) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    if (!init())
+    {
+        cleanup();
+        return EXIT_FAILURE;
+    }
+    while (isRunning())
     {
         update();
     }
     cleanup();
+    return EXIT_SUCCESS;
 }
\ No newline at end of file
@@ -1,21 +1,49 @@
 #ifndef MANAGER_H
 #define MANAGER_H
 
+#include <stdint.h>
+
+struct EngineOptions
+{
+    const char* tracePath; // --trace [path], written on exit
+    bool headless; // --headless, offscreen images, no window, surface or present
+    uint64_t frames; // --frames N, 0 runs until the window closes
+    const char* screenshotPath; // --screenshot [path], the last frame as a PNG, headless only
+    bool imgui; // --imgui, draw the UI headless too
+    // --benchmark [path], headless with a generated scene, frames counts measured ones
+    const char* benchmarkPath;
+    uint32_t sprites; // --sprites N
+    uint32_t textures; // --textures N
+    bool wireframe; // --wireframe
+    bool benchMath; // --bench-math, checks and times Math, then exits without opening anything
+    const char* archivePath; // --archive [path], assets from a packed archive rather than loose files
+    // --pack <archive> <path>..., writes the archive, then exits without opening anything
+    const char* packPath;
+    char** packInputs;
+    int packInputCount;
+};
+
 class Engine
 {
     private:
     static class Window m_window;
     static class Input m_input;
     static class Renderer m_renderer;
+    static class JobSystem m_jobs;
+    static class Clock m_clock;
+    static EngineOptions m_options;
+    static class Benchmark m_benchmark;
 
-    void init();
+    bool init(); // false if what the options ask for can't run
     void update();
     void cleanup();
+    bool isRunning();
 
-    void gameUpdate();
+    void gameUpdate(float deltaTime); // one fixed simulation step
+    bool parseOptions(int argc, char** argv); // false if the options can't be run
 
     public:
-    void run();
+    int run(int argc, char** argv); // exit code
 
     friend class Input;
     friend class Window;
@@ -21,6 +21,7 @@ void Input::init(GLFWwindow* const window)
 
 void Input::cleanup()
 {
+    if (!m_window) return;
     glfwSetKeyCallback(m_window, nullptr);
 }
 
@@ -34,22 +35,25 @@ void Input::update()
 
 bool Input::isKeyPressed(int key)
 {
+    if (!m_window) return false; // headless, nothing is ever pressed
     return glfwGetKey(m_window, key) == GLFW_PRESS;
 }
 
 bool Input::isKeyReleased(int key)
 {
+    if (!m_window) return true;
     return glfwGetKey(m_window, key) == GLFW_RELEASE;
 }
 
 bool Input::isMousePressed(int btn)
 {
+    if (!m_window) return false;
     return glfwGetMouseButton(m_window, btn) == GLFW_PRESS;
 }
 
 vec2 Input::mousePosition()
 {
-    double x, y;
-    glfwGetCursorPos(m_window, &x, &y);
+    double x = 0.0, y = 0.0;
+    if (m_window) glfwGetCursorPos(m_window, &x, &y);
     return vec2(x, y);
 }
@@ -10,7 +10,7 @@ class Input
     class vec2 mousePosition();
 
     private:
-    void init(struct GLFWwindow* const window);
+    void init(struct GLFWwindow* const window); // null when headless
     void cleanup();
     void update();
 
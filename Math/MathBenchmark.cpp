@@ -0,0 +1,444 @@
+#include "MathBenchmark.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+#include "vec2.h"
+#include "vec3.h"
+#include "vec4.h"
+#include "mat4.h"
+#include "simd.h"
+#include "TransformBatch.h"
+
+#define CHECK_ITERATIONS 10000
+#define CHECK_INSTANCES 1003 // not a multiple of 4, the kernel's tail gets checked too
+#define BENCH_MATRICES 1024
+#define BENCH_INSTANCES 4096
+#define BENCH_MIN_TIME 0.05 // seconds per kernel, repetitions double until it's reached
+#define MAX_ANGLE 6.2831853f
+
+// Tolerances relative to max(1, |reference|)
+#define TOLERANCE_MUL 1e-6
+#define TOLERANCE_WORLD 5e-6 // the SIMD kernel's sin/cos are polynomial
+
+static uint32_t seed = 12345u;
+
+static float randomFloat(float lo, float hi)
+{
+    seed = seed * 1664525u + 1013904223u;
+    return lo + (hi - lo) * ((seed >> 8) / float(1 << 24));
+}
+
+static void randomMatrix(float* m)
+{
+    for (int i = 0; i < 16; ++i) m[i] = randomFloat(-1.0f, 1.0f); // error is relative to max(1, |result|), keep the terms small
+}
+
+/// Reference, double precision and column major like mat4 (element [4 * column + row])
+static void refMul(double* res, const double* lhs, const double* rhs)
+{
+    double tmp[16];
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            double sum = 0.0;
+            for (int k = 0; k < 4; ++k) sum += lhs[4 * k + r] * rhs[4 * c + k];
+            tmp[4 * c + r] = sum;
+        }
+    }
+    memcpy(res, tmp, sizeof(tmp));
+}
+
+static void refMulVec(double* res, const double* lhs, const double* rhs)
+{
+    for (int r = 0; r < 4; ++r)
+    {
+        res[r] = lhs[r] * rhs[0] + lhs[4 + r] * rhs[1] + lhs[8 + r] * rhs[2] + lhs[12 + r] * rhs[3];
+    }
+}
+
+static void refTranspose(double* res, const double* m)
+{
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r) res[4 * r + c] = m[4 * c + r];
+    }
+}
+
+static void widen(double* dst, const float* src, int count)
+{
+    for (int i = 0; i < count; ++i) dst[i] = src[i];
+}
+
+// One axis at a time, so the closed forms aren't checked against themselves
+static void refAxisRotation(double* m, int axis, double angle)
+{
+    double c = cos(angle), s = sin(angle);
+    double identity[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+    memcpy(m, identity, sizeof(identity));
+    int a = (axis + 1) % 3, b = (axis + 2) % 3; // the plane it rotates, a towards b
+    m[4 * a + a] = c;
+    m[4 * a + b] = s;
+    m[4 * b + a] = -s;
+    m[4 * b + b] = c;
+}
+
+// T * Rz * Ry * Rx * S
+static void refWorld(double* world, const float position[3], const float rotation[3], const float scale[3])
+{
+    double rx[16], ry[16], rz[16];
+    refAxisRotation(rx, 0, rotation[0]);
+    refAxisRotation(ry, 1, rotation[1]);
+    refAxisRotation(rz, 2, rotation[2]);
+    refMul(world, rz, ry);
+    refMul(world, world, rx);
+    for (int c = 0; c < 3; ++c)
+    {
+        for (int r = 0; r < 4; ++r) world[4 * c + r] *= scale[c];
+    }
+    world[12] = position[0];
+    world[13] = position[1];
+    world[14] = position[2];
+}
+
+static double maxError(const float* value, const double* reference, int count)
+{
+    double error = 0.0;
+    for (int i = 0; i < count; ++i)
+    {
+        double e = fabs(value[i] - reference[i]) / (fabs(reference[i]) > 1.0 ? fabs(reference[i]) : 1.0);
+        if (!(e <= error)) error = e; // NaN sticks
+    }
+    return error;
+}
+
+static bool report(const char* name, double error, double tolerance)
+{
+    bool ok = error <= tolerance;
+    printf("  %-4s %-44s max error %.3g\n", ok ? "ok" : "FAIL", name, error);
+    return ok;
+}
+
+/// Checks
+typedef void (*MulKernel)(float*, const float*, const float*);
+typedef void (*BatchKernel)(float*, const float*, const float*, size_t);
+typedef void (*TransposeKernel)(float*, const float*);
+
+static double checkMul(MulKernel mul, bool aliasLhs)
+{
+    double error = 0.0;
+    alignas(16) float lhs[16], rhs[16], res[16];
+    double lhsRef[16], rhsRef[16], ref[16];
+    for (int i = 0; i < CHECK_ITERATIONS; ++i)
+    {
+        randomMatrix(lhs);
+        randomMatrix(rhs);
+        widen(lhsRef, lhs, 16);
+        widen(rhsRef, rhs, 16);
+        refMul(ref, lhsRef, rhsRef);
+        float* out = aliasLhs ? lhs : res;
+        mul(out, lhs, rhs);
+        double e = maxError(out, ref, 16);
+        if (!(e <= error)) error = e;
+    }
+    return error;
+}
+
+static double checkMulVec(MulKernel mulVec)
+{
+    double error = 0.0;
+    alignas(16) float lhs[16], rhs[4], res[4];
+    double lhsRef[16], rhsRef[4], ref[4];
+    for (int i = 0; i < CHECK_ITERATIONS; ++i)
+    {
+        randomMatrix(lhs);
+        for (int j = 0; j < 4; ++j) rhs[j] = randomFloat(-1.0f, 1.0f);
+        widen(lhsRef, lhs, 16);
+        widen(rhsRef, rhs, 4);
+        refMulVec(ref, lhsRef, rhsRef);
+        mulVec(res, lhs, rhs);
+        double e = maxError(res, ref, 4);
+        if (!(e <= error)) error = e;
+    }
+    return error;
+}
+
+static double checkMulBatch(BatchKernel mulBatch)
+{
+    const int count = 37;
+    alignas(16) float lhs[16];
+    mat4* rhs = new mat4[count];
+    double lhsRef[16], rhsRef[16];
+    randomMatrix(lhs);
+    widen(lhsRef, lhs, 16);
+    double* refs = new double[16 * count];
+    for (int i = 0; i < count; ++i)
+    {
+        randomMatrix(rhs[i].data);
+        widen(rhsRef, rhs[i].data, 16);
+        refMul(refs + 16 * i, lhsRef, rhsRef);
+    }
+    mulBatch(rhs[0].data, lhs, rhs[0].data, count); // in place, res may alias rhs
+    double error = 0.0;
+    for (int i = 0; i < count; ++i)
+    {
+        double e = maxError(rhs[i].data, refs + 16 * i, 16);
+        if (!(e <= error)) error = e;
+    }
+    delete[] refs;
+    delete[] rhs;
+    return error;
+}
+
+static double checkTranspose(TransposeKernel transpose)
+{
+    double error = 0.0;
+    alignas(16) float m[16], res[16];
+    double mRef[16], ref[16];
+    for (int i = 0; i < CHECK_ITERATIONS; ++i)
+    {
+        randomMatrix(m);
+        widen(mRef, m, 16);
+        refTranspose(ref, mRef);
+        transpose(res, m);
+        double e = maxError(res, ref, 16);
+        transpose(m, m); // in place
+        e += maxError(m, ref, 16);
+        if (!(e <= error)) error = e;
+    }
+    return error;
+}
+
+// (A * B)^T == B^T * A^T and transposing twice is exact, through mat4
+static double checkTransposeProduct()
+{
+    double error = 0.0;
+    for (int i = 0; i < CHECK_ITERATIONS; ++i)
+    {
+        mat4 a, b;
+        randomMatrix(a.data);
+        randomMatrix(b.data);
+        mat4 ab = a * b;
+        ab.transpose();
+        mat4 at = a, bt = b;
+        at.transpose();
+        bt.transpose();
+        mat4 btat = bt * at;
+        double ref[16];
+        widen(ref, btat.data, 16);
+        double e = maxError(ab.data, ref, 16);
+        at.transpose();
+        if (!(at == a)) e = INFINITY;
+        if (!(mat4::Identity * a == a)) e = INFINITY;
+        if (!(e <= error)) error = e;
+    }
+    return error;
+}
+
+// The closed form against composed single axis rotations, and R^T * R == I
+static double checkEulerRotation()
+{
+    double error = 0.0;
+    for (int i = 0; i < CHECK_ITERATIONS; ++i)
+    {
+        float position[3] = {}, rotation[3], scale[3] = { 1.0f, 1.0f, 1.0f };
+        for (int j = 0; j < 3; ++j) rotation[j] = randomFloat(-MAX_ANGLE, MAX_ANGLE);
+        double ref[16];
+        refWorld(ref, position, rotation, scale);
+        mat4 r = mat4::eulerRotation(rotation[0], rotation[1], rotation[2]);
+        double e = maxError(r.data, ref, 16);
+
+        mat4 rt = r;
+        rt.transpose();
+        double identity[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+        e += maxError((rt * r).data, identity, 16);
+        if (!(e <= error)) error = e;
+    }
+    return error;
+}
+
+static double checkWorld(bool simdPath, uint32_t begin)
+{
+    TransformBatch batch;
+    for (uint32_t i = 0; i < CHECK_INSTANCES; ++i)
+    {
+        vec3 position(randomFloat(-100.0f, 100.0f), randomFloat(-100.0f, 100.0f), randomFloat(-100.0f, 100.0f));
+        vec3 rotation(randomFloat(-MAX_ANGLE, MAX_ANGLE), randomFloat(-MAX_ANGLE, MAX_ANGLE), randomFloat(-MAX_ANGLE, MAX_ANGLE));
+        vec3 scale(randomFloat(0.01f, 10.0f), randomFloat(0.01f, 10.0f), randomFloat(0.01f, 10.0f));
+        batch.add(position, rotation, scale);
+    }
+    mat4* world = new mat4[CHECK_INSTANCES];
+    if (simdPath) batch.computeWorld(world, sizeof(mat4), begin, CHECK_INSTANCES);
+    else batch.computeWorldScalar(world, sizeof(mat4), begin, CHECK_INSTANCES);
+
+    double error = 0.0;
+    for (uint32_t i = begin; i < CHECK_INSTANCES; ++i)
+    {
+        float position[3] = { batch.position[0][i], batch.position[1][i], batch.position[2][i] };
+        float rotation[3] = { batch.rotation[0][i], batch.rotation[1][i], batch.rotation[2][i] };
+        float scale[3] = { batch.scale[0][i], batch.scale[1][i], batch.scale[2][i] };
+        double ref[16];
+        refWorld(ref, position, rotation, scale);
+        double e = maxError(world[i].data, ref, 16);
+        if (!(e <= error)) error = e;
+    }
+    delete[] world;
+    return error;
+}
+
+// Vulkan clip space: depth 0 at the near plane and 1 at the far one, w = -z, y down
+static double checkProjection()
+{
+    double error = 0.0;
+    for (int i = 0; i < CHECK_ITERATIONS; ++i)
+    {
+        float fovy = randomFloat(0.1f, 3.0f);
+        float aspect = randomFloat(0.25f, 4.0f);
+        float znear = randomFloat(0.01f, 10.0f);
+        float zfar = znear + randomFloat(1.0f, 1000.0f);
+        mat4 proj = mat4::projection(fovy, aspect, znear, zfar);
+
+        double halfHeight = tan(0.5 * fovy);
+        // Top right corner of the near plane, bottom left of the far one
+        vec4 nearCorner = proj * vec4(halfHeight * aspect * znear, halfHeight * znear, -znear, 1.0f);
+        vec4 farCorner = proj * vec4(-halfHeight * aspect * zfar, -halfHeight * zfar, -zfar, 1.0f);
+        float ndc[6] = { nearCorner.x / nearCorner.w, nearCorner.y / nearCorner.w, nearCorner.z / nearCorner.w,
+                         farCorner.x / farCorner.w, farCorner.y / farCorner.w, farCorner.z / farCorner.w };
+        double ref[6] = { 1.0, -1.0, 0.0, -1.0, 1.0, 1.0 };
+        double e = maxError(ndc, ref, 6);
+        float w[2] = { nearCorner.w, farCorner.w };
+        double wRef[2] = { znear, zfar };
+        e += maxError(w, wRef, 2);
+        if (!(e <= error)) error = e;
+    }
+    return error;
+}
+
+static bool checkVectors()
+{
+    float data[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+    vec4 zero;
+    return vec2(data) == vec2(1.0f, 2.0f) && vec3(data) == vec3(1.0f, 2.0f, 3.0f) &&
+           vec4(data) == vec4(1.0f, 2.0f, 3.0f, 4.0f) && zero == vec4(0.0f);
+}
+
+/// Benchmarks
+static volatile float sink; // keeps results alive
+
+// Nanoseconds per op, fn(reps) runs reps ops
+template<typename Fn>
+static double measure(Fn fn, uint64_t opsPerCall)
+{
+    typedef std::chrono::steady_clock Timer;
+    fn(); // warm caches
+    for (uint64_t reps = 1;; reps *= 2)
+    {
+        Timer::time_point start = Timer::now();
+        for (uint64_t i = 0; i < reps; ++i) fn();
+        double elapsed = std::chrono::duration<double>(Timer::now() - start).count();
+        if (elapsed >= BENCH_MIN_TIME) return elapsed * 1e9 / (reps * opsPerCall);
+    }
+}
+
+static void printTiming(const char* name, double scalar, double simd)
+{
+    if (simd > 0.0) printf("  %-24s scalar %8.2f ns   simd %8.2f ns   %5.2fx\n", name, scalar, simd, scalar / simd);
+    else printf("  %-24s scalar %8.2f ns\n", name, scalar);
+}
+
+bool runMathBenchmark()
+{
+#if SIMD_AVX2
+    const char* simdName = "AVX2";
+#elif SIMD_SSE2
+    const char* simdName = "SSE2";
+#else
+    const char* simdName = "none, simd == scalar";
+#endif
+    printf("Math benchmark, SIMD: %s\n", simdName);
+
+    printf("Checks against a double precision reference\n");
+    bool ok = true;
+    ok &= report("mat4 * mat4, scalar", checkMul(simd::scalar::mul, false), TOLERANCE_MUL);
+    ok &= report("mat4 * mat4, simd", checkMul(simd::mul, false), TOLERANCE_MUL);
+    ok &= report("mat4 *= mat4, simd (res aliases lhs)", checkMul(simd::mul, true), TOLERANCE_MUL);
+    ok &= report("mat4 * vec4, scalar", checkMulVec(simd::scalar::mulVec), TOLERANCE_MUL);
+    ok &= report("mat4 * vec4, simd", checkMulVec(simd::mulVec), TOLERANCE_MUL);
+    ok &= report("batch multiply, scalar (in place)", checkMulBatch(simd::scalar::mulBatch), TOLERANCE_MUL);
+    ok &= report("batch multiply, simd (in place)", checkMulBatch(simd::mulBatch), TOLERANCE_MUL);
+    ok &= report("transpose, scalar", checkTranspose(simd::scalar::transpose), 0.0);
+    ok &= report("transpose, simd", checkTranspose(simd::transpose), 0.0);
+    ok &= report("(A * B)^T == B^T * A^T, I * A == A", checkTransposeProduct(), TOLERANCE_MUL);
+    ok &= report("eulerRotation, orthonormal", checkEulerRotation(), TOLERANCE_MUL);
+    ok &= report("projection, near/far/frustum corners", checkProjection(), TOLERANCE_MUL);
+    ok &= report("TransformBatch world, scalar", checkWorld(false, 0), TOLERANCE_WORLD);
+    ok &= report("TransformBatch world, simd", checkWorld(true, 0), TOLERANCE_WORLD);
+    ok &= report("TransformBatch world, simd from 8", checkWorld(true, 8), TOLERANCE_WORLD);
+    ok &= report("vec constructors", checkVectors() ? 0.0 : INFINITY, 0.0);
+
+    printf("Throughput, per matrix or instance\n");
+    mat4* a = new mat4[BENCH_MATRICES];
+    mat4* b = new mat4[BENCH_MATRICES];
+    mat4* res = new mat4[BENCH_MATRICES];
+    vec4* vectors = new vec4[BENCH_MATRICES];
+    for (int i = 0; i < BENCH_MATRICES; ++i)
+    {
+        randomMatrix(a[i].data);
+        randomMatrix(b[i].data);
+        vectors[i] = vec4(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), 1.0f);
+    }
+
+    auto mulWith = [&](MulKernel mul)
+    {
+        return measure([&]() { for (int i = 0; i < BENCH_MATRICES; ++i) mul(res[i].data, a[i].data, b[i].data); sink = res[0].data[0]; }, BENCH_MATRICES);
+    };
+    printTiming("mat4 * mat4", mulWith(simd::scalar::mul), mulWith(simd::mul));
+
+    auto mulVecWith = [&](MulKernel mulVec)
+    {
+        return measure([&]() { for (int i = 0; i < BENCH_MATRICES; ++i) mulVec(res[i].data, a[i].data, vectors[i].data); sink = res[0].data[0]; }, BENCH_MATRICES);
+    };
+    printTiming("mat4 * vec4", mulVecWith(simd::scalar::mulVec), mulVecWith(simd::mulVec));
+
+    auto batchWith = [&](BatchKernel mulBatch)
+    {
+        return measure([&]() { mulBatch(res[0].data, a[0].data, b[0].data, BENCH_MATRICES); sink = res[0].data[0]; }, BENCH_MATRICES);
+    };
+    printTiming("batch multiply", batchWith(simd::scalar::mulBatch), batchWith(simd::mulBatch));
+
+    auto transposeWith = [&](TransposeKernel transpose)
+    {
+        return measure([&]() { for (int i = 0; i < BENCH_MATRICES; ++i) transpose(res[i].data, a[i].data); sink = res[0].data[0]; }, BENCH_MATRICES);
+    };
+    printTiming("transpose", transposeWith(simd::scalar::transpose), transposeWith(simd::transpose));
+
+    double projection = measure([&]()
+    {
+        for (int i = 0; i < BENCH_MATRICES; ++i) res[i] = mat4::projection(0.5f + i * 1e-4f, 1.5f, 0.1f, 100.0f);
+        sink = res[0].data[0];
+    }, BENCH_MATRICES);
+    printTiming("projection", projection, 0.0);
+
+    TransformBatch batch;
+    for (int i = 0; i < BENCH_INSTANCES; ++i)
+    {
+        batch.add(vec3(randomFloat(-10.0f, 10.0f)), vec3(randomFloat(-MAX_ANGLE, MAX_ANGLE), randomFloat(-MAX_ANGLE, MAX_ANGLE), randomFloat(-MAX_ANGLE, MAX_ANGLE)), vec3(1.0f));
+    }
+    mat4* world = new mat4[BENCH_INSTANCES];
+    double worldScalar = measure([&]() { batch.computeWorldScalar(world, sizeof(mat4), 0, BENCH_INSTANCES); sink = world[0].data[0]; }, BENCH_INSTANCES);
+    double worldSimd = measure([&]() { batch.computeWorld(world, sizeof(mat4)); sink = world[0].data[0]; }, BENCH_INSTANCES);
+    printTiming("TransformBatch world", worldScalar, worldSimd);
+
+    delete[] world;
+    delete[] vectors;
+    delete[] res;
+    delete[] b;
+    delete[] a;
+
+    printf(ok ? "All checks passed\n" : "Some checks FAILED\n");
+    return ok;
+}
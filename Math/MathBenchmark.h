@@ -0,0 +1,9 @@
+#ifndef MATH_BENCHMARK_H
+#define MATH_BENCHMARK_H
+
+// --bench-math, needs no window or device. Cross-checks the math kernels (scalar and SIMD paths)
+// against a double precision reference on random inputs, then times them. Prints both, returns
+// false if any check failed.
+bool runMathBenchmark();
+
+#endif /* MATH_BENCHMARK_H */
@@ -0,0 +1,269 @@
+#include "TransformBatch.h"
+
+#include <assert.h>
+#include <cstring>
+#include <cmath>
+#include <new>
+
+#include "vec3.h"
+#include "simd.h"
+
+#if SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+#define STREAM_COUNT 9
+
+TransformBatch::TransformBatch() : m_data(nullptr), m_count(0), m_capacity(0)
+{
+    for (int i = 0; i < 3; ++i)
+    {
+        position[i] = nullptr;
+        rotation[i] = nullptr;
+        scale[i] = nullptr;
+    }
+}
+
+TransformBatch::~TransformBatch()
+{
+    ::operator delete(m_data, std::align_val_t(16));
+}
+
+void TransformBatch::reserve(uint32_t capacity)
+{
+    capacity = (capacity + 3) & ~3u;
+    if (capacity <= m_capacity) return;
+
+    float* data = static_cast<float*>(::operator new(STREAM_COUNT * capacity * sizeof(float), std::align_val_t(16)));
+    memset(data, 0, STREAM_COUNT * capacity * sizeof(float));
+    float** streams[] = { &position[0], &position[1], &position[2],
+                          &rotation[0], &rotation[1], &rotation[2],
+                          &scale[0],    &scale[1],    &scale[2] };
+    for (int i = 0; i < STREAM_COUNT; ++i)
+    {
+        float* stream = data + i * capacity;
+        if (m_count > 0) memcpy(stream, *streams[i], m_count * sizeof(float));
+        *streams[i] = stream;
+    }
+    ::operator delete(m_data, std::align_val_t(16));
+    m_data = data;
+    m_capacity = capacity;
+}
+
+void TransformBatch::copy(const TransformBatch& other)
+{
+    m_count = 0; // nothing worth keeping for reserve to move
+    reserve(other.m_count);
+    m_count = other.m_count;
+    for (int i = 0; i < 3; ++i)
+    {
+        memcpy(position[i], other.position[i], m_count * sizeof(float));
+        memcpy(rotation[i], other.rotation[i], m_count * sizeof(float));
+        memcpy(scale[i], other.scale[i], m_count * sizeof(float));
+    }
+}
+
+void TransformBatch::interpolate(const TransformBatch& from, const TransformBatch& to, float t)
+{
+    copy(to);
+    uint32_t count = from.m_count < to.m_count ? from.m_count : to.m_count;
+    const float* const src[] = { from.position[0], from.position[1], from.position[2],
+                                 from.rotation[0], from.rotation[1], from.rotation[2],
+                                 from.scale[0],    from.scale[1],    from.scale[2] };
+    float* const dst[] = { position[0], position[1], position[2],
+                           rotation[0], rotation[1], rotation[2],
+                           scale[0],    scale[1],    scale[2] };
+    for (int i = 0; i < STREAM_COUNT; ++i)
+    {
+        for (uint32_t j = 0; j < count; ++j)
+        {
+            dst[i][j] = src[i][j] + (dst[i][j] - src[i][j]) * t;
+        }
+    }
+}
+
+uint32_t TransformBatch::add(const vec3& position, const vec3& rotation, const vec3& scale)
+{
+    if (m_count == m_capacity) reserve(m_capacity > 0 ? 2 * m_capacity : 64);
+    uint32_t index = m_count++;
+    setPosition(index, position);
+    setRotation(index, rotation);
+    setScale(index, scale);
+    return index;
+}
+
+void TransformBatch::remove(uint32_t index)
+{
+    assert( index < m_count );
+    --m_count;
+    for (int i = 0; i < 3; ++i)
+    {
+        position[i][index] = position[i][m_count];
+        rotation[i][index] = rotation[i][m_count];
+        scale[i][index] = scale[i][m_count];
+    }
+}
+
+void TransformBatch::clear()
+{
+    m_count = 0;
+}
+
+uint32_t TransformBatch::count() const
+{
+    return m_count;
+}
+
+void TransformBatch::setPosition(uint32_t index, const vec3& value)
+{
+    position[0][index] = value.x;
+    position[1][index] = value.y;
+    position[2][index] = value.z;
+}
+
+void TransformBatch::setRotation(uint32_t index, const vec3& value)
+{
+    rotation[0][index] = value.x;
+    rotation[1][index] = value.y;
+    rotation[2][index] = value.z;
+}
+
+void TransformBatch::setScale(uint32_t index, const vec3& value)
+{
+    scale[0][index] = value.x;
+    scale[1][index] = value.y;
+    scale[2][index] = value.z;
+}
+
+#if SIMD_SSE2
+// Cephes style sin/cos, reduced to [-pi/4, pi/4] by quadrant
+static inline void sincos(__m128 x, __m128& s, __m128& c)
+{
+    __m128i q = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977236f))); // 2 / pi
+    __m128 j = _mm_cvtepi32_ps(q);
+    // pi / 2 split in three so the reduction stays exact
+    x = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(1.5703125f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(4.837512969970703125e-4f)));
+    x = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(7.54978995489188216e-8f)));
+    __m128 z = _mm_mul_ps(x, x);
+
+    __m128 ps = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(-1.9515295891e-4f), z), _mm_set1_ps(8.3321608736e-3f));
+    ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(-1.6666654611e-1f));
+    ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), x), x);
+
+    __m128 pc = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.443315711809948e-5f), z), _mm_set1_ps(-1.388731625493765e-3f));
+    pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(4.166664568298827e-2f));
+    pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+    pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+    // Odd quadrants swap sin and cos, quadrants 2,3 negate sin and 1,2 negate cos
+    __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(q, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+    __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(q, _mm_set1_epi32(2)), 30));
+    __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(q, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+    s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps)), sinSign);
+    c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc)), cosSign);
+}
+
+void TransformBatch::computeWorld(void* dst, size_t stride, uint32_t begin, uint32_t end) const
+{
+    assert( begin % 4 == 0 && end <= m_count );
+    char* out = static_cast<char*>(dst);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (uint32_t i = begin; i < end; i += 4)
+    {
+        __m128 sx, cx, sy, cy, sz, cz;
+        sincos(_mm_load_ps(rotation[0] + i), sx, cx);
+        sincos(_mm_load_ps(rotation[1] + i), sy, cy);
+        sincos(_mm_load_ps(rotation[2] + i), sz, cz);
+        __m128 kx = _mm_load_ps(scale[0] + i);
+        __m128 ky = _mm_load_ps(scale[1] + i);
+        __m128 kz = _mm_load_ps(scale[2] + i);
+        __m128 sxsy = _mm_mul_ps(sx, sy);
+        __m128 cxsy = _mm_mul_ps(cx, sy);
+
+        // One register per matrix entry, lane n belongs to instance i + n
+        __m128 cols[4][4] = {
+            {
+                _mm_mul_ps(_mm_mul_ps(cy, cz), kx),
+                _mm_mul_ps(_mm_mul_ps(cy, sz), kx),
+                _mm_mul_ps(_mm_sub_ps(zero, sy), kx),
+                zero
+            },
+            {
+                _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(sxsy, cz), _mm_mul_ps(cx, sz)), ky),
+                _mm_mul_ps(_mm_add_ps(_mm_mul_ps(sxsy, sz), _mm_mul_ps(cx, cz)), ky),
+                _mm_mul_ps(_mm_mul_ps(sx, cy), ky),
+                zero
+            },
+            {
+                _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cxsy, cz), _mm_mul_ps(sx, sz)), kz),
+                _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(cxsy, sz), _mm_mul_ps(sx, cz)), kz),
+                _mm_mul_ps(_mm_mul_ps(cx, cy), kz),
+                zero
+            },
+            {
+                _mm_load_ps(position[0] + i),
+                _mm_load_ps(position[1] + i),
+                _mm_load_ps(position[2] + i),
+                one
+            }
+        };
+        for (int c = 0; c < 4; ++c)
+        {
+            _MM_TRANSPOSE4_PS(cols[c][0], cols[c][1], cols[c][2], cols[c][3]);
+        }
+
+        uint32_t lanes = end - i < 4 ? end - i : 4;
+        for (uint32_t n = 0; n < lanes; ++n)
+        {
+            float* world = reinterpret_cast<float*>(out + (i + n) * stride);
+            for (int c = 0; c < 4; ++c)
+            {
+                _mm_storeu_ps(world + 4 * c, cols[c][n]);
+            }
+        }
+    }
+}
+#else
+void TransformBatch::computeWorld(void* dst, size_t stride, uint32_t begin, uint32_t end) const
+{
+    computeWorldScalar(dst, stride, begin, end);
+}
+#endif
+
+void TransformBatch::computeWorldScalar(void* dst, size_t stride, uint32_t begin, uint32_t end) const
+{
+    assert( begin % 4 == 0 && end <= m_count );
+    char* out = static_cast<char*>(dst);
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        float sx = sinf(rotation[0][i]), cx = cosf(rotation[0][i]);
+        float sy = sinf(rotation[1][i]), cy = cosf(rotation[1][i]);
+        float sz = sinf(rotation[2][i]), cz = cosf(rotation[2][i]);
+        float kx = scale[0][i], ky = scale[1][i], kz = scale[2][i];
+
+        float* world = reinterpret_cast<float*>(out + i * stride);
+        world[0] = cy * cz * kx;
+        world[1] = cy * sz * kx;
+        world[2] = -sy * kx;
+        world[3] = 0.0f;
+        world[4] = (sx * sy * cz - cx * sz) * ky;
+        world[5] = (sx * sy * sz + cx * cz) * ky;
+        world[6] = sx * cy * ky;
+        world[7] = 0.0f;
+        world[8] = (cx * sy * cz + sx * sz) * kz;
+        world[9] = (cx * sy * sz - sx * cz) * kz;
+        world[10] = cx * cy * kz;
+        world[11] = 0.0f;
+        world[12] = position[0][i];
+        world[13] = position[1][i];
+        world[14] = position[2][i];
+        world[15] = 1.0f;
+    }
+}
+
+void TransformBatch::computeWorld(void* dst, size_t stride) const
+{
+    computeWorld(dst, stride, 0, m_count);
+}
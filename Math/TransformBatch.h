@@ -0,0 +1,51 @@
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class vec3;
+
+// Positions, euler rotations (roll, yaw, pitch) and scales stored as structure of arrays.
+// World matrices (translate * rotate * scale) are computed four instances at a time.
+class TransformBatch
+{
+public:
+    TransformBatch();
+    ~TransformBatch();
+    TransformBatch(const TransformBatch& other) = delete;
+    TransformBatch& operator=(const TransformBatch& other) = delete;
+
+    uint32_t add(const vec3& position, const vec3& rotation, const vec3& scale);
+    void remove(uint32_t index); // swaps the last instance into index
+    void clear();
+    void reserve(uint32_t capacity);
+    void copy(const TransformBatch& other); // e.g. snapshotting the scene for another thread
+    // Blends from towards to, instances that only exist in to are copied as is
+    void interpolate(const TransformBatch& from, const TransformBatch& to, float t);
+
+    uint32_t count() const;
+
+    void setPosition(uint32_t index, const vec3& position);
+    void setRotation(uint32_t index, const vec3& rotation);
+    void setScale(uint32_t index, const vec3& scale);
+
+    // Writes count() matrices, stride bytes apart (e.g. straight into a mapped instance buffer)
+    void computeWorld(void* dst, size_t stride) const;
+    // Only instances [begin, end), dst is still the first instance's. begin has to be a multiple of 4
+    void computeWorld(void* dst, size_t stride, uint32_t begin, uint32_t end) const;
+    // What computeWorld falls back to without SSE2, kept for comparing against
+    void computeWorldScalar(void* dst, size_t stride, uint32_t begin, uint32_t end) const;
+
+    // Streams, count() valid entries each
+    float* position[3];
+    float* rotation[3];
+    float* scale[3];
+
+private:
+    float* m_data;
+    uint32_t m_count;
+    uint32_t m_capacity; // multiple of 4 so the kernel can always read full lanes
+};
+
+#endif /* TRANSFORM_BATCH_H */
@@ -3,6 +3,9 @@
 #include <cstring>
 #include <cmath>
 
+#include "vec4.h"
+#include "simd.h"
+
 const mat4 mat4::Identity =  {1.0f, 0.0f, 0.0f, 0.0f, 
                               0.0f, 1.0f, 0.0f, 0.0f,
                               0.0f, 0.0f, 1.0f, 0.0f,
@@ -52,32 +55,21 @@ mat4& mat4::operator=(const mat4& other)
 
 mat4& mat4::operator*=(const mat4& other)
 {
-    *this = *this * other;
+    simd::mul(data, data, other.data);
     return *this;
 }
 
-mat4 operator*(mat4 lhs, const mat4& rhs)
+mat4 operator*(const mat4& lhs, const mat4& rhs)
 {
     mat4 res;
-    res.m00 = rhs.m00 * lhs.m00 + rhs.m01 * lhs.m10 + rhs.m02 * lhs.m20 + rhs.m03 * lhs.m30;
-    res.m01 = rhs.m00 * lhs.m01 + rhs.m01 * lhs.m11 + rhs.m02 * lhs.m21 + rhs.m03 * lhs.m31;
-    res.m02 = rhs.m00 * lhs.m02 + rhs.m01 * lhs.m12 + rhs.m02 * lhs.m22 + rhs.m03 * lhs.m32;
-    res.m03 = rhs.m00 * lhs.m03 + rhs.m01 * lhs.m13 + rhs.m02 * lhs.m23 + rhs.m03 * lhs.m33;
-
-    res.m10 = rhs.m10 * lhs.m00 + rhs.m11 * lhs.m10 + rhs.m12 * lhs.m20 + rhs.m13 * lhs.m30;
-    res.m11 = rhs.m10 * lhs.m01 + rhs.m11 * lhs.m11 + rhs.m12 * lhs.m21 + rhs.m13 * lhs.m31;
-    res.m12 = rhs.m10 * lhs.m02 + rhs.m11 * lhs.m12 + rhs.m12 * lhs.m22 + rhs.m13 * lhs.m32;
-    res.m13 = rhs.m10 * lhs.m03 + rhs.m11 * lhs.m13 + rhs.m12 * lhs.m23 + rhs.m13 * lhs.m33;
-
-    res.m20 = rhs.m20 * lhs.m00 + rhs.m21 * lhs.m10 + rhs.m22 * lhs.m20 + rhs.m23 * lhs.m30;
-    res.m21 = rhs.m20 * lhs.m01 + rhs.m21 * lhs.m11 + rhs.m22 * lhs.m21 + rhs.m23 * lhs.m31;
-    res.m22 = rhs.m20 * lhs.m02 + rhs.m21 * lhs.m12 + rhs.m22 * lhs.m22 + rhs.m23 * lhs.m32;
-    res.m23 = rhs.m20 * lhs.m03 + rhs.m21 * lhs.m13 + rhs.m22 * lhs.m23 + rhs.m23 * lhs.m33;
-
-    res.m30 = rhs.m30 * lhs.m00 + rhs.m31 * lhs.m10 + rhs.m32 * lhs.m20 + rhs.m33 * lhs.m30;
-    res.m31 = rhs.m30 * lhs.m01 + rhs.m31 * lhs.m11 + rhs.m32 * lhs.m21 + rhs.m33 * lhs.m31;
-    res.m32 = rhs.m30 * lhs.m02 + rhs.m31 * lhs.m12 + rhs.m32 * lhs.m22 + rhs.m33 * lhs.m32;
-    res.m33 = rhs.m30 * lhs.m03 + rhs.m31 * lhs.m13 + rhs.m32 * lhs.m23 + rhs.m33 * lhs.m33;
+    simd::mul(res.data, lhs.data, rhs.data);
+    return res;
+}
+
+vec4 operator*(const mat4& lhs, const vec4& rhs)
+{
+    vec4 res;
+    simd::mulVec(res.data, lhs.data, rhs.data);
     return res;
 }
 
@@ -90,33 +82,9 @@ bool operator==(const mat4& lhs, const mat4& rhs)
     return true;
 }
 
-void mat4::transpose() // TODO: maybe can do this from a for loop?
+void mat4::transpose()
 {
-    float tmp;
-
-    tmp = m01;
-    m01 = m10;
-    m10 = tmp;
-
-    tmp = m02;
-    m02 = m10;
-    m20 = tmp;
-
-    tmp = m03;
-    m03 = m30;
-    m30 = tmp;
-
-    tmp = m21;
-    m21 = m12;
-    m12 = tmp;
-
-    tmp = m31;
-    m31 = m13;
-    m13 = tmp;
-
-    tmp = m23;
-    m23 = m32;
-    m32 = tmp;
+    simd::transpose(data, data);
 }
 
 mat4 mat4::translate(float x, float y, float z)
@@ -127,6 +95,7 @@ mat4 mat4::translate(float x, float y, float z)
             x,    y,    z,    1.0f};
 }
 
+// Rz(pitch) * Ry(yaw) * Rx(roll), the same rotation TransformBatch builds. Columns, like translate
 mat4 mat4::eulerRotation(float roll, float yaw, float pitch)
 {
     float cx = cos(roll);
@@ -135,10 +104,18 @@ mat4 mat4::eulerRotation(float roll, float yaw, float pitch)
     float sy = sin(yaw);
     float cz = cos(pitch);
     float sz = sin(pitch);
-    return {cy * cz, sx * sy * cz - cx * sz, cx * sy * sz - sx * cz, 0.0f,
-            cy * sz, sx * sy * sz + cx * cz, cx * sy * sz - sx * cz, 0.0f,
-            -sy,     sx * cy,                cx * cy,                0.0f,
-            0.0f,    0.0f,                   0.0f,                   1.0f};
+    return {cy * cz,                cy * sz,                -sy,     0.0f,
+            sx * sy * cz - cx * sz, sx * sy * sz + cx * cz, sx * cy, 0.0f,
+            cx * sy * cz + sx * sz, cx * sy * sz - sx * cz, cx * cy, 0.0f,
+            0.0f,                   0.0f,                   0.0f,    1.0f};
+}
+
+mat4 mat4::scale(float x, float y, float z)
+{
+    return {x,    0.0f, 0.0f, 0.0f,
+            0.0f, y,    0.0f, 0.0f,
+            0.0f, 0.0f, z,    0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f};
 }
 
 // CCW & Depth 0 to 1
@@ -150,4 +127,9 @@ mat4 mat4::projection(float fovy, float aspect, float znear, float zfar)
             0.0f,       -f,   0.0f,             0.0f,
             0.0f,       0.0f, zfar * z,         -1.0f,
             0.0f,       0.0f, znear * zfar * z, 0.0f};
+}
+
+void mat4::multiply(mat4* res, const mat4& lhs, const mat4* rhs, size_t count)
+{
+    simd::mulBatch(res->data, lhs.data, rhs->data, count);
 }
\ No newline at end of file
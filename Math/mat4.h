@@ -1,7 +1,11 @@
 #ifndef MAT4_H
 #define MAT4_H
 
-class mat4
+#include <stddef.h>
+
+class vec4;
+
+class alignas(16) mat4
 {
 public:
     union
@@ -22,11 +26,13 @@ public:
          float m20, float m21, float m22, float m23,
          float m30, float m31, float m32, float m33);
     mat4(float data[16]);
+    mat4(const mat4& other) = default;
 
     mat4& operator=(const mat4& other);
     mat4& operator*=(const mat4& other);
 
-    friend mat4 operator*(mat4 lhs, const mat4& rhs);
+    friend mat4 operator*(const mat4& lhs, const mat4& rhs);
+    friend vec4 operator*(const mat4& lhs, const vec4& rhs);
     friend bool operator==(const mat4& lhs, const mat4& rhs);
 
     void transpose();
@@ -34,8 +40,12 @@ public:
     const static mat4 Identity;
 
     static mat4 translate(float x, float y, float z);
-    static mat4 eulerRotation(float yaw, float pitch, float roll);
+    static mat4 eulerRotation(float roll, float yaw, float pitch); // radians about x, y, z
+    static mat4 scale(float x, float y, float z);
     static mat4 projection(float fovy, float aspect, float znear, float zfar);
+
+    // res[i] = lhs * rhs[i], res may alias rhs
+    static void multiply(mat4* res, const mat4& lhs, const mat4* rhs, size_t count);
 };
 
 #endif /* MAT4_H */
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "simd.h"
+
+#include <cstring>
+
+#if SIMD_AVX2
+#include <immintrin.h>
+#elif SIMD_SSE2
+#include <emmintrin.h>
+#endif
+
+/// Scalar
+void simd::scalar::mul(float* res, const float* lhs, const float* rhs)
+{
+    float tmp[16];
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            tmp[4 * c + r] = lhs[r]      * rhs[4 * c]     +
+                             lhs[4 + r]  * rhs[4 * c + 1] +
+                             lhs[8 + r]  * rhs[4 * c + 2] +
+                             lhs[12 + r] * rhs[4 * c + 3];
+        }
+    }
+    memcpy(res, tmp, 16 * sizeof(float));
+}
+
+void simd::scalar::mulVec(float* res, const float* lhs, const float* rhs)
+{
+    float tmp[4];
+    for (int r = 0; r < 4; ++r)
+    {
+        tmp[r] = lhs[r] * rhs[0] + lhs[4 + r] * rhs[1] + lhs[8 + r] * rhs[2] + lhs[12 + r] * rhs[3];
+    }
+    memcpy(res, tmp, 4 * sizeof(float));
+}
+
+void simd::scalar::mulBatch(float* res, const float* lhs, const float* rhs, size_t count)
+{
+    for (size_t i = 0; i < count; ++i)
+    {
+        mul(res + 16 * i, lhs, rhs + 16 * i);
+    }
+}
+
+void simd::scalar::transpose(float* res, const float* m)
+{
+    float tmp[16];
+    for (int c = 0; c < 4; ++c)
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            tmp[4 * r + c] = m[4 * c + r];
+        }
+    }
+    memcpy(res, tmp, 16 * sizeof(float));
+}
+
+/// SSE2
+#if SIMD_SSE2
+#define SPLAT(v, i) _mm_shuffle_ps(v, v, _MM_SHUFFLE(i, i, i, i))
+
+static inline __m128 combine(const __m128 l[4], __m128 col)
+{
+    __m128 r = _mm_mul_ps(l[0], SPLAT(col, 0));
+    r = _mm_add_ps(r, _mm_mul_ps(l[1], SPLAT(col, 1)));
+    r = _mm_add_ps(r, _mm_mul_ps(l[2], SPLAT(col, 2)));
+    r = _mm_add_ps(r, _mm_mul_ps(l[3], SPLAT(col, 3)));
+    return r;
+}
+
+void simd::mulVec(float* res, const float* lhs, const float* rhs)
+{
+    const __m128 l[4] = { _mm_load_ps(lhs), _mm_load_ps(lhs + 4), _mm_load_ps(lhs + 8), _mm_load_ps(lhs + 12) };
+    _mm_store_ps(res, combine(l, _mm_load_ps(rhs)));
+}
+
+void simd::transpose(float* res, const float* m)
+{
+    __m128 c0 = _mm_load_ps(m), c1 = _mm_load_ps(m + 4), c2 = _mm_load_ps(m + 8), c3 = _mm_load_ps(m + 12);
+    _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+    _mm_store_ps(res, c0);
+    _mm_store_ps(res + 4, c1);
+    _mm_store_ps(res + 8, c2);
+    _mm_store_ps(res + 12, c3);
+}
+#else
+void simd::mulVec(float* res, const float* lhs, const float* rhs)
+{
+    scalar::mulVec(res, lhs, rhs);
+}
+
+void simd::transpose(float* res, const float* m)
+{
+    scalar::transpose(res, m);
+}
+#endif
+
+/// AVX2
+#if SIMD_AVX2
+#if defined(__FMA__)
+#define MADD(a, b, c) _mm256_fmadd_ps(a, b, c)
+#else
+#define MADD(a, b, c) _mm256_add_ps(_mm256_mul_ps(a, b), c)
+#endif
+
+// Two result columns per iteration, lhs columns are broadcast into both 128 bit lanes
+static inline void mulColumns(float* res, const __m256 l[4], const float* rhs)
+{
+    __m256 cols = _mm256_loadu_ps(rhs); // mat4 is only 16 byte aligned
+    __m256 r = _mm256_mul_ps(l[0], _mm256_permute_ps(cols, 0x00));
+    r = MADD(l[1], _mm256_permute_ps(cols, 0x55), r);
+    r = MADD(l[2], _mm256_permute_ps(cols, 0xAA), r);
+    r = MADD(l[3], _mm256_permute_ps(cols, 0xFF), r);
+    _mm256_storeu_ps(res, r);
+}
+
+void simd::mul(float* res, const float* lhs, const float* rhs)
+{
+    const __m256 l[4] = {
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + 4)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + 8)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + 12))
+    };
+    mulColumns(res, l, rhs);
+    mulColumns(res + 8, l, rhs + 8);
+}
+
+void simd::mulBatch(float* res, const float* lhs, const float* rhs, size_t count)
+{
+    const __m256 l[4] = {
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + 4)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + 8)),
+        _mm256_broadcast_ps(reinterpret_cast<const __m128*>(lhs + 12))
+    };
+    for (size_t i = 0; i < count; ++i)
+    {
+        mulColumns(res + 16 * i, l, rhs + 16 * i);
+        mulColumns(res + 16 * i + 8, l, rhs + 16 * i + 8);
+    }
+}
+#elif SIMD_SSE2
+void simd::mul(float* res, const float* lhs, const float* rhs)
+{
+    const __m128 l[4] = { _mm_load_ps(lhs), _mm_load_ps(lhs + 4), _mm_load_ps(lhs + 8), _mm_load_ps(lhs + 12) };
+    // rhs may alias res, each column is fully read before it is written
+    for (int c = 0; c < 16; c += 4)
+    {
+        _mm_store_ps(res + c, combine(l, _mm_load_ps(rhs + c)));
+    }
+}
+
+void simd::mulBatch(float* res, const float* lhs, const float* rhs, size_t count)
+{
+    const __m128 l[4] = { _mm_load_ps(lhs), _mm_load_ps(lhs + 4), _mm_load_ps(lhs + 8), _mm_load_ps(lhs + 12) };
+    for (size_t i = 0; i < 16 * count; i += 4)
+    {
+        _mm_store_ps(res + i, combine(l, _mm_load_ps(rhs + i)));
+    }
+}
+#else
+void simd::mul(float* res, const float* lhs, const float* rhs)
+{
+    scalar::mul(res, lhs, rhs);
+}
+
+void simd::mulBatch(float* res, const float* lhs, const float* rhs, size_t count)
+{
+    scalar::mulBatch(res, lhs, rhs, count);
+}
+#endif
@@ -0,0 +1,32 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stddef.h>
+
+// Instruction set is picked at compile time (-mavx2 / -msse2), anything else falls back to scalar
+#if defined(__AVX2__)
+#define SIMD_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#endif
+
+// Kernels work on column major float[16] matrices and float[4] vectors, 16 byte aligned
+namespace simd
+{
+    void mul(float* res, const float* lhs, const float* rhs);
+    void mulVec(float* res, const float* lhs, const float* rhs);
+    // res[i] = lhs * rhs[i]
+    void mulBatch(float* res, const float* lhs, const float* rhs, size_t count);
+    void transpose(float* res, const float* m); // res may alias m
+
+    namespace scalar
+    {
+        void mul(float* res, const float* lhs, const float* rhs);
+        void mulVec(float* res, const float* lhs, const float* rhs);
+        void mulBatch(float* res, const float* lhs, const float* rhs, size_t count);
+        void transpose(float* res, const float* m);
+    }
+}
+
+#endif /* SIMD_H */
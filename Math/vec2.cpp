@@ -16,7 +16,7 @@ vec2::vec2(float x, float y) : x(x), y(y)
 
 vec2::vec2(float data[2])
 {
-    memcpy(data, this->data, 2 * sizeof(float));
+    memcpy(this->data, data, 2 * sizeof(float));
 }
 
 vec2& vec2::operator=(const vec2& other)
@@ -13,6 +13,7 @@ public:
     vec2(float val);
     vec2(float x, float y);
     vec2(float data[2]);
+    vec2(const vec2& other) = default;
 
     vec2& operator=(const vec2& other);
     vec2& operator+=(const vec2& rhs);
@@ -16,7 +16,7 @@ vec3::vec3(float x, float y, float z) : x(x), y(y), z(z)
 
 vec3::vec3(float data[3])
 {
-    memcpy(data, this->data, 3 * sizeof(float));
+    memcpy(this->data, data, 3 * sizeof(float));
 }
 
 vec3& vec3::operator=(const vec3& other)
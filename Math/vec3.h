@@ -14,6 +14,7 @@ public:
     vec3(float val);
     vec3(float x, float y, float z);
     vec3(float data[3]);
+    vec3(const vec3& other) = default;
 
     vec3& operator=(const vec3& other);
     vec3& operator+=(const vec3& rhs);
@@ -2,7 +2,7 @@
 
 #include <cstring>
 
-vec4::vec4() : x(0), y(0), z(0)
+vec4::vec4() : x(0), y(0), z(0), w(0)
 {
 }
 
@@ -16,7 +16,7 @@ vec4::vec4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w)
 
 vec4::vec4(float data[4])
 {
-    memcpy(data, this->data, 4 * sizeof(float));
+    memcpy(this->data, data, 4 * sizeof(float));
 }
 
 vec4& vec4::operator=(const vec4& other)
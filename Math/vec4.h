@@ -1,7 +1,7 @@
 #ifndef VEC4_H
 #define VEC4_H
 
-class vec4 {
+class alignas(16) vec4 {
 public:
     union
     {
@@ -14,6 +14,7 @@ public:
     vec4(float val);
     vec4(float x, float y, float z, float w);
     vec4(float data[4]);
+    vec4(const vec4& other) = default;
 
     vec4& operator=(const vec4& other);
     vec4& operator+=(const vec4& rhs);
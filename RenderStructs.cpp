@@ -4,9 +4,9 @@
 #include "VulkanUtilities.h"
 
 /// Attachment
-void Attachment::create(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkFormat colorFormat)
+void Attachment::create(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, VkExtent2D extent, VkFormat colorFormat)
 {
-    createImage(device, physicalDevice, extent.width, extent.height, 
+    createImage(device, allocator, extent.width, extent.height, 
         colorFormat, VK_IMAGE_TILING_OPTIMAL,
         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -14,7 +14,7 @@ void Attachment::create(VkDevice device, VkPhysicalDevice physicalDevice, VkExte
     createImageView(device, color, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, colorView);
 
     VkFormat depthFormat = findDepthFormat(physicalDevice);
-    createImage(device, physicalDevice, extent.width, extent.height, 
+    createImage(device, allocator, extent.width, extent.height, 
         depthFormat, VK_IMAGE_TILING_OPTIMAL, 
         VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
@@ -22,31 +22,58 @@ void Attachment::create(VkDevice device, VkPhysicalDevice physicalDevice, VkExte
     createImageView(device, depth, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, depthView);
 }
 
-void Attachment::destroy(VkDevice device)
+void Attachment::destroy(VkDevice device, MemoryAllocator& allocator)
 {
     vkDestroyImageView(device, colorView, nullptr);
-    vkDestroyImage(device, color, nullptr);
-    vkFreeMemory(device, colorMemory, nullptr);
+    destroyImage(device, allocator, color, colorMemory);
 
     vkDestroyImageView(device, depthView, nullptr);
-    vkDestroyImage(device, depth, nullptr);
-    vkFreeMemory(device, depthMemory, nullptr);
+    destroyImage(device, allocator, depth, depthMemory);
 }
 
-/// Pipeline
-void Pipeline::create(VkDevice device)
+/// FrameCommands
+void FrameCommands::create(VkDevice device, uint32_t queueFamily)
 {
-    assert( false );
+    VkCommandPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolCreateInfo.queueFamilyIndex = queueFamily;
+    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+    VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
+    cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufferAllocInfo.commandBufferCount = 1;
+
+    assert( vkCreateCommandPool(device, &poolCreateInfo, nullptr, &primaryPool) == VK_SUCCESS );
+    cmdBufferAllocInfo.commandPool = primaryPool;
+    cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    assert( vkAllocateCommandBuffers(device, &cmdBufferAllocInfo, &primary) == VK_SUCCESS );
+
+    cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    for (uint32_t i = 0; i < MAX_RECORD_TASKS; ++i)
+    {
+        assert( vkCreateCommandPool(device, &poolCreateInfo, nullptr, &pools[i]) == VK_SUCCESS );
+        cmdBufferAllocInfo.commandPool = pools[i];
+        assert( vkAllocateCommandBuffers(device, &cmdBufferAllocInfo, &secondaries[i]) == VK_SUCCESS );
+    }
+}
+
+void FrameCommands::destroy(VkDevice device)
+{
+    // Destroying a pool frees its command buffers
+    vkDestroyCommandPool(device, primaryPool, nullptr);
+    for (uint32_t i = 0; i < MAX_RECORD_TASKS; ++i)
+    {
+        vkDestroyCommandPool(device, pools[i], nullptr);
+    }
 }
 
-void Pipeline::destroy(VkDevice device)
+void FrameCommands::reset(VkDevice device)
 {
-    vkDestroyPipeline(device, scene, nullptr);
-    vkDestroyPipeline(device, composition, nullptr);
-    vkDestroyPipeline(device, imgui, nullptr);
-#if EDITOR
-    vkDestroyPipeline(device, wireframe, nullptr);
-#endif
+    assert( vkResetCommandPool(device, primaryPool, 0) == VK_SUCCESS );
+    for (uint32_t i = 0; i < MAX_RECORD_TASKS; ++i)
+    {
+        assert( vkResetCommandPool(device, pools[i], 0) == VK_SUCCESS );
+    }
 }
 
 /// Render Pass
@@ -2,6 +2,8 @@
 #define RENDER_STRUCTS_H
 
 #include <vulkan/vulkan.h> // TODO: forward declare
+#include "Rendering/MemoryAllocator.h"
+#include "Rendering/PipelineRegistry.h"
 
 struct Attachment // TODO: should I make attachment its own thing?
 {
@@ -11,32 +13,37 @@ struct Attachment // TODO: should I make attachment its own thing?
     VkImageView colorView;
     VkImageView depthView;
 
-    VkDeviceMemory colorMemory;
-    VkDeviceMemory depthMemory;
+    Allocation colorMemory;
+    Allocation depthMemory;
 
-    void create(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkFormat colorFormat);
-    void destroy(VkDevice device);
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, VkExtent2D extent, VkFormat colorFormat);
+    void destroy(VkDevice device, MemoryAllocator& allocator);
 };
 
+// The renderer's variants in the PipelineRegistry
 struct Pipeline
 {
-    VkPipeline scene;
-    VkPipeline composition; // TODO: do I want a background and composition or just 1
-    VkPipeline imgui;
+    PipelineId scene;
+    PipelineId composition; // TODO: do I want a background and composition or just 1
 #if EDITOR
-    VkPipeline wireframe;
+    PipelineId wireframe;
 #endif
+};
 
-    void create(VkDevice device);
-    void destroy(VkDevice device);
+#define MAX_RECORD_TASKS 32
 
-    private:
-    void createScene();
-    void createComposition();
-    void createImgui();
-#if EDITOR
-    void createWireframe();
-#endif
+// Command pools for one frame in flight: the primary plus one pool per recording task, so the
+// secondaries can be recorded on any worker concurrently (pools need external synchronization)
+struct FrameCommands
+{
+    VkCommandPool primaryPool;
+    VkCommandBuffer primary;
+    VkCommandPool pools[MAX_RECORD_TASKS];
+    VkCommandBuffer secondaries[MAX_RECORD_TASKS];
+
+    void create(VkDevice device, uint32_t queueFamily);
+    void destroy(VkDevice device);
+    void reset(VkDevice device); // once the frame's fence has signalled
 };
 
 struct RenderPass
@@ -2,7 +2,6 @@
 
 #include <assert.h>
 #include <iostream>
-#include <chrono>
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #define STB_IMAGE_IMPLEMENTATION
@@ -16,11 +15,33 @@
 #include "Engine.h"
 #include "Window.h"
 #include "Utilities/Defines.h"
+#include "Utilities/JobSystem.h"
+#include "Utilities/Clock.h"
+#include "Utilities/Profiler.h"
+#include "Utilities/ImageWriter.h"
+#include "Utilities/Benchmark.h"
 #include "Shaders/ShaderStructures.h"
 #include "VulkanUtilities.h"
+#include "Math/vec3.h"
 #include "Math/vec4.h"
 
 #define BASE_SUBPASS 0
+// GPU timestamps, a zone runs from its timestamp to the next
+#define TIMESTAMP_SCENE 0
+#define TIMESTAMP_COMPOSITION 1
+#define TIMESTAMP_IMGUI 2
+#define TIMESTAMP_END 3
+#define MIN_INSTANCES_PER_TASK 512 // below this a secondary costs more than it saves
+#define TRANSFORM_GRAIN 1024 // instances per job, multiple of 4 for the SIMD kernel
+#define HEADLESS_WIDTH 800 // matches the window
+#define HEADLESS_HEIGHT 600
+#define HEADLESS_FORMAT VK_FORMAT_B8G8R8A8_UNORM // what swap chains usually end up with
+#define SHADER_DIRECTORY "Shaders" // watched for changes in EDITOR builds
+#define PIPELINE_CACHE_PATH "pipeline_cache.bin" // working directory, rebuilt when the driver changes
+#define DERIVED_DATA_DIRECTORY "DerivedDataCache" // working directory, safe to delete
+#define BENCHMARK_SEED 12345u // the same scene every run
+#define BENCHMARK_TEXTURE_SIZE 64
+#define FRAME_RING_SIZE (sizeof(UniformBufferObject) + sizeof(InstanceData) * MAX_INSTANCES + 64 * 1024) // TODO: size from subsystems
 
 const Vertex vertices[] =
 {
@@ -40,19 +61,40 @@ const uint16_t indices[] = {
     // 4, 5, 6, 6, 7, 4,
 };
 
+const char* const gpuZoneNames[] = { "Scene", "Composition", "Imgui" };
+
 bool framebufferResized = false; // TODO: remove
 
 // RENDERER
 void Renderer::init()
 {
     /// VULKAN
+    m_headless = Engine::m_options.headless;
+    m_imgui = !m_headless || Engine::m_options.imgui;
+    m_benchmark = nullptr;
     createVulkanInstance();
 
     // Surface
-    assert( glfwCreateWindowSurface(m_instance, Engine::m_window.Get(), nullptr, &m_surface) == VK_SUCCESS );
+    m_surface = VK_NULL_HANDLE;
+    if (!m_headless)
+    {
+        assert( glfwCreateWindowSurface(m_instance, Engine::m_window.Get(), nullptr, &m_surface) == VK_SUCCESS );
+    }
 
+    // Anything the archive doesn't have is still loaded from loose files
+    if (!m_archive.open(Engine::m_options.archivePath) && Engine::m_options.archivePath)
+    {
+        std::cerr << "Loading loose files instead of " << Engine::m_options.archivePath << std::endl;
+    }
     createVulkanDevice();
-    createVulkanSwapChain();
+    m_derivedData.init(DERIVED_DATA_DIRECTORY);
+    m_assets.init(m_device, m_physicalDevice, m_allocator, m_uploads, m_textureRegistry, Engine::m_jobs, m_derivedData, m_archive, m_blockCompression);
+    if (m_headless) createOffscreenImages();
+    else createVulkanSwapChain();
+#if EDITOR
+    // Brings stale .spv files up to date before the pipelines read them. Packed shaders aren't watched
+    if (!m_archive.isOpen()) m_shaderWatcher.init(SHADER_DIRECTORY, Engine::m_jobs, m_derivedData);
+#endif
     createVulkanPipeline();
     // Command Pool // TODO: move back into buffers with fullscreen
     VkCommandPoolCreateInfo poolCreateInfo = {};
@@ -60,12 +102,23 @@ void Renderer::init()
     poolCreateInfo.queueFamilyIndex = m_graphicsFamily; // TODO: should this be m_graphicsQueue
     poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
     assert( vkCreateCommandPool(m_device, &poolCreateInfo, nullptr, &m_commandPool) == VK_SUCCESS );
-#if TRANSFER_FAMILY
-    poolCreateInfo.queueFamilyIndex = queueFamily.transferFamily; // TODO: should this be m_transferQueue
-    assert( vkCreateCommandPool(m_device, &poolCreateInfo, nullptr, &m_transferCommandPool) == VK_SUCCESS ); // TODO: currently doesn't work
-#endif
     createVulkanBuffers();
-    createVulkanDrawCmds();
+
+    // TODO: remove
+    m_instanceTextures = new TextureHandle[MAX_INSTANCES];
+    for (int i = 0; i < 2; ++i)
+    {
+        m_renderStates[i].textures = new TextureHandle[MAX_INSTANCES];
+    }
+    m_transforms.reserve(64);
+    m_transforms.add(vec3(-0.5f, -0.5f, -0.5f), vec3(0.0f), vec3(1.0f));
+    m_transforms.add(vec3(0.0f), vec3(0.0f), vec3(1.0f));
+    m_transforms.add(vec3(0.5f, 0.5f, -0.5f), vec3(0.0f), vec3(1.0f));
+    m_previousTransforms.copy(m_transforms);
+    // Decoded in parallel, the placeholder is drawn until each upload lands
+    m_instanceTextures[0] = m_assets.loadTexture("Resources/texture.jpg");
+    m_instanceTextures[1] = m_assets.loadTexture("Resources/sprite.png");
+    m_instanceTextures[2] = m_assets.loadTexture("Resources/texture2.jpg");
 
     createImguiContext();
     
@@ -78,6 +131,7 @@ void Renderer::init()
     fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
     
     m_currentFrame = 0;
+    m_lastImage = UINT32_MAX;
     m_imageAcquired = new VkSemaphore[MAX_FRAMES_IN_FLIGHT];
     m_renderCompleted = new VkSemaphore[MAX_FRAMES_IN_FLIGHT];
     m_framesInFlight = new VkFence[MAX_FRAMES_IN_FLIGHT];
@@ -92,6 +146,13 @@ void Renderer::init()
     {
         m_imagesInFlight[i] = VK_NULL_HANDLE;
     }
+
+    // Render thread
+    m_simState = 0;
+    m_pipelined = true;
+    m_publishedState = nullptr;
+    m_renderStopping = false;
+    m_renderThread = std::thread(&Renderer::renderLoop, this);
 }
 
 void Renderer::createVulkanInstance()
@@ -104,15 +165,18 @@ void Renderer::createVulkanInstance()
     // TODO: get from defines
     appInfo.pEngineName = "Bending";
     appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-    appInfo.apiVersion = VK_API_VERSION_1_0; // TODO: not 1_1?
+    appInfo.apiVersion = VK_API_VERSION_1_1; // properties2/features2 + maintenance3 for descriptor indexing
 
     VkInstanceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
     createInfo.pApplicationInfo = &appInfo;
 
     uint32_t glfwExtensionCount = 0;
-    const char** glfwExtensions;
-    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    const char** glfwExtensions = nullptr;
+    if (!m_headless) // no surface, GLFW isn't even initialised
+    {
+        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    }
 #if DEBUG && DEBUG_RENDERER
     uint32_t extensionCount = glfwExtensionCount + 1;
     const char* extensions[extensionCount];
@@ -202,39 +266,78 @@ void Renderer::createVulkanDevice()
     m_graphicsFamily = queueFamily.graphicsFamily;
     assert( queueFamily.graphicsFamily == queueFamily.presentFamily ); // TODO: rather than forming a set with multiple queues
 
-    VkDeviceQueueCreateInfo queueCreateInfo = {};
-    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-    queueCreateInfo.queueFamilyIndex = queueFamily.graphicsFamily;
-    queueCreateInfo.queueCount = 1;
+    VkDeviceQueueCreateInfo queueCreateInfos[2] = {};
+    uint32_t queueCreateInfoCount = 1;
     float queuePriority = 1.0f;
-    queueCreateInfo.pQueuePriorities = &queuePriority;
+    queueCreateInfos[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfos[0].queueFamilyIndex = queueFamily.graphicsFamily;
+    queueCreateInfos[0].queueCount = 1;
+    queueCreateInfos[0].pQueuePriorities = &queuePriority;
+#if TRANSFER_FAMILY
+    m_transferFamily = queueFamily.transferFamily;
+    if (m_transferFamily != m_graphicsFamily)
+    {
+        queueCreateInfos[1] = queueCreateInfos[0];
+        queueCreateInfos[1].queueFamilyIndex = m_transferFamily;
+        queueCreateInfoCount = 2;
+    }
+#else
+    m_transferFamily = m_graphicsFamily;
+#endif
 
     VkPhysicalDeviceFeatures deviceFeatures = {};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
+    deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
 #if EDITOR
     deviceFeatures.fillModeNonSolid = VK_TRUE;
 #endif
+    // Block compressed textures wherever they can be sampled and filtered
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+    const VkFormatFeatureFlags textureFeatures = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    m_blockCompression = supportedFeatures.textureCompressionBC &&
+        isFormatSupported(m_physicalDevice, VK_FORMAT_BC1_RGB_UNORM_BLOCK, textureFeatures) &&
+        isFormatSupported(m_physicalDevice, VK_FORMAT_BC3_UNORM_BLOCK, textureFeatures);
+    deviceFeatures.textureCompressionBC = m_blockCompression;
+    // Bindless textures (see TextureRegistry)
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    indexingFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+    indexingFeatures.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    indexingFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    indexingFeatures.descriptorBindingPartiallyBound = VK_TRUE;
+    indexingFeatures.descriptorBindingVariableDescriptorCount = VK_TRUE;
+    indexingFeatures.runtimeDescriptorArray = VK_TRUE;
+
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-    deviceCreateInfo.queueCreateInfoCount = 1;
-    deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+    deviceCreateInfo.pNext = &indexingFeatures;
+    deviceCreateInfo.queueCreateInfoCount = queueCreateInfoCount;
+    deviceCreateInfo.pQueueCreateInfos = queueCreateInfos;
     deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
-    deviceCreateInfo.enabledExtensionCount = sizeof(requiredExtensions) / sizeof(char*);
-    deviceCreateInfo.ppEnabledExtensionNames = requiredExtensions;
+    uint32_t skippedExtensions = m_headless ? 1 : 0; // VK_KHR_swapchain
+    deviceCreateInfo.enabledExtensionCount = sizeof(requiredExtensions) / sizeof(char*) - skippedExtensions;
+    deviceCreateInfo.ppEnabledExtensionNames = requiredExtensions + skippedExtensions;
     // TODO: backwards compatible set enabledLayerCount & ppEnabledLayeredNames
 
     assert( vkCreateDevice(m_physicalDevice, &deviceCreateInfo, nullptr, &m_device) == VK_SUCCESS );
+    m_allocator.init(m_device, m_physicalDevice);
+    m_textureRegistry.init(m_device, m_physicalDevice);
+    m_gpuProfiler.init(m_device, m_physicalDevice, m_graphicsFamily, MAX_FRAMES_IN_FLIGHT, gpuZoneNames, TIMESTAMP_END);
+    m_pipelineCache.init(m_device, m_physicalDevice, PIPELINE_CACHE_PATH);
+    m_pipelines.init(m_device, m_pipelineCache.get(), Engine::m_jobs, m_archive, MAX_FRAMES_IN_FLIGHT);
 
     vkGetDeviceQueue(m_device, queueFamily.graphicsFamily,  0, &m_graphicsQueue);
     vkGetDeviceQueue(m_device, queueFamily.presentFamily,   0, &m_presentQueue);
-#if TRANSFER_FAMILY
-    vkGetDeviceQueue(m_device, queueFamily.transferFamily,  0, &m_transferQueue);
-#endif
+    vkGetDeviceQueue(m_device, m_transferFamily,            0, &m_transferQueue);
+
+    m_uploads.init(m_device, m_allocator, m_graphicsFamily, m_graphicsQueue, m_transferFamily, m_transferQueue);
 }
 
 void Renderer::createVulkanSwapChain()
 {
     // Swap Chain
+    m_offscreenMemory = nullptr;
     SwapChainSupportDetails swapChainSupport = querySwapChainSupport(m_physicalDevice, m_surface);
     VkSurfaceFormatKHR surfaceFormat = selectSwapSurfaceFormat(swapChainSupport.formats, swapChainSupport.formatCount);
     VkPresentModeKHR presentMode = selectSwapPresentMode(swapChainSupport.presentModes, swapChainSupport.presentModeCount);
@@ -268,11 +371,7 @@ void Renderer::createVulkanSwapChain()
     //     swapChainCreateInfo.pQueueFamilyIndices = queueFamilyIndices;
     // } else
 
-#if TRANSFER_FAMILY
-    swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-#else
-    swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-#endif
+    swapChainCreateInfo.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE; // never touched by the transfer queue
     swapChainCreateInfo.queueFamilyIndexCount = 0;
     swapChainCreateInfo.pQueueFamilyIndices = nullptr;
     
@@ -299,54 +398,34 @@ void Renderer::createVulkanSwapChain()
     }
 }
 
-void Renderer::createVulkanPipeline()
+void Renderer::createOffscreenImages()
 {
-    // Shaders
-    VkShaderModule vert = createShaderModule(m_device, "Shaders/Pipelines/Default/Default.vert.spv");
-    VkShaderModule frag = createShaderModule(m_device, "Shaders/Pipelines/Default/Default.frag.spv");
-
-    VkPipelineShaderStageCreateInfo vertCreateInfo = {};
-    vertCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertCreateInfo.module = vert;
-    vertCreateInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo fragStageCreateInfo = {};
-    fragStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragStageCreateInfo.module = frag;
-    fragStageCreateInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = 
+    // Stand ins for the swap chain, copyable so the last frame can be read back
+    m_swapChain = VK_NULL_HANDLE;
+    m_swapChainImageFormat = HEADLESS_FORMAT;
+    m_swapChainExtent = { HEADLESS_WIDTH, HEADLESS_HEIGHT };
+    m_swapChainImageCount = MAX_FRAMES_IN_FLIGHT;
+    m_swapChainImages = new VkImage[m_swapChainImageCount];
+    m_swapChainImageViews = new VkImageView[m_swapChainImageCount];
+    m_offscreenMemory = new Allocation[m_swapChainImageCount];
+    for (int i = 0; i < m_swapChainImageCount; ++i)
     {
-        vertCreateInfo,
-        fragStageCreateInfo
-    };
-
-    VkVertexInputBindingDescription bindingDesc = Vertex::bindingDesc();
-    VkVertexInputAttributeDescription vertexInputDesc[] = { 
-        Vertex::positionAttribute(),
-        Vertex::colorAttribute(),
-        Vertex::uvAttribute(),
-    };
-
-    VkPipelineVertexInputStateCreateInfo vertInputCreateInfo = {};
-    vertInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertInputCreateInfo.vertexBindingDescriptionCount = 1;
-    vertInputCreateInfo.pVertexBindingDescriptions = &bindingDesc;
-    vertInputCreateInfo.vertexAttributeDescriptionCount = sizeof(vertexInputDesc) / sizeof(VkVertexInputAttributeDescription);
-    vertInputCreateInfo.pVertexAttributeDescriptions = vertexInputDesc;
-
-    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
-    inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+        createImage(m_device, m_allocator, m_swapChainExtent.width, m_swapChainExtent.height, m_swapChainImageFormat,
+            VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_swapChainImages[i], m_offscreenMemory[i]);
+        createImageView(m_device, m_swapChainImages[i], m_swapChainImageFormat, VK_IMAGE_ASPECT_COLOR_BIT, m_swapChainImageViews[i]);
+    }
+}
 
+void Renderer::createVulkanPipeline()
+{
+    PROFILE_ZONE(m_pipelineCache.isWarm() ? "createVulkanPipeline (warm cache)" : "createVulkanPipeline (cold cache)");
+    // Descriptor Set Layouts
     {
         // Uniform Buffer
         VkDescriptorSetLayoutBinding uboLayoutBinding = {};
         uboLayoutBinding.binding = 0;
-        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uboLayoutBinding.descriptorCount = 1;
         uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
         uboLayoutBinding.pImmutableSamplers = nullptr;
@@ -359,14 +438,14 @@ void Renderer::createVulkanPipeline()
         samplerLayoutBinding.pImmutableSamplers = nullptr;
         samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-        VkDescriptorSetLayoutBinding imageLayoutBinding = {};
-        imageLayoutBinding.binding = 2;
-        imageLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-        imageLayoutBinding.descriptorCount = 64;
-        imageLayoutBinding.pImmutableSamplers = nullptr;
-        imageLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        VkDescriptorSetLayoutBinding instanceLayoutBinding = {};
+        instanceLayoutBinding.binding = 3;
+        instanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        instanceLayoutBinding.descriptorCount = 1;
+        instanceLayoutBinding.pImmutableSamplers = nullptr;
+        instanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
-        VkDescriptorSetLayoutBinding bindings[] = { uboLayoutBinding, samplerLayoutBinding, imageLayoutBinding };
+        VkDescriptorSetLayoutBinding bindings[] = { uboLayoutBinding, samplerLayoutBinding, instanceLayoutBinding }; // binding 2 moved to TextureRegistry
         VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
         layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         layoutCreateInfo.bindingCount = sizeof(bindings) / sizeof(VkDescriptorSetLayoutBinding);
@@ -374,114 +453,46 @@ void Renderer::createVulkanPipeline()
         assert( vkCreateDescriptorSetLayout(m_device, &layoutCreateInfo, nullptr, &m_descriptorLayout) == VK_SUCCESS );
     }
 
-    // Viewport + Scissor
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = m_swapChainExtent.width;
-    viewport.height = m_swapChainExtent.height;
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = m_swapChainExtent;
-
-    VkPipelineViewportStateCreateInfo viewportCreateInfo = {};
-    viewportCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportCreateInfo.viewportCount = 1;
-    viewportCreateInfo.pViewports = &viewport;
-    viewportCreateInfo.scissorCount = 1;
-    viewportCreateInfo.pScissors = &scissor;
-
-    // Rasterizer
-    VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
-    rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-    rasterizerCreateInfo.depthClampEnable = VK_FALSE;
-    rasterizerCreateInfo.rasterizerDiscardEnable = VK_FALSE;
-    rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterizerCreateInfo.lineWidth = 1.0f; // > 1.0f requires wideLines
-    rasterizerCreateInfo.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-    rasterizerCreateInfo.depthBiasEnable = VK_FALSE;
-    rasterizerCreateInfo.depthBiasConstantFactor = 0.0f;
-    rasterizerCreateInfo.depthBiasClamp = 0.0f;
-    rasterizerCreateInfo.depthBiasSlopeFactor = 0.0f;
-
-    // Multisampling
-    VkPipelineMultisampleStateCreateInfo multisampleCreateInfo = {};
-    multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-    multisampleCreateInfo.sampleShadingEnable = VK_FALSE;
-    multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
-    multisampleCreateInfo.minSampleShading = 1.0f;
-    multisampleCreateInfo.pSampleMask = nullptr;
-    multisampleCreateInfo.alphaToCoverageEnable = VK_FALSE;
-    multisampleCreateInfo.alphaToOneEnable = VK_FALSE;
-
-    // Depth + Stencil
-    VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
-    depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-    depthStencilCreateInfo.depthTestEnable = VK_TRUE;
-    depthStencilCreateInfo.depthWriteEnable = VK_TRUE;
-    depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
-    depthStencilCreateInfo.depthBoundsTestEnable = VK_FALSE;
-    depthStencilCreateInfo.minDepthBounds = -1.0f;
-    depthStencilCreateInfo.maxDepthBounds = 1.0f;
-    depthStencilCreateInfo.stencilTestEnable = VK_FALSE; // TODO: Stencil
-
-    VkPipelineColorBlendAttachmentState blendAttachment = {};
-    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-                                     VK_COLOR_COMPONENT_G_BIT |
-                                     VK_COLOR_COMPONENT_B_BIT |
-                                     VK_COLOR_COMPONENT_A_BIT;
-    // blendAttachment.blendEnable = VK_FALSE;
-    // blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
-    // blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
-    // blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    // blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
-    // blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
-    // blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-    blendAttachment.blendEnable = VK_TRUE;
-    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
-    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
-    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
-    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
-
-    VkPipelineColorBlendStateCreateInfo blendCreateInfo = {};
-    blendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-    blendCreateInfo.logicOpEnable = VK_FALSE;
-    blendCreateInfo.logicOp = VK_LOGIC_OP_COPY;
-    blendCreateInfo.attachmentCount = 1;
-    blendCreateInfo.pAttachments = &blendAttachment;
-    blendCreateInfo.blendConstants[0] = 0.0f;
-    blendCreateInfo.blendConstants[1] = 0.0f;
-    blendCreateInfo.blendConstants[2] = 0.0f;
-    blendCreateInfo.blendConstants[3] = 0.0f;
-
-    // VkPipelineDynamicStateCreateInfo // TODO: dynamic state
-
-    VkPushConstantRange vsPushConstantRange = {};
-    vsPushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    vsPushConstantRange.offset = 0;
-    vsPushConstantRange.size = sizeof(VsPushConstants);
-
-    VkPushConstantRange fsPushConstantRange = {};
-    fsPushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fsPushConstantRange.offset = sizeof(VsPushConstants);
-    fsPushConstantRange.size = sizeof(FsPushConstants);
-    VkPushConstantRange pushConstantRange[] = { vsPushConstantRange, fsPushConstantRange };
+    {
+        VkDescriptorSetLayoutBinding colorLayoutBinding = {};
+        colorLayoutBinding.binding = 0;
+        colorLayoutBinding.descriptorCount = 1;
+        colorLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+        colorLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+        VkDescriptorSetLayoutBinding uboLayoutBinding = {};
+        uboLayoutBinding.binding = 1;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        uboLayoutBinding.descriptorCount = 1;
+        uboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+        uboLayoutBinding.pImmutableSamplers = nullptr;
+
+        VkDescriptorSetLayoutBinding bindings[] = { colorLayoutBinding, uboLayoutBinding };
+        VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+        layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutCreateInfo.bindingCount = sizeof(bindings) / sizeof(VkDescriptorSetLayoutBinding);
+        layoutCreateInfo.pBindings = bindings;
+        assert( vkCreateDescriptorSetLayout(m_device, &layoutCreateInfo, nullptr, &m_compositionDescriptorLayout) == VK_SUCCESS );
+    }
 
+    // Pipeline Layouts
+    // Per instance data comes from the instance storage buffer (binding 3), textures from the bindless set
+    VkDescriptorSetLayout setLayouts[] = { m_descriptorLayout, m_textureRegistry.layout() }; // TEXTURE_SET
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
     pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutCreateInfo.setLayoutCount = 1;
-    pipelineLayoutCreateInfo.pSetLayouts = &m_descriptorLayout;
-    pipelineLayoutCreateInfo.pushConstantRangeCount = sizeof(pushConstantRange) / sizeof(VkPushConstantRange);
-    pipelineLayoutCreateInfo.pPushConstantRanges = pushConstantRange;
+    pipelineLayoutCreateInfo.setLayoutCount = sizeof(setLayouts) / sizeof(VkDescriptorSetLayout);
+    pipelineLayoutCreateInfo.pSetLayouts = setLayouts;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
     assert( vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &m_pipelineLayout) == VK_SUCCESS );
 
+    pipelineLayoutCreateInfo = {};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &m_compositionDescriptorLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
+    pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+    assert( vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &m_compositionPipelineLayout) == VK_SUCCESS );
     // Render Pass
     VkAttachmentDescription colorAttachmentDesc = {};
     colorAttachmentDesc.format = m_swapChainImageFormat;
@@ -579,163 +590,60 @@ void Renderer::createVulkanPipeline()
     renderPassCreateInfo.pDependencies = subpassDependencies;
     assert( vkCreateRenderPass(m_device, &renderPassCreateInfo, nullptr, &m_renderPass.scene) == VK_SUCCESS );
 
-    // Pipeline
-    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
-    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.stageCount = 2;
-    pipelineCreateInfo.pStages = shaderStages;
-    pipelineCreateInfo.pVertexInputState = &vertInputCreateInfo;
-    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
-    pipelineCreateInfo.pViewportState = &viewportCreateInfo;
-    pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
-    pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
-    pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
-    pipelineCreateInfo.pColorBlendState = &blendCreateInfo;
-    pipelineCreateInfo.pDynamicState = nullptr;
-
-    pipelineCreateInfo.layout = m_pipelineLayout;
-    pipelineCreateInfo.renderPass = m_renderPass.scene;
-    pipelineCreateInfo.subpass = BASE_SUBPASS;
-    pipelineCreateInfo.flags = VK_PIPELINE_CREATE_ALLOW_DERIVATIVES_BIT;
-
-    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
-#if EDITOR
-    // TODO: https://github.com/LunarG/VulkanSamples/blob/master/API-Samples/pipeline_cache/pipeline_cache.cpp
-
-    // VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
-    // pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-    // pipelineCacheCreateInfo.pNext = nullptr;
-
-    // assert( vkCreatePipelineCache(m_device, &pipelineCacheCreateInfo, nullptr, &pipelineCache) == VK_SUCCESS );
-    // TODO: store pipeline cache as member variable, write to file w/ vkGetPipelineCacheData
-#endif
-
-    // General
-    assert( vkCreateGraphicsPipelines(m_device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &m_pipeline.scene) == VK_SUCCESS );
-
-    vkDestroyShaderModule(m_device, vert, nullptr);
-    vkDestroyShaderModule(m_device, frag, nullptr);
-
-    pipelineCreateInfo.flags = VK_PIPELINE_CREATE_DERIVATIVE_BIT;
-    pipelineCreateInfo.basePipelineHandle = m_pipeline.scene;
-    pipelineCreateInfo.basePipelineIndex = -1;
+    // Variants compile in parallel on the job system, the first frame waits for any still running
+    PipelineDesc sceneDesc = {};
+    sceneDesc.vertexShader = "Shaders/Pipelines/Default/Default.vert.spv";
+    sceneDesc.fragmentShader = "Shaders/Pipelines/Default/Default.frag.spv";
+    sceneDesc.vertexStride = sizeof(Vertex);
+    sceneDesc.attributes[0] = Vertex::positionAttribute();
+    sceneDesc.attributes[1] = Vertex::colorAttribute();
+    sceneDesc.attributes[2] = Vertex::uvAttribute();
+    sceneDesc.attributeCount = 3;
+    sceneDesc.cullMode = VK_CULL_MODE_BACK_BIT;
+    sceneDesc.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    sceneDesc.depthTest = true;
+    sceneDesc.alphaBlend = true;
+    sceneDesc.extent = m_swapChainExtent;
+    sceneDesc.layout = m_pipelineLayout;
+    sceneDesc.renderPass = m_renderPass.scene;
+    sceneDesc.subpass = BASE_SUBPASS;
+    m_pipeline.scene = m_pipelines.request(sceneDesc);
 
     // Composition
     {
-        VkGraphicsPipelineCreateInfo compositionPipelineCreateInfo = pipelineCreateInfo;
-        compositionPipelineCreateInfo.subpass = BASE_SUBPASS + 1;
-        compositionPipelineCreateInfo.pDepthStencilState = nullptr;
-
-        vert = createShaderModule(m_device, "Shaders/Basics/Fullscreen.vert.spv");
-        frag = createShaderModule(m_device, "Shaders/Pipelines/Background/Gradient.frag.spv");
-        // frag = createShaderModule(m_device, "Shaders/Pipelines/Background/Solid.frag.spv");
-        shaderStages[0].module = vert;
-        shaderStages[1].module = frag;
+        PipelineDesc compositionDesc = sceneDesc;
+        compositionDesc.vertexShader = "Shaders/Basics/FullScreen.vert.spv";
+        compositionDesc.fragmentShader = "Shaders/Pipelines/Background/Gradient.frag.spv";
+        // compositionDesc.fragmentShader = "Shaders/Pipelines/Background/Solid.frag.spv";
         // TODO: enable different types of backgrounds (changable at runtime?)
-
-        VkSpecializationMapEntry colorCountMapEntry = {};
-        colorCountMapEntry.constantID = 0;
-        colorCountMapEntry.size = sizeof(int);
-        colorCountMapEntry.offset = 0;
-        int colorCount = m_colorCount;
-
-        VkSpecializationInfo specializationInfo = {};
-        specializationInfo.mapEntryCount = 1;
-        specializationInfo.pMapEntries = &colorCountMapEntry;
-        specializationInfo.dataSize = sizeof(int);
-        specializationInfo.pData = &colorCount;
-
-        VkPipelineShaderStageCreateInfo d_fragStageCreateInfo = fragStageCreateInfo;
-        d_fragStageCreateInfo.pSpecializationInfo = &specializationInfo;
-        d_fragStageCreateInfo.module = frag;
-        VkPipelineShaderStageCreateInfo d_shaderStages[] = {
-            shaderStages[0],
-            d_fragStageCreateInfo
-        };
-        compositionPipelineCreateInfo.pStages = d_shaderStages;
-
-        // Vertex Input
-        VkPipelineVertexInputStateCreateInfo d_vertInputCreateInfo = {};
-        d_vertInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-        compositionPipelineCreateInfo.pVertexInputState = &d_vertInputCreateInfo;
-
-        {
-            VkDescriptorSetLayoutBinding colorLayoutBinding = {};
-            colorLayoutBinding.binding = 0;
-            colorLayoutBinding.descriptorCount = 1;
-            colorLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-            colorLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-
-            VkDescriptorSetLayoutBinding uboLayoutBinding = {};
-            uboLayoutBinding.binding = 1;
-            uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            uboLayoutBinding.descriptorCount = 1;
-            uboLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-            uboLayoutBinding.pImmutableSamplers = nullptr;
-
-            VkDescriptorSetLayoutBinding bindings[] = { colorLayoutBinding, uboLayoutBinding };
-            VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
-            layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-            layoutCreateInfo.bindingCount = sizeof(bindings) / sizeof(VkDescriptorSetLayoutBinding);
-            layoutCreateInfo.pBindings = bindings;
-            assert( vkCreateDescriptorSetLayout(m_device, &layoutCreateInfo, nullptr, &m_compositionDescriptorLayout) == VK_SUCCESS );
-        }
-
-        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
-        pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutCreateInfo.setLayoutCount = 1;
-        pipelineLayoutCreateInfo.pSetLayouts = &m_compositionDescriptorLayout;
-        pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-        pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
-        assert( vkCreatePipelineLayout(m_device, &pipelineLayoutCreateInfo, nullptr, &m_compositionPipelineLayout) == VK_SUCCESS );
-        compositionPipelineCreateInfo.layout = m_compositionPipelineLayout;
-
-        // Rasterization
-        VkPipelineRasterizationStateCreateInfo d_rasterizerCreateInfo = rasterizerCreateInfo;
-        d_rasterizerCreateInfo.cullMode = VK_CULL_MODE_FRONT_BIT;
-        d_rasterizerCreateInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-        compositionPipelineCreateInfo.pRasterizationState = &d_rasterizerCreateInfo;
-
-        assert( vkCreateGraphicsPipelines(m_device, nullptr, 1, &compositionPipelineCreateInfo, nullptr, &m_pipeline.composition) == VK_SUCCESS );
-
-        vkDestroyShaderModule(m_device, vert, nullptr);
-        vkDestroyShaderModule(m_device, frag, nullptr);
+        compositionDesc.constants[0] = m_colorCount; // ColorCount
+        compositionDesc.constants[1] = VK_TRUE; // Vertical
+        compositionDesc.constantCount = 2;
+        compositionDesc.vertexStride = 0;
+        compositionDesc.attributeCount = 0;
+        compositionDesc.cullMode = VK_CULL_MODE_FRONT_BIT;
+        compositionDesc.depthTest = false;
+        compositionDesc.layout = m_compositionPipelineLayout;
+        compositionDesc.subpass = BASE_SUBPASS + 1;
+        m_pipeline.composition = m_pipelines.request(compositionDesc);
     }
 
 #if EDITOR
     // Wireframe
     {
-        VkGraphicsPipelineCreateInfo wireframeCreateInfo = pipelineCreateInfo;
-
-        // Shaders
-        vert = createShaderModule(m_device, "Shaders/Pipelines/Wireframe/Wireframe.vert.spv");
-        frag = createShaderModule(m_device, "Shaders/Pipelines/Wireframe/Wireframe.frag.spv");
-        shaderStages[0].module = vert;
-        shaderStages[1].module = frag;
-
-        // Vertex Input
-        VkPipelineVertexInputStateCreateInfo d_vertInputCreateInfo = vertInputCreateInfo;
-        VkVertexInputAttributeDescription positionAttribute = Vertex::positionAttribute();
-        d_vertInputCreateInfo.vertexAttributeDescriptionCount = 1;
-        d_vertInputCreateInfo.pVertexAttributeDescriptions = &positionAttribute;
-        wireframeCreateInfo.pVertexInputState = &d_vertInputCreateInfo;
-
-        // Rasterization
-        VkPipelineRasterizationStateCreateInfo d_rasterizerCreateInfo = rasterizerCreateInfo;
-        d_rasterizerCreateInfo.polygonMode = VK_POLYGON_MODE_LINE;
-        wireframeCreateInfo.pRasterizationState = &d_rasterizerCreateInfo;
-
-        assert( vkCreateGraphicsPipelines(m_device, nullptr, 1, &wireframeCreateInfo, nullptr, &m_pipeline.wireframe) == VK_SUCCESS );
-
-        vkDestroyShaderModule(m_device, vert, nullptr);
-        vkDestroyShaderModule(m_device, frag, nullptr);
+        PipelineDesc wireframeDesc = sceneDesc;
+        wireframeDesc.vertexShader = "Shaders/Pipelines/Wireframe/Wireframe.vert.spv";
+        wireframeDesc.fragmentShader = "Shaders/Pipelines/Wireframe/Wireframe.frag.spv";
+        wireframeDesc.attributeCount = 1; // position
+        wireframeDesc.polygonMode = VK_POLYGON_MODE_LINE;
+        m_pipeline.wireframe = m_pipelines.request(wireframeDesc);
     }
 #endif
 }
 
 void Renderer::createVulkanBuffers()
 {
-    m_attachments.create(m_device, m_physicalDevice, m_swapChainExtent, m_swapChainImageFormat);
+    m_attachments.create(m_device, m_physicalDevice, m_allocator, m_swapChainExtent, m_swapChainImageFormat);
 
     // Framebuffer
     m_sceneFramebuffers = new VkFramebuffer[m_swapChainImageCount];
@@ -758,103 +666,6 @@ void Renderer::createVulkanBuffers()
         assert( vkCreateFramebuffer(m_device, &framebufferCreateInfo, nullptr, &m_sceneFramebuffers[i]) == VK_SUCCESS );
     }
 
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingBufferMemory;
-    void* data;
-    const int BufferMemoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-
-    // Texture Image
-    m_texImage = new VkImage[64];
-    m_texImageMemory = new VkDeviceMemory[64];
-    m_texImageView = new VkImageView[64];
-    {
-        int texWidth, texHeight, texChannels;
-        stbi_uc* texPixels = stbi_load("Resources/texture.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        VkDeviceSize texSize = texWidth * texHeight * 4;
-        assert( texPixels );
-        createBuffer(m_device, m_physicalDevice,
-                    texSize, 
-                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                    BufferMemoryProperty,
-                    stagingBuffer, stagingBufferMemory);
-        vkMapMemory(m_device, stagingBufferMemory, 0, texSize, 0, &data);
-        memcpy(data, texPixels, texSize);
-        vkUnmapMemory(m_device, stagingBufferMemory);
-        stbi_image_free(texPixels);
-
-        createImage(m_device, m_physicalDevice, texWidth, texHeight, 
-            VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT,
-            m_texImage[0], m_texImageMemory[0]);
-
-    #if TRANSFER_FAMILY
-        copyImage(m_device, m_commandPool, m_transferQueue, stagingBuffer, m_texImage[0], texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM);
-    #else
-        copyImage(m_device, m_commandPool, m_graphicsQueue, stagingBuffer, m_texImage[0], texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM);
-    #endif
-        vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-        vkFreeMemory(m_device, stagingBufferMemory, nullptr);
-
-        createImageView(m_device, m_texImage[0], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, m_texImageView[0]);
-    }
-    {
-        int texWidth, texHeight, texChannels;
-        stbi_uc* texPixels = stbi_load("Resources/sprite.png", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        VkDeviceSize texSize = texWidth * texHeight * 4;
-        assert( texPixels );
-        createBuffer(m_device, m_physicalDevice,
-                    texSize, 
-                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                    BufferMemoryProperty,
-                    stagingBuffer, stagingBufferMemory);
-        vkMapMemory(m_device, stagingBufferMemory, 0, texSize, 0, &data);
-        memcpy(data, texPixels, texSize);
-        vkUnmapMemory(m_device, stagingBufferMemory);
-        stbi_image_free(texPixels);
-
-        createImage(m_device, m_physicalDevice, texWidth, texHeight, 
-            VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT,
-            m_texImage[1], m_texImageMemory[1]);
-
-    #if TRANSFER_FAMILY
-        copyImage(m_device, m_commandPool, m_transferQueue, stagingBuffer, m_texImage[0], texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM);
-    #else
-        copyImage(m_device, m_commandPool, m_graphicsQueue, stagingBuffer, m_texImage[1], texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM);
-    #endif
-        vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-        vkFreeMemory(m_device, stagingBufferMemory, nullptr);
-
-        createImageView(m_device, m_texImage[1], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, m_texImageView[1]);
-    }
-    {
-        int texWidth, texHeight, texChannels;
-        stbi_uc* texPixels = stbi_load("Resources/texture2.jpg", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        VkDeviceSize texSize = texWidth * texHeight * 4;
-        assert( texPixels );
-        createBuffer(m_device, m_physicalDevice,
-                    texSize, 
-                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                    BufferMemoryProperty,
-                    stagingBuffer, stagingBufferMemory);
-        vkMapMemory(m_device, stagingBufferMemory, 0, texSize, 0, &data);
-        memcpy(data, texPixels, texSize);
-        vkUnmapMemory(m_device, stagingBufferMemory);
-        stbi_image_free(texPixels);
-
-        createImage(m_device, m_physicalDevice, texWidth, texHeight, 
-            VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT,
-            m_texImage[2], m_texImageMemory[2]);
-
-    #if TRANSFER_FAMILY
-        copyImage(m_device, m_commandPool, m_transferQueue, stagingBuffer, m_texImage[0], texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM);
-    #else
-        copyImage(m_device, m_commandPool, m_graphicsQueue, stagingBuffer, m_texImage[2], texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM);
-    #endif
-        vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-        vkFreeMemory(m_device, stagingBufferMemory, nullptr);
-
-        createImageView(m_device, m_texImage[2], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, m_texImageView[2]);
-    }
-
     // Sampler
     VkSamplerCreateInfo samplerCreateInfo = {};
     samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -872,74 +683,40 @@ void Renderer::createVulkanBuffers()
     samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     samplerCreateInfo.mipLodBias = 0.0f;
     samplerCreateInfo.minLod = 0.0f;
-    samplerCreateInfo.maxLod = 0.0f;
+    samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE; // each view limits it to the levels its texture has
     assert( vkCreateSampler(m_device, &samplerCreateInfo, nullptr, &m_texSampler) == VK_SUCCESS );
 
     // Vertex + Index Buffer
-    size_t bufferSize = sizeof(vertices) + sizeof(indices);
-
-    createBuffer(m_device, m_physicalDevice,
-        bufferSize, 
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        // TODO: VK_MEMORY_PROPERTY_HOST_COHERENT_BIT worse performance. use flushing
-        BufferMemoryProperty,
-        stagingBuffer, stagingBufferMemory);
-    
-    vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices, sizeof(vertices));
-    data = static_cast<char*>(data) + sizeof(vertices);
-    memcpy(data, indices, sizeof(indices));
-    vkUnmapMemory(m_device, stagingBufferMemory);
-
-    createBuffer(m_device, m_physicalDevice,
-        bufferSize, 
+    createBuffer(m_device, m_allocator,
+        sizeof(vertices) + sizeof(indices), 
         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
         m_vertexIndexBuffer, m_vertexIndexBufferMemory);
-#if TRANSFER_FAMILY
-    copyBuffer(m_device, m_commandPool, m_transferQueue, stagingBuffer, m_vertexIndexBuffer, bufferSize);
-#else
-    copyBuffer(m_device, m_commandPool, m_graphicsQueue, stagingBuffer, m_vertexIndexBuffer, bufferSize);
-#endif
-    vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-    vkFreeMemory(m_device, stagingBufferMemory, nullptr);
-
-    // Uniform Buffer
-    m_uniformBuffers = new VkBuffer[m_swapChainImageCount];
-    m_uniformBuffersMemory = new VkDeviceMemory[m_swapChainImageCount];
-    m_colorBuffers = new VkBuffer[m_swapChainImageCount];
-    m_colorBuffersMemory = new VkDeviceMemory[m_swapChainImageCount];
-    VkDeviceSize uniformBufferSize = sizeof(UniformBufferObject);
-    VkDeviceSize colorBufferSize = sizeof(vec4) * m_colorCount;
-    for (int i = 0; i < m_swapChainImageCount; ++i)
-    {
-        createBuffer(m_device, m_physicalDevice,
-            uniformBufferSize,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            BufferMemoryProperty,
-            m_uniformBuffers[i], m_uniformBuffersMemory[i]);
-        
-        createBuffer(m_device, m_physicalDevice,
-            colorBufferSize,
-            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            BufferMemoryProperty,
-            m_colorBuffers[i], m_colorBuffersMemory[i]);
-    }
+    m_uploads.uploadBuffer(m_vertexIndexBuffer, 0, vertices, sizeof(vertices));
+    m_uploads.uploadBuffer(m_vertexIndexBuffer, sizeof(vertices), indices, sizeof(indices));
+    // One submission for everything above, the draws are queued behind it on the graphics queue
+    m_uploads.submit();
+
+    // Frame Ring Buffer (uniform + instance data, one region per swap chain image)
+    m_frameRing.create(m_device, m_physicalDevice, m_allocator,
+        FRAME_RING_SIZE,
+        m_swapChainImageCount,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
 
     {
         VkDescriptorPoolSize uboDescPoolSize = {};
-        uboDescPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboDescPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uboDescPoolSize.descriptorCount = m_swapChainImageCount;
 
         VkDescriptorPoolSize samplerDescPoolSize = {};
         samplerDescPoolSize.type = VK_DESCRIPTOR_TYPE_SAMPLER;
         samplerDescPoolSize.descriptorCount = m_swapChainImageCount;
 
-        VkDescriptorPoolSize imageDescPoolSize = {};
-        imageDescPoolSize.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-        imageDescPoolSize.descriptorCount = m_swapChainImageCount * 64;
+        VkDescriptorPoolSize instanceDescPoolSize = {};
+        instanceDescPoolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+        instanceDescPoolSize.descriptorCount = m_swapChainImageCount;
 
-        VkDescriptorPoolSize descPoolSize[] = { uboDescPoolSize, samplerDescPoolSize, imageDescPoolSize };
+        VkDescriptorPoolSize descPoolSize[] = { uboDescPoolSize, samplerDescPoolSize, instanceDescPoolSize };
         VkDescriptorPoolCreateInfo descPoolCreateInfo = {};
         descPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         descPoolCreateInfo.poolSizeCount = sizeof(descPoolSize) / sizeof(VkDescriptorPoolSize);
@@ -954,7 +731,7 @@ void Renderer::createVulkanBuffers()
         inputDescPoolSize.descriptorCount = m_swapChainImageCount;
 
         VkDescriptorPoolSize uboDescPoolSize = {};
-        uboDescPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboDescPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uboDescPoolSize.descriptorCount = m_swapChainImageCount;
 
         VkDescriptorPoolSize descPoolSize[] = { inputDescPoolSize, uboDescPoolSize };
@@ -997,22 +774,6 @@ void Renderer::createVulkanBuffers()
     samplerImageInfo.imageView = VK_NULL_HANDLE;
     samplerImageInfo.sampler = m_texSampler;
 
-    VkDescriptorImageInfo imagesImageInfo[64];
-    for (int i = 0; i < m_instances; ++i)
-    {
-        imagesImageInfo[i] = {};
-        imagesImageInfo[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imagesImageInfo[i].imageView = m_texImageView[i];
-        imagesImageInfo[i].sampler = nullptr;
-    }
-    for (int i = m_instances; i < 64; ++i)
-    {
-        imagesImageInfo[i] = {};
-        imagesImageInfo[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imagesImageInfo[i].imageView = m_texImageView[0];
-        imagesImageInfo[i].sampler = nullptr;
-    }
-
     VkDescriptorImageInfo compositionColorImageInfo = {};
     compositionColorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     compositionColorImageInfo.imageView = m_attachments.colorView;
@@ -1022,7 +783,7 @@ void Renderer::createVulkanBuffers()
     {
         {
             VkDescriptorBufferInfo descBufferInfo = {};
-            descBufferInfo.buffer = m_uniformBuffers[i];
+            descBufferInfo.buffer = m_frameRing.buffer;
             descBufferInfo.offset = 0;
             descBufferInfo.range = sizeof(UniformBufferObject);
 
@@ -1031,7 +792,7 @@ void Renderer::createVulkanBuffers()
             uboWriteDescSet.dstSet = m_descriptorSets[i];
             uboWriteDescSet.dstBinding = 0;
             uboWriteDescSet.dstArrayElement = 0;
-            uboWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            uboWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             uboWriteDescSet.descriptorCount = 1;
             uboWriteDescSet.pBufferInfo = &descBufferInfo;
             uboWriteDescSet.pImageInfo = nullptr;
@@ -1048,17 +809,22 @@ void Renderer::createVulkanBuffers()
             samplerWriteDescSet.pImageInfo = &samplerImageInfo;
             samplerWriteDescSet.pNext = nullptr;
 
-            VkWriteDescriptorSet imageWriteDescSet = {};
-            imageWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            imageWriteDescSet.dstSet = m_descriptorSets[i];
-            imageWriteDescSet.dstBinding = 2;
-            imageWriteDescSet.dstArrayElement = 0;
-            imageWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-            imageWriteDescSet.descriptorCount = 64;
-            imageWriteDescSet.pImageInfo = imagesImageInfo;
-            imageWriteDescSet.pNext = nullptr;
-
-            VkWriteDescriptorSet writeDescSet[] = { uboWriteDescSet, samplerWriteDescSet, imageWriteDescSet };
+            VkDescriptorBufferInfo instanceBufferInfo = {};
+            instanceBufferInfo.buffer = m_frameRing.buffer;
+            instanceBufferInfo.offset = 0;
+            instanceBufferInfo.range = sizeof(InstanceData) * MAX_INSTANCES;
+
+            VkWriteDescriptorSet instanceWriteDescSet = {};
+            instanceWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            instanceWriteDescSet.dstSet = m_descriptorSets[i];
+            instanceWriteDescSet.dstBinding = 3;
+            instanceWriteDescSet.dstArrayElement = 0;
+            instanceWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+            instanceWriteDescSet.descriptorCount = 1;
+            instanceWriteDescSet.pBufferInfo = &instanceBufferInfo;
+            instanceWriteDescSet.pNext = nullptr;
+
+            VkWriteDescriptorSet writeDescSet[] = { uboWriteDescSet, samplerWriteDescSet, instanceWriteDescSet };
             vkUpdateDescriptorSets(m_device, sizeof(writeDescSet) / sizeof(VkWriteDescriptorSet), writeDescSet, 0, nullptr);
         }
 
@@ -1074,7 +840,7 @@ void Renderer::createVulkanBuffers()
             inputWriteDescSet.pNext = nullptr;
 
             VkDescriptorBufferInfo descBufferInfo = {};
-            descBufferInfo.buffer = m_colorBuffers[i];
+            descBufferInfo.buffer = m_frameRing.buffer;
             descBufferInfo.offset = 0;
             descBufferInfo.range = sizeof(vec4) * m_colorCount;
 
@@ -1083,7 +849,7 @@ void Renderer::createVulkanBuffers()
             uboWriteDescSet.dstSet = m_compositionDescriptorSets[i];
             uboWriteDescSet.dstBinding = 1;
             uboWriteDescSet.dstArrayElement = 0;
-            uboWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+            uboWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
             uboWriteDescSet.descriptorCount = 1;
             uboWriteDescSet.pBufferInfo = &descBufferInfo;
             uboWriteDescSet.pImageInfo = nullptr;
@@ -1095,14 +861,12 @@ void Renderer::createVulkanBuffers()
         }
     }
 
-    // Command Buffer
-    m_commandBuffers = new VkCommandBuffer[m_swapChainImageCount];
-    VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
-    cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdBufferAllocInfo.commandPool = m_commandPool;
-    cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdBufferAllocInfo.commandBufferCount = m_swapChainImageCount;
-    assert( vkAllocateCommandBuffers(m_device, &cmdBufferAllocInfo, m_commandBuffers) == VK_SUCCESS );
+    // Command Buffers (re-recorded every frame, see recordDrawCmds)
+    m_frameCommands = new FrameCommands[MAX_FRAMES_IN_FLIGHT];
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        m_frameCommands[i].create(m_device, m_graphicsFamily);
+    }
 }
 
 void Renderer::recreateVulkanSwapChain() // TODO: remove when just fullscreen
@@ -1125,18 +889,178 @@ void Renderer::recreateVulkanSwapChain() // TODO: remove when just fullscreen
     // createVulkanSwapChain();
     // createVulkanPipeline();
     // createVulkanBuffers();
-    // createVulkanDrawCmds();
 
     // recreateImguiSwapChain();
 }
 
+void Renderer::step()
+{
+    m_previousTransforms.copy(m_transforms);
+}
+
 void Renderer::update()
 {
-    renderImgui();
-    vkWaitForFences(m_device, 1, &m_framesInFlight[m_currentFrame], VK_TRUE, UINT64_MAX);
+    PROFILE_ZONE("Renderer::update");
+#if EDITOR
+    if (!m_archive.isOpen()) m_shaderWatcher.update();
+#endif
+    if (m_imgui) // otherwise the imgui pass is left empty
+    {
+        PROFILE_ZONE("Imgui");
+        renderImgui();
+    }
+
+    RenderState& state = m_renderStates[m_simState];
+    captureRenderState(state);
+    if (m_pipelined)
+    {
+        publish(state); // returns once the other state has been rendered
+        m_simState = (m_simState + 1) % 2;
+    }
+    else
+    {
+        render(state);
+    }
+}
+
+void Renderer::captureRenderState(RenderState& state)
+{
+    PROFILE_ZONE("Capture render state");
+    state.time = Engine::m_clock.renderTime();
+    state.transforms.interpolate(m_previousTransforms, m_transforms, Engine::m_clock.alpha());
+    memcpy(state.textures, m_instanceTextures, m_transforms.count() * sizeof(TextureHandle));
+    state.renderMode = renderMode;
+    if (m_imgui) captureImgui(state.imgui);
+}
+
+void Renderer::publish(const RenderState& state)
+{
+    PROFILE_ZONE("Wait for render thread");
+    std::unique_lock<std::mutex> lock(m_renderMutex);
+    m_renderDone.wait(lock, [this]() { return m_publishedState == nullptr; });
+    m_publishedState = &state;
+    m_renderReady.notify_one();
+}
+
+void Renderer::waitForRender()
+{
+    std::unique_lock<std::mutex> lock(m_renderMutex);
+    m_renderDone.wait(lock, [this]() { return m_publishedState == nullptr; });
+}
+
+void Renderer::setPipelined(bool pipelined)
+{
+    waitForRender(); // nothing in flight, the next update renders its own state either way
+    m_pipelined = pipelined;
+}
+
+bool Renderer::saveScreenshot(const char* path)
+{
+    assert( m_headless && "Swap chain images aren't created copyable" );
+    waitForRender();
+    if (m_lastImage == UINT32_MAX) return false;
+    vkDeviceWaitIdle(m_device); // the render thread is idle, the queue is free to use from here
+
+    uint32_t width = m_swapChainExtent.width;
+    uint32_t height = m_swapChainExtent.height;
+    VkBuffer buffer;
+    Allocation bufferMemory;
+    createBuffer(m_device, m_allocator, width * height * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, buffer, bufferMemory);
+
+    VkCommandBuffer commandBuffer = beginCommandBuffer(m_device, m_commandPool);
+    // Left in TRANSFER_SRC_OPTIMAL by the imgui pass, only the writes need making visible
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = m_swapChainImages[m_lastImage];
+    barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+    VkBufferImageCopy region = {};
+    region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+    region.imageExtent = { width, height, 1 };
+    vkCmdCopyImageToBuffer(commandBuffer, m_swapChainImages[m_lastImage], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+    endCommandBuffer(m_device, m_commandPool, m_graphicsQueue, commandBuffer);
+
+    // BGRA to RGBA
+    uint8_t* pixels = new uint8_t[width * height * 4];
+    const uint8_t* src = static_cast<const uint8_t*>(bufferMemory.mapped);
+    for (uint32_t i = 0; i < width * height * 4; i += 4)
+    {
+        pixels[i + 0] = src[i + 2];
+        pixels[i + 1] = src[i + 1];
+        pixels[i + 2] = src[i + 0];
+        pixels[i + 3] = 255; // composition alpha isn't meaningful
+    }
+    destroyBuffer(m_device, m_allocator, buffer, bufferMemory);
+
+    bool written = writePng(path, pixels, width, height);
+    delete[] pixels;
+    return written;
+}
+
+void Renderer::renderLoop()
+{
+    Profiler::setThreadName("Render");
+    Engine::m_jobs.attachThread(); // recording and transform jobs skip the locked queue
+    std::unique_lock<std::mutex> lock(m_renderMutex);
+    while (true)
+    {
+        m_renderReady.wait(lock, [this]() { return m_publishedState != nullptr || m_renderStopping; });
+        if (!m_publishedState) break; // stopping, everything published has been rendered
+
+        const RenderState* state = m_publishedState;
+        lock.unlock();
+        render(*state);
+        lock.lock();
+        m_publishedState = nullptr;
+        m_renderDone.notify_one();
+    }
+    Engine::m_jobs.detachThread();
+}
+
+// Render thread when pipelined, owns the queues, the frame resources and anything GPU facing
+void Renderer::render(const RenderState& state)
+{
+    PROFILE_ZONE("Render");
+    uint64_t start = Profiler::now();
+    {
+        PROFILE_ZONE("Uploads");
+        m_assets.update(); // ready textures get a bindless slot, no re-record needed
+        m_uploads.update(); // ahead of this frame's submit so it renders with anything uploaded so far
+    }
+    uint64_t uploaded = Profiler::now();
+    {
+        PROFILE_ZONE("Wait for GPU");
+        vkWaitForFences(m_device, 1, &m_framesInFlight[m_currentFrame], VK_TRUE, UINT64_MAX);
+    }
+    uint64_t waited = Profiler::now();
+    m_gpuProfiler.collect(m_currentFrame);
+    m_textureRegistry.update();
+#if EDITOR
+    char shaderPath[SHADER_PATH_SIZE];
+    while (m_shaderWatcher.popCompiled(shaderPath, sizeof(shaderPath)))
+    {
+        m_pipelines.reload(shaderPath);
+    }
+#endif
+    m_pipelines.swap(); // rebuilt variants go in between frames
+    uint64_t described = Profiler::now();
 
-    uint32_t frameIndex;
-    VkResult result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, m_imageAcquired[m_currentFrame], VK_NULL_HANDLE, &frameIndex);
+    uint32_t frameIndex = m_currentFrame; // headless, an offscreen image per frame in flight
+    PROFILE_ZONE("Acquire, record, submit");
+    VkResult result = VK_SUCCESS;
+    if (!m_headless)
+    {
+        result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX, m_imageAcquired[m_currentFrame], VK_NULL_HANDLE, &frameIndex);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR) // TODO: remove when just fullscreen
     {
         recreateVulkanSwapChain();
@@ -1150,40 +1074,66 @@ void Renderer::update()
     }
     m_imagesInFlight[frameIndex] = m_framesInFlight[m_currentFrame];
 
-    update(frameIndex); // TODO: does this have to wait here? Can this happen before the wait?
-    updateImgui(frameIndex);
+    FrameData frameData = allocateFrameData(frameIndex);
+    update(frameIndex, frameData, state);
+    uint32_t drawCalls = recordDrawCmds(frameIndex, frameData, state);
+    uint64_t recorded = Profiler::now();
 
     VkSubmitInfo submitInfo = {};
     submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-    VkCommandBuffer commandBuffers[] = { m_commandBuffers[frameIndex], m_imguiCommandBuffers[frameIndex] };
+    VkCommandBuffer commandBuffers[] = { m_frameCommands[m_currentFrame].primary };
     VkSemaphore waitSemaphores[] = { m_imageAcquired[m_currentFrame] };
     VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.waitSemaphoreCount = m_headless ? 0 : 1;
     submitInfo.pWaitSemaphores = waitSemaphores;
     submitInfo.pWaitDstStageMask = waitStages;
     submitInfo.commandBufferCount = sizeof(commandBuffers) / sizeof(VkCommandBuffer);
     submitInfo.pCommandBuffers = commandBuffers;
 
     VkSemaphore signalSemaphores[] = { m_renderCompleted[m_currentFrame] };
-    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.signalSemaphoreCount = m_headless ? 0 : 1;
     submitInfo.pSignalSemaphores = signalSemaphores;
 
     vkResetFences(m_device, 1, &m_framesInFlight[m_currentFrame]);
+    m_gpuProfiler.submitted(m_currentFrame);
     assert( vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, m_framesInFlight[m_currentFrame]) == VK_SUCCESS );
+    m_lastImage = frameIndex;
+    if (!m_headless) present(frameIndex);
+    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 
+    if (m_benchmark)
+    {
+        uint64_t submitted = Profiler::now();
+        RenderStats stats;
+        stats.uploads = (uploaded - start) / 1e6;
+        stats.waitForGpu = (waited - uploaded) / 1e6;
+        stats.descriptors = (described - waited) / 1e6;
+        stats.record = (recorded - described) / 1e6; // includes acquiring the image
+        stats.submit = (submitted - recorded) / 1e6;
+        stats.drawCalls = drawCalls;
+        m_benchmark->rendered(stats);
+    }
+}
+
+void Renderer::present(uint32_t imageIndex)
+{
     VkPresentInfoKHR presentInfo = {};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &m_renderCompleted[m_currentFrame];
 
     VkSwapchainKHR swapChains[] = { m_swapChain };
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapChains;
-    presentInfo.pImageIndices = &frameIndex;
+    presentInfo.pImageIndices = &imageIndex;
     presentInfo.pResults = nullptr;
 
-    result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    VkResult result;
+    {
+        PROFILE_ZONE("Present");
+        result = vkQueuePresentKHR(m_presentQueue, &presentInfo);
+    }
     if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebufferResized) // TODO: remove when just fullscreen
     {
         framebufferResized = false;
@@ -1191,16 +1141,12 @@ void Renderer::update()
         result = VK_SUCCESS;
     }
     assert( result == VK_SUCCESS );
-
-    m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-void Renderer::update(uint32_t currentImage)
+void Renderer::update(uint32_t frameIndex, const FrameData& frameData, const RenderState& state)
 {
-    static auto startTime = std::chrono::high_resolution_clock::now();
-
-    auto currentTime = std::chrono::high_resolution_clock::now();
-    float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
+    PROFILE_ZONE("Frame data");
+    float time = state.time;
 
     UniformBufferObject ubo;
     mat4 proj = mat4::projection(3.141519 * 0.25f, 
@@ -1213,10 +1159,7 @@ void Renderer::update(uint32_t currentImage)
     ubo.modelViewProjection = proj * view * model;
     ubo.time = time;
 
-    void* data;
-    vkMapMemory(m_device, m_uniformBuffersMemory[currentImage], 0, sizeof(UniformBufferObject), 0, &data);
-    memcpy(data, &ubo, sizeof(UniformBufferObject));
-    vkUnmapMemory(m_device, m_uniformBuffersMemory[currentImage]);
+    memcpy(frameData.uniform.data, &ubo, sizeof(UniformBufferObject));
 
     int test = 100 * time;
     vec4 colors[] = {
@@ -1225,51 +1168,61 @@ void Renderer::update(uint32_t currentImage)
         vec4(134.0f/255.0f,168.0f/255.0f,231.0f/255.0f,1.0f),
         vec4(145.0f/255.0f,234.0f/255.0f,228.0f/255.0f,1.0f)
     };
-    vkMapMemory(m_device, m_colorBuffersMemory[currentImage], 0, sizeof(colors), 0, &data);
-    memcpy(data, colors, sizeof(colors));
-    vkUnmapMemory(m_device, m_colorBuffersMemory[currentImage]);
+    memcpy(frameData.colors.data, colors, sizeof(colors));
+
+    uint32_t instanceCount = state.transforms.count();
+    assert( instanceCount <= MAX_INSTANCES );
+    InstanceData* instances = static_cast<InstanceData*>(frameData.instances.data);
+    Engine::m_jobs.parallelFor(instanceCount, TRANSFORM_GRAIN, [&state, instances](uint32_t begin, uint32_t end)
+    {
+        state.transforms.computeWorld(&instances[0].model, sizeof(InstanceData), begin, end);
+    });
+    for (uint32_t i = 0; i < instanceCount; ++i)
+    {
+        instances[i].tint = vec4(1.0f);
+        instances[i].textureIndex = m_assets.slot(state.textures[i]);
+    }
+
+    m_frameRing.flush(m_allocator);
+}
+
+Renderer::FrameData Renderer::allocateFrameData(uint32_t frame)
+{
+    m_frameRing.begin(frame);
+    FrameData frameData;
+    frameData.uniform = m_frameRing.allocate(sizeof(UniformBufferObject));
+    frameData.colors = m_frameRing.allocate(sizeof(vec4) * m_colorCount);
+    frameData.instances = m_frameRing.allocate(sizeof(InstanceData) * MAX_INSTANCES);
+    return frameData;
 }
 
 void Renderer::cleanupVulkanSwapChain()
 {
     // Buffers
     // TODO: doesn't need to be redone on recreateSwapChain
-    m_attachments.destroy(m_device);
+    m_attachments.destroy(m_device, m_allocator);
 
     vkDestroySampler(m_device, m_texSampler, nullptr);
-    for (int i = 0; i < m_instances; ++i)
-    {
-        vkDestroyImageView(m_device, m_texImageView[i], nullptr);
-        vkDestroyImage(m_device, m_texImage[i], nullptr);
-        vkFreeMemory(m_device, m_texImageMemory[i], nullptr);
-    }
-    vkDestroyBuffer(m_device, m_vertexIndexBuffer, nullptr);
-    vkFreeMemory(m_device, m_vertexIndexBufferMemory, nullptr);
+    destroyBuffer(m_device, m_allocator, m_vertexIndexBuffer, m_vertexIndexBufferMemory);
 
-    for (int i = 0; i < m_swapChainImageCount; ++i)
-    {
-        vkDestroyBuffer(m_device, m_uniformBuffers[i], nullptr);
-        vkFreeMemory(m_device, m_uniformBuffersMemory[i], nullptr);
-        vkDestroyBuffer(m_device, m_colorBuffers[i], nullptr);
-        vkFreeMemory(m_device, m_colorBuffersMemory[i], nullptr);
-    }
-    delete[] m_uniformBuffers;
-    delete[] m_uniformBuffersMemory;
-    delete[] m_colorBuffers;
-    delete[] m_colorBuffersMemory;
+    m_frameRing.destroy(m_device, m_allocator);
     vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
     delete[] m_descriptorSets;
     vkDestroyDescriptorPool(m_device, m_compositionDescriptorPool, nullptr);
     delete[] m_compositionDescriptorSets;
 
-    delete[] m_commandBuffers;
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+    {
+        m_frameCommands[i].destroy(m_device);
+    }
+    delete[] m_frameCommands;
     for (int i = 0; i < m_swapChainImageCount; ++i)
     {
         vkDestroyFramebuffer(m_device, m_sceneFramebuffers[i], nullptr);
     }
     delete[] m_sceneFramebuffers;
     // Pipeline
-    m_pipeline.destroy(m_device);
+    m_pipelines.clear(); // the extent is baked into every variant
     vkDestroyDescriptorSetLayout(m_device, m_descriptorLayout, nullptr);
     vkDestroyDescriptorSetLayout(m_device, m_compositionDescriptorLayout, nullptr);
     vkDestroyPipelineLayout(m_device, m_pipelineLayout, nullptr);
@@ -1279,16 +1232,31 @@ void Renderer::cleanupVulkanSwapChain()
     for (int i = 0; i < m_swapChainImageCount; ++i)
     {
         vkDestroyImageView(m_device, m_swapChainImageViews[i], nullptr);
+        if (m_headless) destroyImage(m_device, m_allocator, m_swapChainImages[i], m_offscreenMemory[i]);
     }
     delete[] m_swapChainImageViews;
     delete[] m_swapChainImages;
-    vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
+    delete[] m_offscreenMemory;
+    if (!m_headless) vkDestroySwapchainKHR(m_device, m_swapChain, nullptr);
 
     cleanupImguiContext();
 }
 
 void Renderer::cleanup()
 {
+    // Render thread
+    waitForRender();
+    {
+        std::lock_guard<std::mutex> lock(m_renderMutex);
+        m_renderStopping = true;
+    }
+    m_renderReady.notify_one();
+    m_renderThread.join();
+
+#if EDITOR
+    if (!m_archive.isOpen()) m_shaderWatcher.cleanup();
+#endif
+
     // Vulcan
     // Synchronization
     vkDeviceWaitIdle(m_device);
@@ -1306,246 +1274,272 @@ void Renderer::cleanup()
     cleanupVulkanSwapChain();
     m_renderPass.destroy(m_device);
     // Device
+    m_assets.cleanup();
+    m_derivedData.cleanup();
+    m_textureRegistry.cleanup();
+    m_gpuProfiler.cleanup();
+    m_pipelines.cleanup();
+    m_pipelineCache.cleanup(); // every pipeline, ImGui's too, has been created by now
+    m_archive.close();
+    m_uploads.cleanup();
+    m_allocator.cleanup();
     vkDestroyDevice(m_device, nullptr);
     // Instance
-    vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+    if (!m_headless) vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
 #if DEBUG && DEBUG_RENDERER
     DestroyDebugUtilsMessengerEXT(m_instance, m_debugMessenger, nullptr);
 #endif
     vkDestroyInstance(m_instance, nullptr);
+
+    // TODO: remove
+    delete[] m_instanceTextures;
+    for (int i = 0; i < 2; ++i)
+    {
+        delete[] m_renderStates[i].textures;
+    }
 }
 
-void Renderer::createVulkanDrawCmds()
+uint32_t Renderer::recordDrawCmds(uint32_t frameIndex, const FrameData& frameData, const RenderState& state)
 {
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0;
-    beginInfo.pInheritanceInfo = nullptr;
+    PROFILE_ZONE("Record");
+    // The frame's fence has been waited on, so all of its pools can be recycled whole
+    FrameCommands& commands = m_frameCommands[m_currentFrame];
+    commands.reset(m_device);
+
+    // Partition the frame into secondaries: imgui + composition, then the instanced draws split
+    // into contiguous instance ranges (firstInstance keeps gl_InstanceIndex pointing at the right data)
+    RecordTask tasks[MAX_RECORD_TASKS];
+    uint32_t taskCount = 0;
+    tasks[taskCount++] = { RECORD_IMGUI, VK_NULL_HANDLE, 0, 0 }; // recording thread, the imgui backend's buffers aren't thread safe
+    tasks[taskCount++] = { RECORD_COMPOSITION, m_pipelines.get(m_pipeline.composition), 0, 0 };
+    uint32_t drawTaskBegin = taskCount;
+
+    VkPipeline passes[2];
+    uint32_t passCount = 0;
+#if EDITOR
+    if (state.renderMode == 0 || state.renderMode == 2) passes[passCount++] = m_pipelines.get(m_pipeline.wireframe);
+#endif
+    if (state.renderMode < 2) passes[passCount++] = m_pipelines.get(m_pipeline.scene);
 
-    VsPushConstants vsPushConstants[m_instances];
-    FsPushConstants fsPushConstants[m_instances];
-    model[0] = mat4::translate(-0.5f, -0.5f, -0.5f);
-    model[1] = mat4::Identity;
-    model[2] = mat4::translate(0.5f, 0.5f, -0.5f);
-    for (int i = 0; i < m_instances; ++i)
+    uint32_t instanceCount = state.transforms.count();
+    if (instanceCount > 0 && passCount > 0)
     {
-        vsPushConstants[i].instanceID = i;
-        vsPushConstants[i].model = model[i];
-        fsPushConstants[i].instanceID = i;
+        uint32_t maxChunks = (MAX_RECORD_TASKS - drawTaskBegin) / passCount;
+        uint32_t workers = Engine::m_jobs.workerCount();
+        uint32_t chunkCount = (instanceCount + MIN_INSTANCES_PER_TASK - 1) / MIN_INSTANCES_PER_TASK;
+        if (chunkCount > workers) chunkCount = workers;
+        if (chunkCount > maxChunks) chunkCount = maxChunks;
+        uint32_t chunkSize = (instanceCount + chunkCount - 1) / chunkCount;
+
+        for (uint32_t pass = 0; pass < passCount; ++pass) // wireframe underneath the scene
+        {
+            for (uint32_t first = 0; first < instanceCount; first += chunkSize)
+            {
+                uint32_t count = instanceCount - first < chunkSize ? instanceCount - first : chunkSize;
+                tasks[taskCount++] = { RECORD_DRAWS, passes[pass], first, count };
+            }
+        }
     }
 
-    for (int i = 0; i < m_swapChainImageCount; ++i)
+    JobCounter recorded;
+    for (uint32_t i = 1; i < taskCount; ++i)
     {
-        assert( vkBeginCommandBuffer(m_commandBuffers[i], &beginInfo) == VK_SUCCESS );
+        Engine::m_jobs.submit([this, &tasks, &commands, &frameData, &state, frameIndex, i]()
+        {
+            recordSecondary(tasks[i], commands.secondaries[i], frameIndex, frameData, state);
+        }, &recorded);
+    }
+    recordSecondary(tasks[0], commands.secondaries[0], frameIndex, frameData, state);
+    Engine::m_jobs.wait(recorded); // picks up the remaining partitions rather than idling
+
+    // Primary
+    VkCommandBuffer commandBuffer = commands.primary;
 
-        VkRenderPassBeginInfo renderPassInfo = {};
-        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        renderPassInfo.renderPass = m_renderPass.scene;
-        renderPassInfo.framebuffer = m_sceneFramebuffers[i];
-        renderPassInfo.renderArea.offset = {0, 0};
-        renderPassInfo.renderArea.extent = m_swapChainExtent;
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = nullptr;
+    assert( vkBeginCommandBuffer(commandBuffer, &beginInfo) == VK_SUCCESS );
+    m_gpuProfiler.begin(commandBuffer, m_currentFrame);
+    m_gpuProfiler.write(commandBuffer, m_currentFrame, TIMESTAMP_SCENE, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+    VkRenderPassBeginInfo renderPassInfo = {};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = m_renderPass.scene;
+    renderPassInfo.framebuffer = m_sceneFramebuffers[frameIndex];
+    renderPassInfo.renderArea.offset = {0, 0};
+    renderPassInfo.renderArea.extent = m_swapChainExtent;
+
+    VkClearValue clearColor = {};
+    clearColor.color = {1.0f, 1.0f, 0.0f, 0.0f};
+    VkClearValue clearDepth = {};
+    clearDepth.depthStencil = {1.0f, 0};
+    VkClearValue clearColors[] = { clearColor, clearColor, clearDepth }; // Needs to be same order as attachments
+
+    renderPassInfo.clearValueCount = sizeof(clearColors) / sizeof(VkClearValue);
+    renderPassInfo.pClearValues = clearColors;
+
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    if (taskCount > drawTaskBegin)
+    {
+        vkCmdExecuteCommands(commandBuffer, taskCount - drawTaskBegin, &commands.secondaries[drawTaskBegin]);
+    }
 
-        VkClearValue clearColor = {};
-        clearColor.color = {1.0f, 1.0f, 0.0f, 0.0f};
-        VkClearValue clearDepth = {};
-        clearDepth.depthStencil = {1.0f, 0};
-        VkClearValue clearColors[] = { clearColor, clearColor, clearDepth }; // Needs to be same order as attachments
+    // Composite
+    vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(commandBuffer, 1, &commands.secondaries[1]);
+    vkCmdEndRenderPass(commandBuffer);
+    m_gpuProfiler.write(commandBuffer, m_currentFrame, TIMESTAMP_IMGUI, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+    // Imgui
+    VkClearValue imguiClearColor = {};
+    VkRenderPassBeginInfo imguiRenderPassInfo = renderPassInfo;
+    imguiRenderPassInfo.renderPass = m_renderPass.imgui;
+    imguiRenderPassInfo.framebuffer = m_imguiFramebuffers[frameIndex];
+    imguiRenderPassInfo.clearValueCount = 1;
+    imguiRenderPassInfo.pClearValues = &imguiClearColor;
+    vkCmdBeginRenderPass(commandBuffer, &imguiRenderPassInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+    vkCmdExecuteCommands(commandBuffer, 1, &commands.secondaries[0]);
+    vkCmdEndRenderPass(commandBuffer);
+    m_gpuProfiler.write(commandBuffer, m_currentFrame, TIMESTAMP_END, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+
+    assert( vkEndCommandBuffer(commandBuffer) == VK_SUCCESS );
+    return (taskCount - drawTaskBegin) + 1 + (m_imgui ? imguiDrawCalls(state.imgui) : 0); // + composition
+}
 
-        renderPassInfo.clearValueCount = sizeof(clearColors) / sizeof(VkClearValue);
-        renderPassInfo.pClearValues = clearColors;
+void Renderer::recordSecondary(const RecordTask& task, VkCommandBuffer commandBuffer, uint32_t frameIndex, const FrameData& frameData, const RenderState& state)
+{
+    PROFILE_ZONE("Record secondary");
+    VkCommandBufferInheritanceInfo inheritanceInfo = {};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritanceInfo.renderPass = task.kind == RECORD_IMGUI ? m_renderPass.imgui : m_renderPass.scene;
+    inheritanceInfo.subpass = task.kind == RECORD_COMPOSITION ? BASE_SUBPASS + 1 : BASE_SUBPASS;
+    inheritanceInfo.framebuffer = task.kind == RECORD_IMGUI ? m_imguiFramebuffers[frameIndex] : m_sceneFramebuffers[frameIndex];
 
-        vkCmdBeginRenderPass(m_commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+    assert( vkBeginCommandBuffer(commandBuffer, &beginInfo) == VK_SUCCESS );
 
+    // Secondaries inherit no state, everything is bound again
+    switch (task.kind)
+    {
+    case RECORD_DRAWS:
+    {
+        uint32_t indexCount = sizeof(indices) / sizeof(indices[0]);
         VkBuffer vertexBuffers[] = { m_vertexIndexBuffer };
         VkDeviceSize offsets[] = { 0 };
-        vkCmdBindVertexBuffers(m_commandBuffers[i], 0, 1, vertexBuffers, offsets);
-        vkCmdBindIndexBuffer(m_commandBuffers[i], m_vertexIndexBuffer, sizeof(vertices), VK_INDEX_TYPE_UINT16);
-        vkCmdBindDescriptorSets(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[i], 0, nullptr);
-
-#if EDITOR
-        // Wireframe
-        if (renderMode == 0 || renderMode == 2 )
-        {
-            vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.wireframe);
-            for (int j = 0; j < m_instances; ++j)
-            {
-                vkCmdPushConstants(m_commandBuffers[i], m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VsPushConstants), &vsPushConstants[j]);
-                vkCmdPushConstants(m_commandBuffers[i], m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(VsPushConstants), sizeof(FsPushConstants), &fsPushConstants[j]);
-                vkCmdDrawIndexed(m_commandBuffers[i], sizeof(indices) / sizeof(indices[0]), 1, 0, 0, 0);
-            }
-        }
-#endif
-
-        // General
-        if (renderMode < 2)
-        {
-            vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.scene);
-            for (int j = 0; j < m_instances; ++j)
-            {
-                vkCmdPushConstants(m_commandBuffers[i], m_pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VsPushConstants), &vsPushConstants[j]);
-                vkCmdPushConstants(m_commandBuffers[i], m_pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(VsPushConstants), sizeof(FsPushConstants), &fsPushConstants[j]);
-                vkCmdDrawIndexed(m_commandBuffers[i], sizeof(indices) / sizeof(indices[0]), 1, 0, 0, 0);
-            }        
-        }
-
-        // Composite
-        vkCmdNextSubpass(m_commandBuffers[i], VK_SUBPASS_CONTENTS_INLINE);
-
-        vkCmdBindPipeline(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.composition);
-        vkCmdBindDescriptorSets(m_commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_compositionPipelineLayout, 0, 1, &m_compositionDescriptorSets[i], 0, nullptr);
-        vkCmdDraw(m_commandBuffers[i], 3, 1, 0, 0);
-
-        vkCmdEndRenderPass(m_commandBuffers[i]);
-        assert( vkEndCommandBuffer(m_commandBuffers[i]) == VK_SUCCESS );
+        vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
+        vkCmdBindIndexBuffer(commandBuffer, m_vertexIndexBuffer, sizeof(vertices), VK_INDEX_TYPE_UINT16);
+        uint32_t dynamicOffsets[] = { frameData.uniform.offset, frameData.instances.offset }; // binding order
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1, &m_descriptorSets[frameIndex],
+            sizeof(dynamicOffsets) / sizeof(uint32_t), dynamicOffsets);
+        VkDescriptorSet textureSet = m_textureRegistry.set();
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, TEXTURE_SET, 1, &textureSet, 0, nullptr);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, task.pipeline);
+        vkCmdDrawIndexed(commandBuffer, indexCount, task.instanceCount, 0, 0, task.firstInstance);
+        break;
     }
+    case RECORD_COMPOSITION:
+        // The primary can't write timestamps inside a render pass recorded as secondaries, this
+        // one lands once the scene subpass has finished
+        m_gpuProfiler.write(commandBuffer, m_currentFrame, TIMESTAMP_COMPOSITION, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, task.pipeline);
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_compositionPipelineLayout, 0, 1, &m_compositionDescriptorSets[frameIndex], 1, &frameData.colors.offset);
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+        break;
+    case RECORD_IMGUI:
+        if (m_imgui) recordImgui(commandBuffer, state.imgui);
+        break;
+    }
+
+    assert( vkEndCommandBuffer(commandBuffer) == VK_SUCCESS );
 }
 
 // TODO: remove
 
 void Renderer::cycleMode()
 {
-    renderMode = ++renderMode % 3;
-    vkQueueWaitIdle(m_graphicsQueue);
-    for (int i = 0; i < m_swapChainImageCount; ++i)
-    {
-        vkResetCommandBuffer(m_commandBuffers[i], 0);
-    }
-    createVulkanDrawCmds();
+    renderMode = ++renderMode % 3; // picked up by the next captured state
 }
 
-void Renderer::loadImageInstance(char filePath[64], float position[3])
+bool Renderer::startBenchmark(Benchmark& benchmark, const BenchmarkScene& scene)
 {
+    assert( !m_benchmark && "One benchmark per run, the generated scene replaces the demo one" );
+    // The demo scene's handles are only freed by the next update, after generateScene() has loaded
+    uint32_t freeTextures = m_assets.freeCount();
+    if (scene.textures > freeTextures)
     {
-        const int BufferMemoryProperty = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        void* data;
-        
-        int texWidth, texHeight, texChannels;
-        stbi_uc* texPixels = stbi_load(filePath, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-        VkDeviceSize texSize = texWidth * texHeight * 4;
-        assert( texPixels );
-        createBuffer(m_device, m_physicalDevice,
-                    texSize, 
-                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-                    BufferMemoryProperty,
-                    stagingBuffer, stagingBufferMemory);
-        vkMapMemory(m_device, stagingBufferMemory, 0, texSize, 0, &data);
-        memcpy(data, texPixels, texSize);
-        vkUnmapMemory(m_device, stagingBufferMemory);
-        stbi_image_free(texPixels);
-
-        createImage(m_device, m_physicalDevice, texWidth, texHeight, 
-            VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT,
-            m_texImage[m_instances], m_texImageMemory[m_instances]);
-
-    #if TRANSFER_FAMILY
-        copyImage(m_device, m_commandPool, m_transferQueue, stagingBuffer, m_texImage[m_instances], texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM);
-    #else
-        copyImage(m_device, m_commandPool, m_graphicsQueue, stagingBuffer, m_texImage[m_instances], texWidth, texHeight, VK_FORMAT_R8G8B8A8_UNORM);
-    #endif
-        vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-        vkFreeMemory(m_device, stagingBufferMemory, nullptr);
-
-        createImageView(m_device, m_texImage[m_instances], VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, m_texImageView[m_instances]);
+        std::cerr << "--textures can be at most " << freeTextures << " on this device" << std::endl;
+        return false;
     }
+    waitForRender(); // the scene belongs to the simulation, but nothing may still be reading it
+    generateScene(scene.sprites, scene.textures);
+    renderMode = scene.wireframe ? 0 : 1;
+    setPipelined(scene.pipelined);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+    benchmark.init(scene, properties.deviceName);
+    m_benchmark = &benchmark;
+    return true;
+}
 
-    model[m_instances] = mat4::translate(position[0], position[1], position[2]);
-
-    m_instances++;
-    vkQueueWaitIdle(m_graphicsQueue);
-
-    VkDescriptorImageInfo compositionColorImageInfo = {};
-    compositionColorImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    compositionColorImageInfo.imageView = m_attachments.colorView;
-    compositionColorImageInfo.sampler = nullptr;
-
-    VkDescriptorImageInfo samplerImageInfo = {};
-    samplerImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    samplerImageInfo.imageView = VK_NULL_HANDLE;
-    samplerImageInfo.sampler = m_texSampler;
-
-    VkDescriptorImageInfo imagesImageInfo[64];
-    for (int i = 0; i < m_instances + 1; ++i)
-    {
-        imagesImageInfo[i] = {};
-        imagesImageInfo[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imagesImageInfo[i].imageView = m_texImageView[i];
-        imagesImageInfo[i].sampler = nullptr;
-    }
-    for (int i = m_instances; i < 64; ++i)
+void Renderer::generateScene(uint32_t sprites, uint32_t textures)
+{
+    assert( sprites <= MAX_INSTANCES );
+    for (uint32_t i = 0; i < m_instances; ++i)
     {
-        imagesImageInfo[i] = {};
-        imagesImageInfo[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        imagesImageInfo[i].imageView = m_texImageView[0];
-        imagesImageInfo[i].sampler = nullptr;
+        m_assets.unloadTexture(m_instanceTextures[i]);
     }
 
-    for (int i = 0; i < m_swapChainImageCount; ++i)
+    // Fixed seed LCG, the same scene on every machine
+    uint32_t seed = BENCHMARK_SEED;
+    auto random = [&seed]() -> float
     {
-        {
-            VkDescriptorBufferInfo descBufferInfo = {};
-            descBufferInfo.buffer = m_uniformBuffers[i];
-            descBufferInfo.offset = 0;
-            descBufferInfo.range = sizeof(UniformBufferObject);
-
-            VkWriteDescriptorSet uboWriteDescSet = {};
-            uboWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            uboWriteDescSet.dstSet = m_descriptorSets[i];
-            uboWriteDescSet.dstBinding = 0;
-            uboWriteDescSet.dstArrayElement = 0;
-            uboWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            uboWriteDescSet.descriptorCount = 1;
-            uboWriteDescSet.pBufferInfo = &descBufferInfo;
-            uboWriteDescSet.pImageInfo = nullptr;
-            uboWriteDescSet.pTexelBufferView = nullptr;
-            uboWriteDescSet.pNext = nullptr;
-
-            VkWriteDescriptorSet samplerWriteDescSet = {};
-            samplerWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            samplerWriteDescSet.dstSet = m_descriptorSets[i];
-            samplerWriteDescSet.dstBinding = 1;
-            samplerWriteDescSet.dstArrayElement = 0;
-            samplerWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
-            samplerWriteDescSet.descriptorCount = 1;
-            samplerWriteDescSet.pImageInfo = &samplerImageInfo;
-            samplerWriteDescSet.pNext = nullptr;
-
-            VkWriteDescriptorSet imageWriteDescSet = {};
-            imageWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            imageWriteDescSet.dstSet = m_descriptorSets[i];
-            imageWriteDescSet.dstBinding = 2;
-            imageWriteDescSet.dstArrayElement = 0;
-            imageWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
-            imageWriteDescSet.descriptorCount = 64;
-            imageWriteDescSet.pImageInfo = imagesImageInfo;
-            imageWriteDescSet.pNext = nullptr;
-
-            VkWriteDescriptorSet writeDescSet[] = { uboWriteDescSet, samplerWriteDescSet, imageWriteDescSet };
-            vkUpdateDescriptorSets(m_device, sizeof(writeDescSet) / sizeof(VkWriteDescriptorSet), writeDescSet, 0, nullptr);
-        }
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / float(1 << 24);
+    };
 
+    // Checkerboards, each with a colour of its own
+    TextureHandle* handles = new TextureHandle[textures > 0 ? textures : 1];
+    handles[0] = PLACEHOLDER_TEXTURE;
+    uint32_t* pixels = new uint32_t[BENCHMARK_TEXTURE_SIZE * BENCHMARK_TEXTURE_SIZE];
+    for (uint32_t i = 0; i < textures; ++i)
+    {
+        uint32_t color = 0xFF000000 | uint32_t(random() * 0xFFFFFF);
+        for (uint32_t y = 0; y < BENCHMARK_TEXTURE_SIZE; ++y)
         {
-            // TODO: add color gradient
-
-            VkWriteDescriptorSet inputWriteDescSet = {};
-            inputWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            inputWriteDescSet.dstSet = m_compositionDescriptorSets[i];
-            inputWriteDescSet.dstBinding = 0;
-            inputWriteDescSet.dstArrayElement = 0;
-            inputWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
-            inputWriteDescSet.descriptorCount = 1;
-            inputWriteDescSet.pImageInfo = &compositionColorImageInfo;
-            inputWriteDescSet.pNext = nullptr;
-            
-            VkWriteDescriptorSet writeDescSet[] = { inputWriteDescSet };
-            vkUpdateDescriptorSets(m_device, sizeof(writeDescSet) / sizeof(VkWriteDescriptorSet), writeDescSet, 0, nullptr);
+            for (uint32_t x = 0; x < BENCHMARK_TEXTURE_SIZE; ++x)
+            {
+                pixels[y * BENCHMARK_TEXTURE_SIZE + x] = ((x / 8 + y / 8) & 1) ? color : 0xFFFFFFFF;
+            }
         }
+        handles[i] = m_assets.loadTexture(pixels, BENCHMARK_TEXTURE_SIZE, BENCHMARK_TEXTURE_SIZE);
     }
+    delete[] pixels;
 
-    for (int i = 0; i < m_swapChainImageCount; ++i)
+    m_transforms.clear();
+    m_transforms.reserve(sprites);
+    for (uint32_t i = 0; i < sprites; ++i)
     {
-        vkResetCommandBuffer(m_commandBuffers[i], 0);
+        vec3 position(random() * 2.0f - 1.0f, random() * 2.0f - 1.0f, -random());
+        vec3 rotation(random() * 6.2831853f, 0.0f, 0.0f);
+        float scale = 0.05f + random() * 0.2f;
+        m_transforms.add(position, rotation, vec3(scale));
+        m_instanceTextures[i] = handles[textures > 0 ? i % textures : 0];
     }
-    createVulkanDrawCmds();
+    m_previousTransforms.copy(m_transforms);
+    m_instances = sprites;
+    delete[] handles;
+}
+
+void Renderer::loadImageInstance(char filePath[64], float position[3])
+{
+    // Decoded on a worker, gets a bindless slot once the upload completes (see update)
+    m_instanceTextures[m_instances] = m_assets.loadTexture(filePath);
+    m_transforms.add(vec3(position[0], position[1], position[2]), vec3(0.0f), vec3(1.0f));
+    m_instances++;
 }
\ No newline at end of file
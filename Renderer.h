@@ -2,8 +2,27 @@
 #define RENDERER_H
 
 #include <vulkan/vulkan.h> // TODO: forward declare
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "RenderStructs.h"
+#include "Rendering/MemoryAllocator.h"
+#include "Rendering/RingBuffer.h"
+#include "Rendering/UploadQueue.h"
+#include "Rendering/TextureRegistry.h"
+#include "Rendering/AssetLoader.h"
+#include "Rendering/GpuProfiler.h"
+#include "Rendering/PipelineCache.h"
+#include "Rendering/PipelineRegistry.h"
+#include "Rendering/ShaderWatcher.h"
+#include "Utilities/DerivedDataCache.h"
+#include "Utilities/Archive.h"
 #include "Math/mat4.h"
+#include "Math/TransformBatch.h"
+
+struct ImDrawData;
+class Benchmark;
+struct BenchmarkScene;
 
 class Renderer {
 public:
@@ -12,6 +31,14 @@ public:
     int renderMode;
     void cycleMode();
 
+    // Pipelined: the render thread builds frame N while the simulation runs frame N + 1
+    void setPipelined(bool pipelined);
+    // The last rendered frame as a PNG, headless only (offscreen images can be copied from)
+    bool saveScreenshot(const char* path);
+    // Replaces the scene with a generated one and reports every rendered frame to benchmark.
+    // False if the scene doesn't fit, more textures than there are handles left
+    bool startBenchmark(Benchmark& benchmark, const BenchmarkScene& scene);
+
 private:
     // Instance
     VkInstance m_instance;
@@ -21,11 +48,12 @@ private:
     VkDevice m_device;
     VkSurfaceKHR m_surface;
     uint32_t m_graphicsFamily;
+    uint32_t m_transferFamily; // m_graphicsFamily unless TRANSFER_FAMILY finds a dedicated one
+    MemoryAllocator m_allocator;
+    UploadQueue m_uploads;
     VkQueue m_graphicsQueue; // TODO: only needed on init
     VkQueue m_presentQueue; // TODO: only needed on init
-#if TRANSFER_FAMILY
-    VkQueue m_transferQueue; // TODO: only needed on init
-#endif
+    VkQueue m_transferQueue;
     // Swap Chain
     VkSwapchainKHR m_swapChain;
     VkExtent2D m_swapChainExtent; // TODO: only needed on init
@@ -33,6 +61,12 @@ private:
     uint32_t m_swapChainImageCount;
     VkImage* m_swapChainImages;
     VkImageView* m_swapChainImageViews;
+    // Headless: no surface or swap chain, the "swap chain images" are offscreen ones, one per frame in flight
+    bool m_headless;
+    Allocation* m_offscreenMemory;
+    uint32_t m_lastImage; // last submitted, UINT32_MAX before the first frame
+    bool m_imgui; // always with a window, optional headless
+    bool m_blockCompression; // textures baked to BC1/BC3, RGBA8 otherwise
     // Pipeline
     VkDescriptorSetLayout m_descriptorLayout;
     VkDescriptorSetLayout m_compositionDescriptorLayout;
@@ -43,30 +77,31 @@ private:
     Pipeline m_pipeline;
     // Buffers
     VkFramebuffer* m_sceneFramebuffers;
-    VkCommandPool m_commandPool;
-#if TRANSFER_FAMILY
-    VkCommandPool m_transferCommandPool;
-#endif
-    VkCommandBuffer* m_commandBuffers; // TODO: break into secondary for background + composition? and imgui
+    VkCommandPool m_commandPool; // one off submissions
+    FrameCommands* m_frameCommands; // one per frame in flight
 
     Attachment m_attachments;
 
     VkBuffer m_vertexIndexBuffer;
-    VkDeviceMemory m_vertexIndexBufferMemory;
+    Allocation m_vertexIndexBufferMemory;
     
-    VkBuffer* m_uniformBuffers;
-    VkDeviceMemory* m_uniformBuffersMemory;
-    VkBuffer* m_colorBuffers;
-    VkDeviceMemory* m_colorBuffersMemory;
+    RingBuffer m_frameRing;
 
     VkDescriptorPool m_descriptorPool;
     VkDescriptorSet* m_descriptorSets;
     VkDescriptorPool m_compositionDescriptorPool; // TODO: 1 descriptor pool
     VkDescriptorSet* m_compositionDescriptorSets; // TODO: 1 descriptor set with different array indicies
     
-    VkImage* m_texImage;
-    VkDeviceMemory* m_texImageMemory;
-    VkImageView* m_texImageView;
+    TextureRegistry m_textureRegistry;
+    DerivedDataCache m_derivedData;
+    Archive m_archive; // closed without --archive
+    AssetLoader m_assets;
+    GpuProfiler m_gpuProfiler;
+    PipelineCache m_pipelineCache;
+    PipelineRegistry m_pipelines;
+#if EDITOR
+    ShaderWatcher m_shaderWatcher;
+#endif
     VkSampler m_texSampler;
     // Synchronization
     VkSemaphore* m_imageAcquired;
@@ -78,35 +113,93 @@ private:
     // Imgui
     VkDescriptorPool m_imguiDescriptorPool;
     VkFramebuffer* m_imguiFramebuffers;
-    VkCommandPool* m_imguiCommandPools;
-    VkCommandBuffer* m_imguiCommandBuffers;
 
     // TODO: remove
     uint32_t m_instances = 3;
-    mat4 model[64];
+    TransformBatch m_transforms;
+    TransformBatch m_previousTransforms; // as of the step before, rendering blends towards m_transforms
+    TextureHandle* m_instanceTextures; // MAX_INSTANCES
     void loadImageInstance(char filePath[64], float position[3]);
+    void generateScene(uint32_t sprites, uint32_t textures);
+    Benchmark* m_benchmark; // null unless benchmarking
 
     uint8_t m_colorCount = 3;
     //
 
+    struct FrameData
+    {
+        RingAllocation uniform;
+        RingAllocation colors;
+        RingAllocation instances;
+    };
+    FrameData allocateFrameData(uint32_t frame);
+
+    // Everything a frame is built from, written by the simulation and only read while rendering
+    struct RenderState
+    {
+        TransformBatch transforms;
+        TextureHandle* textures; // MAX_INSTANCES
+        int renderMode;
+        float time;
+        ImDrawData* imgui; // deep copy, ImGui reuses its draw lists next frame
+    };
+    RenderState m_renderStates[2]; // double buffered between the simulation and the render thread
+    uint32_t m_simState; // the one the simulation writes next
+    bool m_pipelined;
+
+    std::thread m_renderThread;
+    std::mutex m_renderMutex;
+    std::condition_variable m_renderReady;
+    std::condition_variable m_renderDone;
+    const RenderState* m_publishedState; // handed to the render thread, null once rendered
+    bool m_renderStopping;
+
+    void captureRenderState(RenderState& state);
+    void publish(const RenderState& state);
+    void waitForRender();
+    void renderLoop();
+
     void init();
-    void update();
-    void update(uint32_t frameIndex);
+    void step(); // before each fixed simulation step
+    void update(); // simulation side, once per frame
+    void render(const RenderState& state);
+    void update(uint32_t frameIndex, const FrameData& frameData, const RenderState& state);
     void cleanup();
 
     void createVulkanInstance();
     void createVulkanDevice();
     void createVulkanSwapChain();
+    void createOffscreenImages();
     void createVulkanPipeline();
     void createVulkanBuffers();
-    void createVulkanDrawCmds();
+    enum RecordKind
+    {
+        RECORD_DRAWS,
+        RECORD_COMPOSITION,
+        RECORD_IMGUI
+    };
+    struct RecordTask
+    {
+        RecordKind kind;
+        VkPipeline pipeline; // RECORD_DRAWS, RECORD_COMPOSITION
+        uint32_t firstInstance;
+        uint32_t instanceCount;
+    };
+    uint32_t recordDrawCmds(uint32_t frameIndex, const FrameData& frameData, const RenderState& state); // returns the draw calls
+    void recordSecondary(const RecordTask& task, VkCommandBuffer commandBuffer, uint32_t frameIndex, const FrameData& frameData, const RenderState& state);
 
     void createImguiContext();
+    void createImguiBackends(); // context, backends and fonts, only if m_imgui (no GLFW backend headless)
     void cleanupImguiContext();
-    void updateImgui(uint32_t frameIndex);
+    void recordImgui(VkCommandBuffer commandBuffer, ImDrawData* drawData);
+    uint32_t imguiDrawCalls(const ImDrawData* drawData) const;
     void renderImgui();
+    void drawProfiler();
+    void captureImgui(ImDrawData* dst);
+    void releaseImgui(ImDrawData* drawData);
     void recreateImguiSwapChain();
 
+    void present(uint32_t imageIndex);
     void recreateVulkanSwapChain();
     void cleanupVulkanSwapChain();
 
@@ -118,6 +211,5 @@ private:
 
 /* TODO:
 * overload std::shared_ptr using RAII (Base Code)
-* custom allocator
 * https://vulkan-tutorial.com/Loading_models
 */
\ No newline at end of file
@@ -7,6 +7,11 @@
 #include "Engine.h"
 #include "Window.h"
 #include "VulkanUtilities.h"
+#include "Utilities/Clock.h"
+#include "Utilities/Profiler.h"
+
+#define TIMELINE_ROW_HEIGHT 16.0f
+#define TIMELINE_MAX_EVENTS 4096 // per thread and view
 
 static bool show_demo_window = true;
 static ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
@@ -52,7 +57,8 @@ void Renderer::createImguiContext()
         attachmentDesc.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         attachmentDesc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         attachmentDesc.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-        attachmentDesc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // Last pass of the frame, headless it's read back instead of presented
+        attachmentDesc.finalLayout = m_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         VkAttachmentReference attachmentRef = {};
         attachmentRef.attachment = 0;
@@ -83,20 +89,49 @@ void Renderer::createImguiContext()
         assert( vkCreateRenderPass(m_device, &renderPassInfo, nullptr, &m_renderPass.imgui) == VK_SUCCESS );
     }
 
+    // Without ImGui the pass still runs (it's what leaves the image in its final layout) but draws nothing
+    if (m_imgui)
+    {
+        createImguiBackends();
+    }
+
+    VkFramebufferCreateInfo framebufferCreateInfo = {};
+    framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferCreateInfo.renderPass = m_renderPass.imgui;
+    framebufferCreateInfo.attachmentCount = 1;
+    framebufferCreateInfo.width = m_swapChainExtent.width;
+    framebufferCreateInfo.height = m_swapChainExtent.height;
+    framebufferCreateInfo.layers = 1;
+    m_imguiFramebuffers = new VkFramebuffer[m_swapChainImageCount];
+    for (int i = 0; i < m_swapChainImageCount; ++i)
+    {
+        framebufferCreateInfo.pAttachments = &m_swapChainImageViews[i];
+        assert( vkCreateFramebuffer(m_device, &framebufferCreateInfo, nullptr, &m_imguiFramebuffers[i]) == VK_SUCCESS );
+    }
+
+    for (int i = 0; i < 2; ++i)
+    {
+        m_renderStates[i].imgui = new ImDrawData();
+    }
+}
+
+void Renderer::createImguiBackends()
+{
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
     ImGuiIO& io = ImGui::GetIO(); (void)io;
 
     ImGui::StyleColorsDark();
 
-    ImGui_ImplGlfw_InitForVulkan(Engine::m_window.Get(), true);
+    if (!m_headless) ImGui_ImplGlfw_InitForVulkan(Engine::m_window.Get(), true);
+    else io.DisplaySize = ImVec2(m_swapChainExtent.width, m_swapChainExtent.height); // no platform backend to set it
     ImGui_ImplVulkan_InitInfo init_info = {};
     init_info.Instance = m_instance;
     init_info.PhysicalDevice = m_physicalDevice;
     init_info.Device = m_device;
     init_info.QueueFamily = (uint32_t)-1; // TODO: not used
     init_info.Queue = m_graphicsQueue;
-    init_info.PipelineCache = nullptr; // TODO:
+    init_info.PipelineCache = m_pipelineCache.get();
     init_info.DescriptorPool = m_imguiDescriptorPool; // TODO: separate pools?
     init_info.Allocator = nullptr; // TODO:
     init_info.MinImageCount = g_minImageCount; // TODO: 2?
@@ -111,59 +146,30 @@ void Renderer::createImguiContext()
         endCommandBuffer(m_device, m_commandPool, m_graphicsQueue, commandBuffer);
         ImGui_ImplVulkan_DestroyFontUploadObjects();
     }
-
-    m_imguiCommandPools = new VkCommandPool[m_swapChainImageCount];
-    m_imguiCommandBuffers = new VkCommandBuffer[m_swapChainImageCount];
-
-    VkCommandPoolCreateInfo poolCreateInfo = {};
-    poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    poolCreateInfo.queueFamilyIndex = m_graphicsFamily;
-    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-
-    VkCommandBufferAllocateInfo cmdBufferAllocInfo = {};
-    cmdBufferAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdBufferAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdBufferAllocInfo.commandBufferCount = 1;
-
-    for (int i=0; i<m_swapChainImageCount; ++i)
-    {
-        assert( vkCreateCommandPool(m_device, &poolCreateInfo, nullptr, &m_imguiCommandPools[i]) == VK_SUCCESS );
-        cmdBufferAllocInfo.commandPool = m_imguiCommandPools[i];
-        assert( vkAllocateCommandBuffers(m_device, &cmdBufferAllocInfo, &m_imguiCommandBuffers[i]) == VK_SUCCESS );
-    }
-
-    VkFramebufferCreateInfo framebufferCreateInfo = {};
-    framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-    framebufferCreateInfo.renderPass = m_renderPass.imgui;
-    framebufferCreateInfo.attachmentCount = 1;
-    framebufferCreateInfo.width = m_swapChainExtent.width;
-    framebufferCreateInfo.height = m_swapChainExtent.height;
-    framebufferCreateInfo.layers = 1;
-    m_imguiFramebuffers = new VkFramebuffer[m_swapChainImageCount];
-    for (int i = 0; i < m_swapChainImageCount; ++i)
-    {
-        framebufferCreateInfo.pAttachments = &m_swapChainImageViews[i];
-        assert( vkCreateFramebuffer(m_device, &framebufferCreateInfo, nullptr, &m_imguiFramebuffers[i]) == VK_SUCCESS );
-    }
 }
 
 void Renderer::cleanupImguiContext()
 {
+    for (int i = 0; i < 2; ++i)
+    {
+        releaseImgui(m_renderStates[i].imgui);
+        delete m_renderStates[i].imgui;
+    }
+
     for (int i=0; i<m_swapChainImageCount; ++i)
     {
-        vkFreeCommandBuffers(m_device, m_imguiCommandPools[i], 1, &m_imguiCommandBuffers[i]);
-        vkDestroyCommandPool(m_device, m_imguiCommandPools[i], nullptr);
         vkDestroyFramebuffer(m_device, m_imguiFramebuffers[i], nullptr);
     }
-    delete[] m_imguiCommandPools;
-    delete[] m_imguiCommandBuffers;
     delete[] m_imguiFramebuffers;
 
     vkDestroyDescriptorPool(m_device, m_imguiDescriptorPool, nullptr);
 
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (m_imgui)
+    {
+        ImGui_ImplVulkan_Shutdown();
+        if (!m_headless) ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
 
     // CleanupVulkanWindow();
     // CleanupVulkan();
@@ -172,7 +178,8 @@ void Renderer::cleanupImguiContext()
 void Renderer::renderImgui()
 {
     ImGui_ImplVulkan_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
+    if (!m_headless) ImGui_ImplGlfw_NewFrame();
+    else ImGui::GetIO().DeltaTime = Engine::m_clock.deltaTime(); // no input, the display size never changes
     ImGui::NewFrame();
 
     // 2. Show a simple window that we create ourselves. We use a Begin/End pair to created a named window.
@@ -194,6 +201,18 @@ void Renderer::renderImgui()
         ImGui::Text("counter = %d", counter);
 
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+        AllocatorStats memStats = m_allocator.stats();
+        ImGui::Text("GPU memory %.1f / %.1f MiB, %u allocations in %u blocks (+%u dedicated)",
+            memStats.usedBytes / (1024.0f * 1024.0f), memStats.blockBytes / (1024.0f * 1024.0f),
+            memStats.allocationCount, memStats.blockCount, memStats.dedicatedCount);
+        ImGui::Text("Textures %u / %u bindless slots", m_textureRegistry.count(), m_textureRegistry.capacity());
+        bool pipelined = m_pipelined;
+        if (ImGui::Checkbox("Pipelined frames", &pipelined)) setPipelined(pipelined);
+        ImGui::Text("Simulation %.0f Hz, %u steps this frame, alpha %.2f",
+            1.0f / Engine::m_clock.fixedDelta(), Engine::m_clock.stepsThisFrame(), Engine::m_clock.alpha());
+        float frameLimit = Engine::m_clock.frameLimit();
+        if (ImGui::InputFloat("Frame limit", &frameLimit, 10.0f, 60.0f, "%.0f")) Engine::m_clock.setFrameLimit(frameLimit);
         ImGui::End();
     }
 
@@ -220,64 +239,138 @@ void Renderer::renderImgui()
         ImGui::End();
     }
 
+    drawProfiler();
+
     ImGui::Render();
     // memcpy(&wd->ClearValue.color.float32[0], &clear_color, 4 * sizeof(float));
 }
 
-void Renderer::updateImgui(uint32_t frameIndex)
+void Renderer::drawProfiler()
 {
+    PROFILE_FUNCTION();
+    static bool paused = false;
+    static int viewFrames = 3;
+    static ProfileFrame frames[PROFILE_FRAMES];
+    static uint32_t frameCount = 0;
+    static ProfileEvent events[TIMELINE_MAX_EVENTS];
+
+    ImGui::Begin("Profiler");
+    bool recording = Profiler::isEnabled();
+    if (ImGui::Checkbox("Record", &recording)) Profiler::setEnabled(recording);
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &paused);
+    ImGui::SameLine();
+    if (ImGui::Button("Save trace")) Profiler::writeChromeTrace("trace.json");
+    ImGui::SameLine();
+    ImGui::PushItemWidth(100);
+    ImGui::SliderInt("Frames", &viewFrames, 1, 16);
+    ImGui::PopItemWidth();
+    if (!paused) frameCount = Profiler::frames(frames, PROFILE_FRAMES);
+    if (frameCount == 0)
     {
-        VkResult err;
-        {
-            err = vkResetCommandPool(m_device, m_imguiCommandPools[frameIndex], 0);
-            // check_vk_result(err); // TODO: implement for all
-            VkCommandBufferBeginInfo info = {};
-            info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            info.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-            err = vkBeginCommandBuffer(m_imguiCommandBuffers[frameIndex], &info);
-            // check_vk_result(err);
-        }
-        {
-            VkClearValue clearColor = {0.0f};
-            VkRenderPassBeginInfo info = {};
-            info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            info.renderPass = m_renderPass.imgui;
-            info.framebuffer = m_imguiFramebuffers[frameIndex];
-            info.renderArea.offset =  {0, 0};
-            info.renderArea.extent = m_swapChainExtent;
-            info.clearValueCount = 1;
-            info.pClearValues = &clearColor;
-            vkCmdBeginRenderPass(m_imguiCommandBuffers[frameIndex], &info, VK_SUBPASS_CONTENTS_INLINE);
-        }
+        ImGui::End();
+        return;
+    }
 
-        // Record Imgui Draw Data and draw funcs into command buffer
-        ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), m_imguiCommandBuffers[frameIndex]);
+    float frameTimes[PROFILE_FRAMES];
+    for (uint32_t i = 0; i < frameCount; ++i)
+    {
+        frameTimes[i] = (frames[i].end - frames[i].start) / 1000000.0f;
+    }
+    char overlay[64];
+    snprintf(overlay, sizeof(overlay), "%.2f ms", frameTimes[frameCount - 1]);
+    ImGui::PlotHistogram("##FrameTimes", frameTimes, frameCount, 0, overlay, 0.0f, 33.3f, ImVec2(ImGui::GetContentRegionAvail().x, 60.0f));
+
+    // Flame view of the last viewFrames frames, a lane per thread and a row per nesting depth
+    uint32_t first = frameCount > (uint32_t)viewFrames ? frameCount - viewFrames : 0;
+    uint64_t begin = frames[first].start;
+    uint64_t end = frames[frameCount - 1].end;
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float width = ImGui::GetContentRegionAvail().x;
+    float scale = width / (end - begin);
+    float y = origin.y;
+
+    for (uint32_t thread = 0; thread < Profiler::threadCount(); ++thread)
+    {
+        uint32_t count = Profiler::events(thread, begin, end, events, TIMELINE_MAX_EVENTS);
+        if (count == 0) continue;
+        drawList->AddText(ImVec2(origin.x, y), ImGui::GetColorU32(ImGuiCol_Text), Profiler::threadName(thread));
+        y += TIMELINE_ROW_HEIGHT;
 
-        // Submit command buffer
-        vkCmdEndRenderPass(m_imguiCommandBuffers[frameIndex]);
-        err = vkEndCommandBuffer(m_imguiCommandBuffers[frameIndex]);
-        /*
+        uint32_t depth = 0;
+        for (uint32_t i = 0; i < count; ++i)
         {
-            VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-            VkSubmitInfo info = {};
-            info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            info.waitSemaphoreCount = 1;
-            info.pWaitSemaphores = &image_acquired_semaphore;
-            info.pWaitDstStageMask = &wait_stage;
-            info.commandBufferCount = 1;
-            info.pCommandBuffers = &m_imguiCommandBuffers[frameIndex];
-            info.signalSemaphoreCount = 1;
-            info.pSignalSemaphores = &render_complete_semaphore;
-
-            err = vkEndCommandBuffer(m_imguiCommandBuffers[frameIndex]);
-            // check_vk_result(err);
-            err = vkQueueSubmit(m_graphicsQueue, 1, &info, fd->Fence);
-            // check_vk_result(err);
+            const ProfileEvent& event = events[i];
+            if (event.depth + 1 > depth) depth = event.depth + 1;
+
+            float x0 = origin.x + (event.start > begin ? event.start - begin : 0) * scale;
+            float x1 = origin.x + ((event.end < end ? event.end : end) - begin) * scale;
+            if (x1 - x0 < 1.0f) x1 = x0 + 1.0f;
+            ImVec2 min(x0, y + event.depth * TIMELINE_ROW_HEIGHT);
+            ImVec2 max(x1, min.y + TIMELINE_ROW_HEIGHT - 1.0f);
+
+            uint32_t hash = (uint32_t)((uintptr_t)event.name * 2654435761u); // names are literals, the pointer will do
+            ImU32 color = IM_COL32(96 + (hash >> 8) % 128, 96 + (hash >> 16) % 128, 96 + (hash >> 24) % 128, 255);
+            drawList->AddRectFilled(min, max, color);
+            if (x1 - x0 > ImGui::CalcTextSize(event.name).x + 4.0f)
+            {
+                drawList->AddText(ImVec2(x0 + 2.0f, min.y), IM_COL32_BLACK, event.name);
+            }
+            if (ImGui::IsMouseHoveringRect(min, max))
+            {
+                ImGui::SetTooltip("%s\n%.3f ms", event.name, (event.end - event.start) / 1000000.0f);
+            }
         }
-        //*/
+        y += depth * TIMELINE_ROW_HEIGHT;
     }
 
-    // FramePresent(wd);
+    for (uint32_t i = first; i < frameCount; ++i)
+    {
+        float x = origin.x + (frames[i].start - begin) * scale;
+        drawList->AddLine(ImVec2(x, origin.y), ImVec2(x, y), IM_COL32(255, 255, 255, 96));
+    }
+    ImGui::Dummy(ImVec2(width, y - origin.y));
+    ImGui::End();
+}
+
+void Renderer::recordImgui(VkCommandBuffer commandBuffer, ImDrawData* drawData)
+{
+    // Secondary inside the imgui render pass, begun by recordDrawCmds
+    ImGui_ImplVulkan_RenderDrawData(drawData, commandBuffer);
+}
+
+uint32_t Renderer::imguiDrawCalls(const ImDrawData* drawData) const
+{
+    uint32_t drawCalls = 0;
+    for (int i = 0; i < drawData->CmdListsCount; ++i)
+    {
+        drawCalls += drawData->CmdLists[i]->CmdBuffer.Size;
+    }
+    return drawCalls;
+}
+
+void Renderer::captureImgui(ImDrawData* dst)
+{
+    // The context's draw lists are rebuilt by the next NewFrame, likely while this one is being recorded
+    releaseImgui(dst);
+    ImDrawData* src = ImGui::GetDrawData();
+    *dst = *src;
+    dst->CmdLists = new ImDrawList*[src->CmdListsCount];
+    for (int i = 0; i < src->CmdListsCount; ++i)
+    {
+        dst->CmdLists[i] = src->CmdLists[i]->CloneOutput();
+    }
+}
+
+void Renderer::releaseImgui(ImDrawData* drawData)
+{
+    for (int i = 0; i < drawData->CmdListsCount; ++i)
+    {
+        IM_DELETE(drawData->CmdLists[i]);
+    }
+    delete[] drawData->CmdLists;
+    drawData->Clear();
 }
 
 // void Renderer::renderImgui()
@@ -0,0 +1,474 @@
+#include "AssetLoader.h"
+
+#include <assert.h>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <Middleware/stb_image.h>
+
+#include "VulkanUtilities.h"
+#include "TextureRegistry.h"
+#include "BlockCompression.h"
+#include "Utilities/Archive.h"
+#include "Utilities/DerivedDataCache.h"
+#include "Utilities/Defines.h"
+#include "Utilities/Profiler.h"
+
+// Bump the version whenever the baked payload changes
+#define TEXTURE_BAKE_SETTINGS "texture rgba8 mips v2"
+#define TEXTURE_BAKE_SETTINGS_BC "texture bc1/bc3 mips v1"
+
+// Down to 1x1
+static uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    while ((width | height) >> levels) levels++;
+    return levels;
+}
+
+// Levels back to back, largest first. Returns the whole chain's size
+static size_t mipOffsets(VkFormat format, uint32_t width, uint32_t height, uint32_t levels, VkDeviceSize* offsets)
+{
+    assert( levels <= UPLOAD_MAX_MIP_LEVELS );
+    size_t size = 0;
+    for (uint32_t i = 0; i < levels; ++i)
+    {
+        offsets[i] = size;
+        size += textureLevelSize(format, MAX(width >> i, 1u), MAX(height >> i, 1u));
+    }
+    return size;
+}
+
+// 2x2 box filter, odd sizes drop their last row or column, a side of 1 is repeated. Colour is
+// weighted by alpha so the (often black) colour of transparent texels doesn't bleed into edges
+static void downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst, uint32_t width, uint32_t height)
+{
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        uint32_t y0 = MIN(2 * y, srcHeight - 1), y1 = MIN(2 * y + 1, srcHeight - 1);
+        for (uint32_t x = 0; x < width; ++x)
+        {
+            uint32_t x0 = MIN(2 * x, srcWidth - 1), x1 = MIN(2 * x + 1, srcWidth - 1);
+            const uint8_t* texels[4] =
+            {
+                src + ((size_t)y0 * srcWidth + x0) * 4, src + ((size_t)y0 * srcWidth + x1) * 4,
+                src + ((size_t)y1 * srcWidth + x0) * 4, src + ((size_t)y1 * srcWidth + x1) * 4
+            };
+            uint32_t alpha = texels[0][3] + texels[1][3] + texels[2][3] + texels[3][3];
+            uint8_t* texel = dst + ((size_t)y * width + x) * 4;
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t sum = 0;
+                for (int i = 0; i < 4; ++i)
+                {
+                    sum += texels[i][c] * (alpha > 0 ? texels[i][3] : 1);
+                }
+                uint32_t weight = alpha > 0 ? alpha : 4;
+                texel[c] = (sum + weight / 2) / weight;
+            }
+            texel[3] = (alpha + 2) / 4;
+        }
+    }
+}
+
+// Fills in every level after the first
+static void generateMips(uint8_t* pixels, uint32_t width, uint32_t height, uint32_t levels)
+{
+    PROFILE_ZONE("Generate mips");
+    VkDeviceSize offsets[UPLOAD_MAX_MIP_LEVELS];
+    mipOffsets(VK_FORMAT_R8G8B8A8_UNORM, width, height, levels, offsets);
+    for (uint32_t i = 1; i < levels; ++i)
+    {
+        downsample(pixels + offsets[i - 1], MAX(width >> (i - 1), 1u), MAX(height >> (i - 1), 1u),
+                   pixels + offsets[i], MAX(width >> i, 1u), MAX(height >> i, 1u));
+    }
+}
+
+// Every level converted between RGBA8 and a block format, into a new[] chain
+static uint8_t* convertMips(const uint8_t* pixels, VkFormat from, VkFormat to, uint32_t width, uint32_t height, uint32_t levels, size_t& size)
+{
+    PROFILE_ZONE("Convert mips");
+    VkDeviceSize fromOffsets[UPLOAD_MAX_MIP_LEVELS], toOffsets[UPLOAD_MAX_MIP_LEVELS];
+    mipOffsets(from, width, height, levels, fromOffsets);
+    size = mipOffsets(to, width, height, levels, toOffsets);
+    uint8_t* converted = new uint8_t[size];
+    for (uint32_t i = 0; i < levels; ++i)
+    {
+        uint32_t levelWidth = MAX(width >> i, 1u), levelHeight = MAX(height >> i, 1u);
+        if (to == VK_FORMAT_R8G8B8A8_UNORM) decompressBlocks(from, pixels + fromOffsets[i], levelWidth, levelHeight, converted + toOffsets[i]);
+        else compressBlocks(to, pixels + fromOffsets[i], levelWidth, levelHeight, converted + toOffsets[i]);
+    }
+    return converted;
+}
+
+// The pixels, nullptr if it isn't a payload this version can upload
+static const uint8_t* bakedPixels(const uint8_t* baked, size_t size, BakedTexture& header)
+{
+    if (!baked || size < sizeof(header)) return nullptr;
+    memcpy(&header, baked, sizeof(header));
+    VkDeviceSize offsets[UPLOAD_MAX_MIP_LEVELS];
+    VkFormat format = static_cast<VkFormat>(header.format);
+    bool valid = (format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC3_UNORM_BLOCK) &&
+                 header.width > 0 && header.height > 0 &&
+                 header.width <= TEXTURE_MAX_SIZE && header.height <= TEXTURE_MAX_SIZE &&
+                 header.mipLevels > 0 && header.mipLevels <= mipLevelCount(header.width, header.height) &&
+                 header.mipLevels <= UPLOAD_MAX_MIP_LEVELS &&
+                 size == sizeof(header) + mipOffsets(format, header.width, header.height, header.mipLevels, offsets);
+    return valid ? baked + sizeof(header) : nullptr;
+}
+
+void AssetLoader::init(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, UploadQueue& uploads, TextureRegistry& registry, JobSystem& jobs, DerivedDataCache& cache, const Archive& archive, bool blockCompression)
+{
+    m_device = device;
+    m_allocator = &allocator;
+    m_uploads = &uploads;
+    m_registry = &registry;
+    m_jobs = &jobs;
+    m_cache = &cache;
+    m_archive = &archive;
+    m_blockCompression = blockCompression;
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    m_maxSize = MIN(properties.limits.maxImageDimension2D, TEXTURE_MAX_SIZE);
+
+    m_textures = new Texture[m_registry->capacity()];
+    for (uint32_t i = 0; i < m_registry->capacity(); ++i)
+    {
+        m_textures[i].state = TEXTURE_EMPTY;
+    }
+
+    // Placeholder, white so the instance tint still shows through
+    Texture& placeholder = m_textures[PLACEHOLDER_TEXTURE];
+    const uint32_t white = 0xFFFFFFFF;
+    strcpy(placeholder.path, "<placeholder>");
+    placeholder.pixels = nullptr;
+    placeholder.buffer = nullptr;
+    placeholder.unloading = false;
+    createTexture(placeholder, &white, 1, 1, 1, VK_FORMAT_R8G8B8A8_UNORM);
+    placeholder.slot = m_registry->add(placeholder.view);
+    placeholder.state = TEXTURE_READY; // anything drawing with it is submitted after the upload
+    m_textureCount = 1;
+}
+
+void AssetLoader::cleanup()
+{
+    m_jobs->wait(m_decodes); // decodes still write into m_textures
+    for (uint32_t i = 0; i < m_textureCount; ++i)
+    {
+        Texture& texture = m_textures[i];
+        if (texture.state == TEXTURE_DECODED) freePixels(texture);
+        if (texture.state == TEXTURE_UPLOADING || texture.state == TEXTURE_READY)
+        {
+            vkDestroyImageView(m_device, texture.view, nullptr);
+            destroyImage(m_device, *m_allocator, texture.image, texture.memory);
+        }
+    }
+    for (RetiredTexture& retired : m_retiredTextures)
+    {
+        vkDestroyImageView(m_device, retired.view, nullptr);
+        destroyImage(m_device, *m_allocator, retired.image, retired.memory);
+    }
+    m_retiredTextures.clear();
+    m_freeHandles.clear();
+    delete[] m_textures;
+    m_textureCount = 0;
+}
+
+TextureHandle AssetLoader::loadTexture(const char* path)
+{
+    PROFILE_ZONE("AssetLoader::loadTexture");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TextureHandle handle = allocate();
+    if (handle == PLACEHOLDER_TEXTURE)
+    {
+        std::cerr << "Out of texture handles: " << path << std::endl;
+        return handle;
+    }
+    Texture& texture = m_textures[handle];
+    strncpy(texture.path, path, sizeof(texture.path) - 1);
+    texture.path[sizeof(texture.path) - 1] = '\0';
+    texture.pixels = nullptr;
+    texture.buffer = nullptr;
+    texture.unloading = false;
+    texture.state = TEXTURE_DECODING;
+
+    m_jobs->submit([this, &texture]()
+    {
+        decode(texture);
+    }, &m_decodes, JOB_PRIORITY_LOW);
+    return handle;
+}
+
+TextureHandle AssetLoader::loadTexture(const void* pixels, uint32_t width, uint32_t height)
+{
+    PROFILE_ZONE("AssetLoader::loadTexture");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    TextureHandle handle = allocate();
+    if (handle == PLACEHOLDER_TEXTURE)
+    {
+        std::cerr << "Out of texture handles: <memory>" << std::endl;
+        return handle;
+    }
+    Texture& texture = m_textures[handle];
+    strcpy(texture.path, "<memory>");
+    texture.unloading = false;
+    if (width == 0 || height == 0 || width > m_maxSize || height > m_maxSize)
+    {
+        std::cerr << "Unsupported texture size: " << width << "x" << height << std::endl;
+        texture.buffer = nullptr;
+        texture.pixels = nullptr;
+        texture.state = TEXTURE_FAILED;
+        return handle;
+    }
+    // Small generated textures, the mips are cheap enough to build on the caller's thread
+    VkDeviceSize offsets[UPLOAD_MAX_MIP_LEVELS];
+    uint32_t levels = mipLevelCount(width, height);
+    texture.buffer = new uint8_t[mipOffsets(VK_FORMAT_R8G8B8A8_UNORM, width, height, levels, offsets)];
+    memcpy(texture.buffer, pixels, (size_t)width * height * 4);
+    generateMips(texture.buffer, width, height, levels);
+    texture.pixels = texture.buffer;
+    texture.width = width;
+    texture.height = height;
+    texture.mipLevels = levels;
+    texture.format = VK_FORMAT_R8G8B8A8_UNORM;
+    texture.state = TEXTURE_DECODED;
+    return handle;
+}
+
+void AssetLoader::unloadTexture(TextureHandle handle)
+{
+    if (handle == PLACEHOLDER_TEXTURE) return; // handed out when a load failed for want of handles
+    std::lock_guard<std::mutex> lock(m_mutex);
+    assert( handle < m_textureCount );
+    m_textures[handle].unloading = true; // the registry and images belong to the render thread
+}
+
+void AssetLoader::update()
+{
+    PROFILE_ZONE("AssetLoader::update");
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (uint32_t i = 0; i < m_textureCount; ++i)
+    {
+        Texture& texture = m_textures[i];
+        uint8_t state = texture.state.load(std::memory_order_acquire);
+        if (texture.unloading && state != TEXTURE_DECODING && state != TEXTURE_EMPTY)
+        {
+            retire(texture);
+            release(i);
+            continue;
+        }
+
+        switch (state)
+        {
+        case TEXTURE_DECODED:
+            createTexture(texture, texture.pixels, texture.width, texture.height, texture.mipLevels, texture.format);
+            freePixels(texture);
+            texture.state = TEXTURE_UPLOADING;
+            break;
+        case TEXTURE_UPLOADING:
+            // Handles are freed before their slots retire, so a slot may still be a few frames off
+            if (m_uploads->isComplete(texture.ticket) && !m_registry->isFull())
+            {
+                // A fresh slot, so no frame in flight is sampling the descriptor being written
+                texture.slot = m_registry->add(texture.view);
+                texture.state = TEXTURE_READY;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    uint32_t retired = 0;
+    while (retired < m_retiredTextures.size() && m_registry->isRetired(m_retiredTextures[retired].frame))
+    {
+        RetiredTexture& texture = m_retiredTextures[retired];
+        vkDestroyImageView(m_device, texture.view, nullptr);
+        destroyImage(m_device, *m_allocator, texture.image, texture.memory);
+        retired++;
+    }
+    m_retiredTextures.erase(m_retiredTextures.begin(), m_retiredTextures.begin() + retired);
+}
+
+bool AssetLoader::isReady(TextureHandle texture) const
+{
+    return m_textures[texture].state == TEXTURE_READY;
+}
+
+uint32_t AssetLoader::pendingCount() const
+{
+    uint32_t pending = 0;
+    for (uint32_t i = 0; i < m_textureCount; ++i)
+    {
+        uint8_t state = m_textures[i].state.load(std::memory_order_relaxed);
+        if (state == TEXTURE_DECODING || state == TEXTURE_DECODED || state == TEXTURE_UPLOADING) pending++;
+    }
+    return pending;
+}
+
+uint32_t AssetLoader::freeCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_registry->capacity() - m_textureCount + m_freeHandles.size();
+}
+
+uint32_t AssetLoader::slot(TextureHandle texture) const
+{
+    if (texture >= m_textureCount || !isReady(texture)) return m_textures[PLACEHOLDER_TEXTURE].slot;
+    return m_textures[texture].slot;
+}
+
+uint8_t* AssetLoader::bake(const void* source, size_t size, size_t& bakedSize, bool blockCompression)
+{
+    int width, height, channels;
+    stbi_uc* pixels = stbi_load_from_memory(static_cast<const stbi_uc*>(source), (int)size, &width, &height, &channels, STBI_rgb_alpha);
+    if (!pixels) return nullptr;
+    if ((uint32_t)width > TEXTURE_MAX_SIZE || (uint32_t)height > TEXTURE_MAX_SIZE)
+    {
+        stbi_image_free(pixels);
+        return nullptr;
+    }
+    BakedTexture header = { (uint32_t)width, (uint32_t)height, VK_FORMAT_R8G8B8A8_UNORM, mipLevelCount(width, height) };
+    VkDeviceSize offsets[UPLOAD_MAX_MIP_LEVELS];
+    bakedSize = sizeof(header) + mipOffsets(VK_FORMAT_R8G8B8A8_UNORM, header.width, header.height, header.mipLevels, offsets);
+    uint8_t* baked = new uint8_t[bakedSize];
+    memcpy(baked, &header, sizeof(header));
+    memcpy(baked + sizeof(header), pixels, (size_t)width * height * 4);
+    stbi_image_free(pixels);
+    generateMips(baked + sizeof(header), header.width, header.height, header.mipLevels);
+    if (!blockCompression) return baked;
+
+    // Mips are filtered before compressing, compressed levels don't downsample well
+    VkFormat format = selectBlockFormat(baked + sizeof(header), header.width, header.height);
+    size_t blocksSize;
+    uint8_t* blocks = convertMips(baked + sizeof(header), VK_FORMAT_R8G8B8A8_UNORM, format, header.width, header.height, header.mipLevels, blocksSize);
+    delete[] baked;
+    header.format = format;
+    bakedSize = sizeof(header) + blocksSize;
+    baked = new uint8_t[bakedSize];
+    memcpy(baked, &header, sizeof(header));
+    memcpy(baked + sizeof(header), blocks, blocksSize);
+    delete[] blocks;
+    return baked;
+}
+
+// Baked in the archive, otherwise the source (mapped or read) is hashed and only decoded on a
+// cache miss. Block compressed payloads are expanded to RGBA8 on devices without BC support
+void AssetLoader::decode(Texture& texture) const
+{
+    PROFILE_ZONE("Decode texture");
+    BakedTexture header;
+    size_t sourceSize;
+    uint32_t type;
+    const uint8_t* source = m_archive->find(texture.path, sourceSize, type);
+    uint8_t* sourceBuffer = nullptr;
+    if (source && type == ARCHIVE_BAKED_TEXTURE)
+    {
+        texture.pixels = bakedPixels(source, sourceSize, header);
+    }
+    else
+    {
+        if (!source) source = sourceBuffer = readFile(texture.path, sourceSize);
+        if (source)
+        {
+            uint64_t key = DerivedDataCache::key(source, sourceSize, m_blockCompression ? TEXTURE_BAKE_SETTINGS_BC : TEXTURE_BAKE_SETTINGS);
+            size_t size;
+            texture.buffer = m_cache->load(key, size);
+            texture.pixels = bakedPixels(texture.buffer, size, header);
+            if (!texture.pixels)
+            {
+                delete[] texture.buffer;
+                texture.buffer = bake(source, sourceSize, size, m_blockCompression);
+                texture.pixels = bakedPixels(texture.buffer, size, header);
+                if (texture.pixels) m_cache->store(key, texture.buffer, size);
+            }
+        }
+        delete[] sourceBuffer;
+    }
+    if (texture.pixels && (header.width > m_maxSize || header.height > m_maxSize))
+    {
+        std::cerr << "Texture larger than the device supports: " << texture.path << std::endl;
+        texture.pixels = nullptr;
+    }
+    if (texture.pixels && header.format != VK_FORMAT_R8G8B8A8_UNORM && !m_blockCompression)
+    {
+        size_t size;
+        uint8_t* expanded = convertMips(texture.pixels, static_cast<VkFormat>(header.format), VK_FORMAT_R8G8B8A8_UNORM,
+                                        header.width, header.height, header.mipLevels, size);
+        delete[] texture.buffer;
+        texture.buffer = expanded;
+        texture.pixels = expanded;
+        header.format = VK_FORMAT_R8G8B8A8_UNORM;
+    }
+    if (texture.pixels)
+    {
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.mipLevels = header.mipLevels;
+        texture.format = static_cast<VkFormat>(header.format);
+    }
+    else
+    {
+        std::cerr << "Failed to load texture: " << texture.path << std::endl; // keeps the placeholder
+        delete[] texture.buffer;
+        texture.buffer = nullptr;
+    }
+    texture.state.store(texture.pixels ? TEXTURE_DECODED : TEXTURE_FAILED, std::memory_order_release);
+}
+
+void AssetLoader::freePixels(Texture& texture)
+{
+    delete[] texture.buffer;
+    texture.buffer = nullptr;
+    texture.pixels = nullptr;
+}
+
+TextureHandle AssetLoader::allocate()
+{
+    if (!m_freeHandles.empty())
+    {
+        TextureHandle handle = m_freeHandles.back();
+        m_freeHandles.pop_back();
+        return handle;
+    }
+    if (m_textureCount == m_registry->capacity()) return PLACEHOLDER_TEXTURE;
+    return m_textureCount++;
+}
+
+void AssetLoader::createTexture(Texture& texture, const void* pixels, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format)
+{
+    VkDeviceSize offsets[UPLOAD_MAX_MIP_LEVELS];
+    size_t size = mipOffsets(format, width, height, mipLevels, offsets);
+    createImage(m_device, *m_allocator, width, height,
+        format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        texture.image, texture.memory, mipLevels);
+    texture.ticket = m_uploads->uploadImage(texture.image, width, height, pixels, size, mipLevels, offsets);
+    createImageView(m_device, texture.image, format, VK_IMAGE_ASPECT_COLOR_BIT, texture.view, mipLevels);
+}
+
+void AssetLoader::retire(Texture& texture)
+{
+    switch (texture.state.load(std::memory_order_relaxed))
+    {
+    case TEXTURE_DECODED:
+        freePixels(texture);
+        break;
+    case TEXTURE_READY:
+        m_registry->remove(texture.slot);
+        // fallthrough
+    case TEXTURE_UPLOADING:
+        // The copy was submitted ahead of an earlier frame, so it retires along with that frame
+        m_retiredTextures.push_back({ texture.image, texture.memory, texture.view, m_registry->frame() });
+        break;
+    default:
+        break;
+    }
+}
+
+void AssetLoader::release(TextureHandle texture)
+{
+    m_textures[texture].state = TEXTURE_EMPTY;
+    m_freeHandles.push_back(texture);
+}
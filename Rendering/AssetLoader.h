@@ -0,0 +1,126 @@
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <vulkan/vulkan.h> // TODO: forward declare
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "MemoryAllocator.h"
+#include "UploadQueue.h"
+#include "Utilities/JobSystem.h"
+
+class TextureRegistry;
+class DerivedDataCache;
+class Archive;
+
+typedef uint32_t TextureHandle;
+
+#define PLACEHOLDER_TEXTURE 0
+#define TEXTURE_MAX_SIZE (1u << (UPLOAD_MAX_MIP_LEVELS - 1)) // a side, larger ones have too many mip levels
+
+// Decoded texture as it's cached and packed: this header then the pixels, every mip level back
+// to back from the full size one down
+struct BakedTexture
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t format; // VkFormat
+    uint32_t mipLevels;
+};
+
+// Decodes images as low priority jobs and uploads them from the render thread. A handle is valid
+// immediately, slot() returns the placeholder's bindless slot until the GPU copy has completed.
+// Handles can be loaded and unloaded from the simulation while the render thread updates.
+// Decoded pixels are kept in the derived data cache, a warm start loads them instead of decoding.
+// Textures baked into the archive are uploaded straight from its mapping. With block compression
+// textures are baked to BC1 (opaque) or BC3, a quarter or half of RGBA8's memory and bandwidth.
+class AssetLoader
+{
+public:
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, UploadQueue& uploads, TextureRegistry& registry, JobSystem& jobs, DerivedDataCache& cache, const Archive& archive,
+              bool blockCompression); // the device samples BC1 and BC3
+    void cleanup();
+
+    // An encoded image (PNG, JPEG) to a new[] BakedTexture with a full mip chain, nullptr if it
+    // can't be decoded or a side is over TEXTURE_MAX_SIZE
+    static uint8_t* bake(const void* source, size_t size, size_t& bakedSize, bool blockCompression);
+
+    // Out of handles the placeholder is returned, unloading it does nothing
+    TextureHandle loadTexture(const char* path);
+    // RGBA8 already in memory (generated, embedded), copied, uploaded by the next update. Fails
+    // (keeps the placeholder) if it's larger than the device or TEXTURE_MAX_SIZE allows
+    TextureHandle loadTexture(const void* pixels, uint32_t width, uint32_t height);
+    // The handle is free for reuse after the next update, the image once no frame in flight can sample it
+    void unloadTexture(TextureHandle texture);
+
+    // Render thread, once per frame
+    void update();
+
+    bool isReady(TextureHandle texture) const;
+    uint32_t pendingCount() const; // still decoding or uploading
+    uint32_t freeCount() const; // handles left to load into, unloaded ones count from the next update
+    uint32_t slot(TextureHandle texture) const; // index into the shader's bindless texture array
+
+private:
+    enum TextureState
+    {
+        TEXTURE_EMPTY,
+        TEXTURE_DECODING,
+        TEXTURE_DECODED,
+        TEXTURE_UPLOADING,
+        TEXTURE_READY,
+        TEXTURE_FAILED
+    };
+
+    struct Texture
+    {
+        std::atomic<uint8_t> state;
+        char path[256];
+        // Written by the worker before state becomes TEXTURE_DECODED
+        const uint8_t* pixels; // RGBA8
+        uint8_t* buffer; // new[], holds the pixels unless they're in the archive
+        uint32_t width, height, mipLevels;
+        VkFormat format;
+        bool unloading; // released by update, once the worker is done if it's still decoding
+
+        VkImage image;
+        Allocation memory;
+        VkImageView view;
+        UploadTicket ticket;
+        uint32_t slot;
+    };
+
+    struct RetiredTexture
+    {
+        VkImage image;
+        Allocation memory;
+        VkImageView view;
+        uint64_t frame;
+    };
+
+    TextureHandle allocate(); // under m_mutex, PLACEHOLDER_TEXTURE when there are none left
+    void decode(Texture& texture) const; // worker
+    void freePixels(Texture& texture);
+    void createTexture(Texture& texture, const void* pixels, uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format);
+    void retire(Texture& texture);
+    void release(TextureHandle texture);
+
+    VkDevice m_device;
+    MemoryAllocator* m_allocator;
+    UploadQueue* m_uploads;
+    TextureRegistry* m_registry;
+    JobSystem* m_jobs;
+    DerivedDataCache* m_cache;
+    const Archive* m_archive;
+    bool m_blockCompression;
+    uint32_t m_maxSize; // a side, TEXTURE_MAX_SIZE or the device limit
+    JobCounter m_decodes;
+
+    mutable std::mutex m_mutex; // handle allocation, unloading
+    Texture* m_textures; // one per registry slot
+    std::atomic<uint32_t> m_textureCount; // high water mark
+    std::vector<TextureHandle> m_freeHandles;
+    std::vector<RetiredTexture> m_retiredTextures;
+};
+
+#endif /* ASSET_LOADER_H */
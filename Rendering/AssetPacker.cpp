@@ -0,0 +1,93 @@
+#include "AssetPacker.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "AssetLoader.h"
+#include "Utilities/Archive.h"
+#include "Utilities/DerivedDataCache.h"
+
+static bool hasExtension(const char* path, const char* const* extensions, int count)
+{
+    const char* extension = strrchr(path, '.');
+    if (!extension) return false;
+    for (int i = 0; i < count; ++i)
+    {
+        if (strcmp(extension, extensions[i]) == 0) return true;
+    }
+    return false;
+}
+
+static bool packFile(ArchiveBuilder& builder, const char* path)
+{
+    static const char* const images[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+    static const char* const shaders[] = { ".spv" };
+    bool image = hasExtension(path, images, sizeof(images) / sizeof(images[0]));
+    if (!image && !hasExtension(path, shaders, sizeof(shaders) / sizeof(shaders[0]))) return true;
+
+    size_t size;
+    uint8_t* data = readFile(path, size);
+    if (!data)
+    {
+        std::cerr << "Failed to read " << path << std::endl;
+        return false;
+    }
+    if (image)
+    {
+        size_t bakedSize;
+        uint8_t* baked = AssetLoader::bake(data, size, bakedSize, true); // expanded at load where BC isn't supported
+        if (baked) builder.add(path, baked, bakedSize, ARCHIVE_BAKED_TEXTURE);
+        else std::cerr << "Failed to decode " << path << " (or larger than " << TEXTURE_MAX_SIZE << ")" << std::endl;
+        delete[] baked;
+        delete[] data;
+        return baked != nullptr;
+    }
+    builder.add(path, data, size);
+    delete[] data;
+    return true;
+}
+
+static bool packPath(ArchiveBuilder& builder, const char* path)
+{
+    struct stat info;
+    if (stat(path, &info) != 0)
+    {
+        std::cerr << "No such file or directory: " << path << std::endl;
+        return false;
+    }
+    if (!S_ISDIR(info.st_mode)) return packFile(builder, path);
+
+    DIR* dir = opendir(path);
+    if (!dir) return false;
+    bool packed = true;
+    while (dirent* entry = readdir(dir))
+    {
+        if (entry->d_name[0] == '.') continue;
+        char child[ARCHIVE_PATH_SIZE];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        packed = packPath(builder, child) && packed;
+    }
+    closedir(dir);
+    return packed;
+}
+
+bool packAssets(const char* archivePath, char** paths, int count)
+{
+    ArchiveBuilder builder;
+    bool packed = true;
+    for (int i = 0; i < count; ++i)
+    {
+        char path[ARCHIVE_PATH_SIZE];
+        snprintf(path, sizeof(path), "%s", paths[i]);
+        size_t length = strlen(path);
+        while (length > 1 && path[length - 1] == '/') path[--length] = '\0'; // names have to match the loader's
+        packed = packPath(builder, path) && packed;
+    }
+    bool written = builder.write(archivePath);
+    if (written) std::cout << "Packed " << builder.count() << " files into " << archivePath << std::endl;
+    builder.cleanup();
+    return written && packed;
+}
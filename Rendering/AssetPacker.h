@@ -0,0 +1,10 @@
+#ifndef ASSET_PACKER_H
+#define ASSET_PACKER_H
+
+// --pack <archive> <path>..., needs no window or device. Packs the files and directories (walked
+// recursively) into an Archive under the paths they're loaded by, so run it from the same working
+// directory as the engine. Images are baked to block compressed textures, SPIR-V is stored as is, anything
+// else (shader sources, scripts) is skipped. Returns false if any file failed or nothing was written.
+bool packAssets(const char* archivePath, char** paths, int count);
+
+#endif /* ASSET_PACKER_H */
@@ -0,0 +1,299 @@
+#include "BlockCompression.h"
+
+#include <assert.h>
+#include <cstring>
+
+#include "Utilities/Defines.h"
+
+#define BLOCK_SIZE 4
+
+static uint16_t packColor(const int* rgb)
+{
+    return (uint16_t)((((rgb[0] * 31 + 127) / 255) << 11) | (((rgb[1] * 63 + 127) / 255) << 5) | ((rgb[2] * 31 + 127) / 255));
+}
+
+static void unpackColor(uint16_t color, int* rgb)
+{
+    int r = color >> 11, g = (color >> 5) & 63, b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// 4x4 texels starting at (x, y), edges clamped
+static void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint8_t texels[16][4])
+{
+    for (uint32_t j = 0; j < BLOCK_SIZE; ++j)
+    {
+        uint32_t row = MIN(y + j, height - 1);
+        for (uint32_t i = 0; i < BLOCK_SIZE; ++i)
+        {
+            uint32_t column = MIN(x + i, width - 1);
+            memcpy(texels[j * BLOCK_SIZE + i], rgba + ((size_t)row * width + column) * 4, 4);
+        }
+    }
+}
+
+static void storeBlock(const uint8_t texels[16][4], uint32_t width, uint32_t height, uint32_t x, uint32_t y, uint8_t* rgba)
+{
+    for (uint32_t j = 0; j < BLOCK_SIZE && y + j < height; ++j)
+    {
+        for (uint32_t i = 0; i < BLOCK_SIZE && x + i < width; ++i)
+        {
+            memcpy(rgba + ((size_t)(y + j) * width + x + i) * 4, texels[j * BLOCK_SIZE + i], 4);
+        }
+    }
+}
+
+// Endpoints from the colour bounding box, along the diagonal the texels actually follow and inset
+// a little since the extremes are rarely hit. color0 > color1 selects 4 colour mode, which BC3
+// assumes anyway
+static void compressColor(const uint8_t texels[16][4], uint8_t* block)
+{
+    int lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 }, mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            lo[c] = MIN(lo[c], (int)texels[i][c]);
+            hi[c] = MAX(hi[c], (int)texels[i][c]);
+            mean[c] += texels[i][c];
+        }
+    }
+    int axis = 0; // widest channel, the others are flipped if they fall as it rises
+    for (int c = 1; c < 3; ++c)
+    {
+        if (hi[c] - lo[c] > hi[axis] - lo[axis]) axis = c;
+    }
+    for (int c = 0; c < 3; ++c)
+    {
+        int covariance = 0;
+        for (int i = 0; i < 16; ++i)
+        {
+            covariance += (16 * texels[i][axis] - mean[axis]) * (16 * texels[i][c] - mean[c]) / 256;
+        }
+        int inset = (hi[c] - lo[c]) >> 4;
+        lo[c] += inset;
+        hi[c] -= inset;
+        if (covariance < 0)
+        {
+            int swap = lo[c];
+            lo[c] = hi[c];
+            hi[c] = swap;
+        }
+    }
+    uint16_t color0 = packColor(hi), color1 = packColor(lo);
+    if (color0 < color1)
+    {
+        uint16_t swap = color0;
+        color0 = color1;
+        color1 = swap;
+    }
+
+    uint32_t indices = 0;
+    if (color0 != color1)
+    {
+        int palette[4][3];
+        unpackColor(color0, palette[0]);
+        unpackColor(color1, palette[1]);
+        for (int c = 0; c < 3; ++c)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0, bestDistance = 0x7FFFFFFF;
+            for (int p = 0; p < 4; ++p)
+            {
+                int distance = 0;
+                for (int c = 0; c < 3; ++c)
+                {
+                    int d = texels[i][c] - palette[p][c];
+                    distance += d * d;
+                }
+                if (distance < bestDistance)
+                {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            indices |= (uint32_t)best << (2 * i);
+        }
+    }
+    block[0] = color0 & 0xFF;
+    block[1] = color0 >> 8;
+    block[2] = color1 & 0xFF;
+    block[3] = color1 >> 8;
+    memcpy(block + 4, &indices, 4); // little endian, like the format
+}
+
+static void decompressColor(const uint8_t* block, bool fourColor, uint8_t texels[16][4])
+{
+    uint16_t color0 = block[0] | (block[1] << 8), color1 = block[2] | (block[3] << 8);
+    int palette[4][4];
+    unpackColor(color0, palette[0]);
+    unpackColor(color1, palette[1]);
+    palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+    for (int c = 0; c < 3; ++c)
+    {
+        if (fourColor || color0 > color1)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        else
+        {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0; // black, transparent in BC1_RGBA which isn't used
+        }
+    }
+    uint32_t indices;
+    memcpy(&indices, block + 4, 4);
+    for (int i = 0; i < 16; ++i)
+    {
+        const int* color = palette[(indices >> (2 * i)) & 3];
+        for (int c = 0; c < 4; ++c)
+        {
+            texels[i][c] = color[c];
+        }
+    }
+}
+
+// alpha0 > alpha1 selects the 8 value mode
+static void compressAlpha(const uint8_t texels[16][4], uint8_t* block)
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        lo = MIN(lo, (int)texels[i][3]);
+        hi = MAX(hi, (int)texels[i][3]);
+    }
+    uint64_t indices = 0;
+    if (hi != lo)
+    {
+        int palette[8] = { hi, lo };
+        for (int p = 1; p < 7; ++p)
+        {
+            palette[p + 1] = ((7 - p) * hi + p * lo) / 7;
+        }
+        for (int i = 0; i < 16; ++i)
+        {
+            int best = 0, bestDistance = 256;
+            for (int p = 0; p < 8; ++p)
+            {
+                int distance = texels[i][3] > palette[p] ? texels[i][3] - palette[p] : palette[p] - texels[i][3];
+                if (distance < bestDistance)
+                {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            indices |= (uint64_t)best << (3 * i);
+        }
+    }
+    block[0] = hi;
+    block[1] = lo;
+    for (int i = 0; i < 6; ++i)
+    {
+        block[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+static void decompressAlpha(const uint8_t* block, uint8_t texels[16][4])
+{
+    int palette[8] = { block[0], block[1] };
+    if (block[0] > block[1])
+    {
+        for (int p = 1; p < 7; ++p)
+        {
+            palette[p + 1] = ((7 - p) * block[0] + p * block[1]) / 7;
+        }
+    }
+    else
+    {
+        for (int p = 1; p < 5; ++p)
+        {
+            palette[p + 1] = ((5 - p) * block[0] + p * block[1]) / 5;
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; ++i)
+    {
+        indices |= (uint64_t)block[2 + i] << (8 * i);
+    }
+    for (int i = 0; i < 16; ++i)
+    {
+        texels[i][3] = palette[(indices >> (3 * i)) & 7];
+    }
+}
+
+size_t textureLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+    size_t blocks = (size_t)((width + BLOCK_SIZE - 1) / BLOCK_SIZE) * ((height + BLOCK_SIZE - 1) / BLOCK_SIZE);
+    switch (format)
+    {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        return blocks * 8;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+        return blocks * 16;
+    default:
+        assert( format == VK_FORMAT_R8G8B8A8_UNORM );
+        return (size_t)width * height * 4;
+    }
+}
+
+VkFormat selectBlockFormat(const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    for (size_t i = 0; i < (size_t)width * height; ++i)
+    {
+        if (rgba[i * 4 + 3] != 255) return VK_FORMAT_BC3_UNORM_BLOCK;
+    }
+    return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+}
+
+void compressBlocks(VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks)
+{
+    assert( format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC3_UNORM_BLOCK );
+    uint8_t texels[16][4];
+    for (uint32_t y = 0; y < height; y += BLOCK_SIZE)
+    {
+        for (uint32_t x = 0; x < width; x += BLOCK_SIZE)
+        {
+            loadBlock(rgba, width, height, x, y, texels);
+            if (format == VK_FORMAT_BC3_UNORM_BLOCK)
+            {
+                compressAlpha(texels, blocks);
+                blocks += 8;
+            }
+            compressColor(texels, blocks);
+            blocks += 8;
+        }
+    }
+}
+
+void decompressBlocks(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba)
+{
+    assert( format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC3_UNORM_BLOCK );
+    uint8_t texels[16][4];
+    for (uint32_t y = 0; y < height; y += BLOCK_SIZE)
+    {
+        for (uint32_t x = 0; x < width; x += BLOCK_SIZE)
+        {
+            if (format == VK_FORMAT_BC3_UNORM_BLOCK)
+            {
+                decompressColor(blocks + 8, true, texels);
+                decompressAlpha(blocks, texels);
+                blocks += 16;
+            }
+            else
+            {
+                decompressColor(blocks, false, texels);
+                blocks += 8;
+            }
+            storeBlock(texels, width, height, x, y, rgba);
+        }
+    }
+}
@@ -0,0 +1,21 @@
+#ifndef BLOCK_COMPRESSION_H
+#define BLOCK_COMPRESSION_H
+
+#include <vulkan/vulkan.h> // TODO: forward declare
+#include <stdint.h>
+#include <stddef.h>
+
+// RGBA8 images to and from BC1 (opaque, 8 bytes a 4x4 block) and BC3 (BC1 colour plus an alpha
+// block, 16 bytes). The encoder fits each block's bounding box, fast enough to bake on load, not
+// the best quality an offline compressor could get. Any size: blocks past the edge repeat the
+// last row and column.
+
+// One image's (one mip level's) bytes, VK_FORMAT_R8G8B8A8_UNORM included
+size_t textureLevelSize(VkFormat format, uint32_t width, uint32_t height);
+// BC1 if every texel is opaque, BC3 otherwise
+VkFormat selectBlockFormat(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+void compressBlocks(VkFormat format, const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* blocks);
+void decompressBlocks(VkFormat format, const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
+
+#endif /* BLOCK_COMPRESSION_H */
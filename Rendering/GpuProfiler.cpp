@@ -0,0 +1,91 @@
+#include "GpuProfiler.h"
+
+#include <assert.h>
+
+#include "Utilities/Profiler.h"
+
+void GpuProfiler::init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t frameCount,
+                       const char* const* zoneNames, uint32_t zoneCount)
+{
+    assert( zoneCount + 1 <= GPU_MAX_TIMESTAMPS );
+    m_device = device;
+    m_frameCount = frameCount;
+    m_zoneNames = zoneNames;
+    m_zoneCount = zoneCount;
+    m_submitTimes = new uint64_t[m_frameCount];
+    for (uint32_t i = 0; i < m_frameCount; ++i)
+    {
+        m_submitTimes[i] = 0;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    uint32_t familyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    VkQueueFamilyProperties* families = new VkQueueFamilyProperties[familyCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families);
+    uint32_t validBits = families[queueFamily].timestampValidBits;
+    delete[] families;
+
+    m_supported = validBits > 0 && properties.limits.timestampPeriod > 0.0f;
+    m_period = properties.limits.timestampPeriod;
+    m_mask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+    m_pool = VK_NULL_HANDLE;
+    if (!m_supported) return;
+
+    VkQueryPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolCreateInfo.queryCount = m_frameCount * GPU_MAX_TIMESTAMPS;
+    assert( vkCreateQueryPool(m_device, &poolCreateInfo, nullptr, &m_pool) == VK_SUCCESS );
+}
+
+void GpuProfiler::cleanup()
+{
+    if (m_pool != VK_NULL_HANDLE) vkDestroyQueryPool(m_device, m_pool, nullptr);
+    delete[] m_submitTimes;
+}
+
+void GpuProfiler::begin(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    if (!m_supported) return;
+    vkCmdResetQueryPool(commandBuffer, m_pool, frame * GPU_MAX_TIMESTAMPS, m_zoneCount + 1);
+}
+
+void GpuProfiler::write(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t timestamp, VkPipelineStageFlagBits stage)
+{
+    if (!m_supported) return;
+    assert( timestamp <= m_zoneCount );
+    vkCmdWriteTimestamp(commandBuffer, stage, m_pool, frame * GPU_MAX_TIMESTAMPS + timestamp);
+}
+
+void GpuProfiler::submitted(uint32_t frame)
+{
+    if (!m_supported) return;
+    m_submitTimes[frame] = Profiler::now();
+}
+
+void GpuProfiler::collect(uint32_t frame)
+{
+    if (!m_supported || m_submitTimes[frame] == 0) return;
+
+    uint64_t timestamps[GPU_MAX_TIMESTAMPS];
+    VkResult result = vkGetQueryPoolResults(m_device, m_pool, frame * GPU_MAX_TIMESTAMPS, m_zoneCount + 1,
+        sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    uint64_t submitTime = m_submitTimes[frame];
+    m_submitTimes[frame] = 0;
+    if (result != VK_SUCCESS) return; // VK_NOT_READY, e.g. the frame was skipped
+
+    for (uint32_t i = 0; i < m_zoneCount; ++i)
+    {
+        // Masked differences survive the counter wrapping
+        uint64_t start = submitTime + uint64_t(((timestamps[i] - timestamps[0]) & m_mask) * m_period);
+        uint64_t end = submitTime + uint64_t(((timestamps[i + 1] - timestamps[0]) & m_mask) * m_period);
+        Profiler::gpuZone(m_zoneNames[i], start, end, 0);
+    }
+}
+
+bool GpuProfiler::isSupported() const
+{
+    return m_supported;
+}
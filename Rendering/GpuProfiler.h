@@ -0,0 +1,43 @@
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <vulkan/vulkan.h> // TODO: forward declare
+#include <stdint.h>
+
+#define GPU_MAX_TIMESTAMPS 16 // per frame in flight
+
+// Timestamp queries per frame in flight. Zone i runs from timestamp i to timestamp i + 1, so
+// frames write timestamps 0..zoneCount in order. Results are read back without stalling once the
+// frame's fence has been waited on and handed to the Profiler on its GPU track. GPU and CPU clocks
+// aren't calibrated against each other, the zones are placed from the frame's submit time.
+// Render thread only.
+class GpuProfiler
+{
+public:
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamily, uint32_t frameCount,
+              const char* const* zoneNames, uint32_t zoneCount);
+    void cleanup();
+
+    // Outside a render pass, before any write() for the frame
+    void begin(VkCommandBuffer commandBuffer, uint32_t frame);
+    void write(VkCommandBuffer commandBuffer, uint32_t frame, uint32_t timestamp, VkPipelineStageFlagBits stage);
+    void submitted(uint32_t frame); // right before the frame's submit
+    // After waiting on the frame's fence, before begin()
+    void collect(uint32_t frame);
+
+    bool isSupported() const;
+
+private:
+    VkDevice m_device;
+    VkQueryPool m_pool;
+    bool m_supported;
+    double m_period; // nanoseconds per tick
+    uint64_t m_mask; // timestampValidBits
+
+    uint32_t m_frameCount;
+    const char* const* m_zoneNames;
+    uint32_t m_zoneCount;
+    uint64_t* m_submitTimes; // per frame, 0 until the frame has been submitted with timestamps
+};
+
+#endif /* GPU_PROFILER_H */
@@ -0,0 +1,299 @@
+#include "MemoryAllocator.h"
+
+#include <assert.h>
+
+#include "Utilities/Defines.h"
+
+#define DEFAULT_BLOCK_SIZE (64ull * 1024 * 1024)
+
+void MemoryAllocator::init(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+    m_device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    m_atomSize = deviceProperties.limits.nonCoherentAtomSize;
+    // With a granularity of 1 buffers and optimal images can sit next to each other
+    m_granularityConflicts = deviceProperties.limits.bufferImageGranularity > 1;
+
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i)
+    {
+        // Small heaps (e.g. 256MiB host visible device local) get smaller blocks
+        VkDeviceSize heapSize = m_memoryProperties.memoryHeaps[m_memoryProperties.memoryTypes[i].heapIndex].size;
+        m_blockSize[i] = heapSize / 8 < DEFAULT_BLOCK_SIZE ? ALIGN(heapSize / 8, 1024) : DEFAULT_BLOCK_SIZE;
+    }
+
+    for (uint32_t i = 0; i < sizeof(m_pools) / sizeof(Pool); ++i)
+    {
+        m_pools[i].memoryType = i / (ALLOCATION_KIND_COUNT * ALLOCATION_STRATEGY_COUNT);
+        m_pools[i].strategy = static_cast<AllocationStrategy>(i % ALLOCATION_STRATEGY_COUNT);
+    }
+    m_dedicatedCount = 0;
+    m_dedicatedBytes = 0;
+}
+
+void MemoryAllocator::cleanup()
+{
+    for (uint32_t i = 0; i < sizeof(m_pools) / sizeof(Pool); ++i)
+    {
+        for (Block& block : m_pools[i].blocks)
+        {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            assert( block.allocations == 0 && "Leaked device memory allocation" );
+            vkFreeMemory(m_device, block.memory, nullptr);
+        }
+        m_pools[i].blocks.clear();
+    }
+    assert( m_dedicatedCount == 0 && "Leaked dedicated device memory allocation" );
+}
+
+Allocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                     AllocationKind kind, AllocationStrategy strategy)
+{
+    uint32_t memoryType = UINT32_MAX;
+    for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; ++i)
+    {
+        if ((requirements.memoryTypeBits & (1 << i)) &&
+            (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            memoryType = i;
+            break;
+        }
+    }
+    assert( memoryType != UINT32_MAX && "Failed to find suitable memory type" );
+    if (!m_granularityConflicts) kind = ALLOCATION_LINEAR;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    Allocation allocation = {};
+    allocation.size = requirements.size;
+    allocation.pool = (memoryType * ALLOCATION_KIND_COUNT + kind) * ALLOCATION_STRATEGY_COUNT + strategy;
+
+    // Anything bigger than half a block would mostly waste the rest of it
+    if (requirements.size > m_blockSize[memoryType] / 2)
+    {
+        char* mapped;
+        allocation.memory = allocateMemory(memoryType, requirements.size, &mapped);
+        allocation.offset = 0;
+        allocation.mapped = mapped;
+        allocation.block = DEDICATED_BLOCK;
+        m_dedicatedCount++;
+        m_dedicatedBytes += requirements.size;
+        return allocation;
+    }
+
+    Pool& pool = m_pools[allocation.pool];
+    uint32_t freeSlot = UINT32_MAX;
+    for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+    {
+        Block& block = pool.blocks[i];
+        if (block.memory == VK_NULL_HANDLE)
+        {
+            freeSlot = i;
+            continue;
+        }
+        if (allocateFromBlock(block, strategy, requirements.size, requirements.alignment, allocation.offset))
+        {
+            allocation.memory = block.memory;
+            allocation.mapped = block.mapped ? block.mapped + allocation.offset : nullptr;
+            allocation.block = i;
+            return allocation;
+        }
+    }
+
+    // No room, open a new block
+    if (freeSlot == UINT32_MAX)
+    {
+        freeSlot = static_cast<uint32_t>(pool.blocks.size());
+        pool.blocks.push_back(Block());
+    }
+    Block& block = pool.blocks[freeSlot];
+    block.size = m_blockSize[memoryType];
+    block.memory = allocateMemory(memoryType, block.size, &block.mapped);
+    block.used = 0;
+    block.allocations = 0;
+    block.head = 0;
+    block.free.clear();
+    block.free.push_back({ 0, block.size });
+
+    bool success = allocateFromBlock(block, strategy, requirements.size, requirements.alignment, allocation.offset);
+    assert( success );
+    allocation.memory = block.memory;
+    allocation.mapped = block.mapped ? block.mapped + allocation.offset : nullptr;
+    allocation.block = freeSlot;
+    return allocation;
+}
+
+void MemoryAllocator::free(Allocation& allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (allocation.block == DEDICATED_BLOCK)
+    {
+        vkFreeMemory(m_device, allocation.memory, nullptr);
+        m_dedicatedCount--;
+        m_dedicatedBytes -= allocation.size;
+    }
+    else
+    {
+        Pool& pool = m_pools[allocation.pool];
+        Block& block = pool.blocks[allocation.block];
+        assert( block.memory == allocation.memory );
+        freeToBlock(block, pool.strategy, allocation.offset, allocation.size);
+
+        // Keep one empty block around per pool so load/unload cycles don't thrash vkAllocateMemory
+        if (block.allocations == 0)
+        {
+            for (uint32_t i = 0; i < pool.blocks.size(); ++i)
+            {
+                if (i != allocation.block && pool.blocks[i].memory != VK_NULL_HANDLE && pool.blocks[i].allocations == 0)
+                {
+                    vkFreeMemory(m_device, block.memory, nullptr);
+                    block.memory = VK_NULL_HANDLE;
+                    block.mapped = nullptr;
+                    break;
+                }
+            }
+        }
+    }
+    allocation = {};
+}
+
+void MemoryAllocator::flush(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    uint32_t memoryType = allocation.pool / (ALLOCATION_KIND_COUNT * ALLOCATION_STRATEGY_COUNT);
+    if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) return;
+    if (size == 0) return;
+
+    // Flushed ranges have to be nonCoherentAtomSize aligned within the VkDeviceMemory
+    VkDeviceSize begin = ALIGN_DOWN(allocation.offset + offset, m_atomSize);
+    VkDeviceSize end = ALIGN(allocation.offset + offset + size, m_atomSize);
+    VkDeviceSize memorySize = allocation.block == DEDICATED_BLOCK ? allocation.size : m_pools[allocation.pool].blocks[allocation.block].size;
+
+    VkMappedMemoryRange range = {};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = begin;
+    range.size = end > memorySize ? VK_WHOLE_SIZE : end - begin;
+    assert( vkFlushMappedMemoryRanges(m_device, 1, &range) == VK_SUCCESS );
+}
+
+AllocatorStats MemoryAllocator::stats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    AllocatorStats stats = {};
+    stats.dedicatedCount = m_dedicatedCount;
+    stats.allocationCount = m_dedicatedCount;
+    stats.blockBytes = m_dedicatedBytes;
+    stats.usedBytes = m_dedicatedBytes;
+    for (uint32_t i = 0; i < sizeof(m_pools) / sizeof(Pool); ++i)
+    {
+        for (const Block& block : m_pools[i].blocks)
+        {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            stats.blockCount++;
+            stats.allocationCount += block.allocations;
+            stats.blockBytes += block.size;
+            stats.usedBytes += block.used;
+        }
+    }
+    return stats;
+}
+
+bool MemoryAllocator::allocateFromBlock(Block& block, AllocationStrategy strategy, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+    if (strategy == ALLOCATION_STACK)
+    {
+        VkDeviceSize aligned = ALIGN(block.head, alignment);
+        if (aligned + size > block.size) return false;
+        offset = aligned;
+        block.head = aligned + size;
+    }
+    else
+    {
+        // First fit, alignment padding stays in the free list
+        uint32_t i = 0;
+        for (; i < block.free.size(); ++i)
+        {
+            FreeRange& range = block.free[i];
+            VkDeviceSize aligned = ALIGN(range.offset, alignment);
+            VkDeviceSize padding = aligned - range.offset;
+            if (padding + size > range.size) continue;
+
+            VkDeviceSize tail = range.size - padding - size;
+            if (padding == 0 && tail == 0)
+            {
+                block.free.erase(block.free.begin() + i);
+            }
+            else if (padding == 0)
+            {
+                range.offset += size;
+                range.size = tail;
+            }
+            else
+            {
+                range.size = padding;
+                if (tail > 0) block.free.insert(block.free.begin() + i + 1, { aligned + size, tail });
+            }
+            offset = aligned;
+            break;
+        }
+        if (i == block.free.size()) return false;
+    }
+    block.used += size;
+    block.allocations++;
+    return true;
+}
+
+void MemoryAllocator::freeToBlock(Block& block, AllocationStrategy strategy, VkDeviceSize offset, VkDeviceSize size)
+{
+    block.used -= size;
+    block.allocations--;
+
+    if (strategy == ALLOCATION_STACK)
+    {
+        // Only rewinds fully once everything is gone, or partially if the top is freed first
+        if (block.allocations == 0) block.head = 0;
+        else if (offset + size == block.head) block.head = offset;
+        return;
+    }
+
+    // Insert sorted and coalesce with both neighbours
+    uint32_t i = 0;
+    while (i < block.free.size() && block.free[i].offset < offset) ++i;
+    block.free.insert(block.free.begin() + i, { offset, size });
+    if (i + 1 < block.free.size() && block.free[i].offset + block.free[i].size == block.free[i + 1].offset)
+    {
+        block.free[i].size += block.free[i + 1].size;
+        block.free.erase(block.free.begin() + i + 1);
+    }
+    if (i > 0 && block.free[i - 1].offset + block.free[i - 1].size == block.free[i].offset)
+    {
+        block.free[i - 1].size += block.free[i].size;
+        block.free.erase(block.free.begin() + i);
+    }
+}
+
+VkDeviceMemory MemoryAllocator::allocateMemory(uint32_t memoryType, VkDeviceSize size, char** mapped)
+{
+    VkMemoryAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+    VkDeviceMemory memory;
+    assert( vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) == VK_SUCCESS );
+
+    // Host visible memory stays mapped for its whole lifetime
+    *mapped = nullptr;
+    if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+    {
+        void* data;
+        assert( vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, &data) == VK_SUCCESS );
+        *mapped = static_cast<char*>(data);
+    }
+    return memory;
+}
@@ -0,0 +1,102 @@
+#ifndef MEMORY_ALLOCATOR_H
+#define MEMORY_ALLOCATOR_H
+
+#include <vulkan/vulkan.h> // TODO: forward declare
+#include <mutex>
+#include <vector>
+
+enum AllocationKind
+{
+    ALLOCATION_LINEAR,  // buffers + linear tiled images
+    ALLOCATION_OPTIMAL, // optimal tiled images
+    ALLOCATION_KIND_COUNT
+};
+
+enum AllocationStrategy
+{
+    ALLOCATION_FREE_LIST, // long lived, first fit + coalescing
+    ALLOCATION_STACK,     // transient (staging), bump allocated, block rewinds once empty
+    ALLOCATION_STRATEGY_COUNT
+};
+
+struct Allocation
+{
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    void* mapped; // nullptr unless host visible
+    uint32_t pool;
+    uint32_t block; // DEDICATED_BLOCK for resources that got their own vkAllocateMemory
+};
+
+struct AllocatorStats
+{
+    uint32_t blockCount;
+    uint32_t dedicatedCount;
+    uint32_t allocationCount;
+    VkDeviceSize blockBytes; // reserved from the device
+    VkDeviceSize usedBytes;  // handed out to resources
+};
+
+// Sub-allocates VkDeviceMemory blocks per memory type so resources don't each cost a vkAllocateMemory
+// (maxMemoryAllocationCount can be as low as 4096). Linear and optimal resources never share a block,
+// which keeps them bufferImageGranularity apart without tracking neighbours.
+class MemoryAllocator
+{
+public:
+    static const uint32_t DEDICATED_BLOCK = UINT32_MAX;
+
+    void init(VkDevice device, VkPhysicalDevice physicalDevice);
+    void cleanup();
+
+    Allocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                        AllocationKind kind, AllocationStrategy strategy = ALLOCATION_FREE_LIST);
+    void free(Allocation& allocation);
+
+    // No-op for host coherent memory, offset/size are relative to the allocation
+    void flush(const Allocation& allocation, VkDeviceSize offset, VkDeviceSize size);
+
+    AllocatorStats stats();
+
+private:
+    struct FreeRange
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct Block
+    {
+        VkDeviceMemory memory;
+        VkDeviceSize size;
+        VkDeviceSize used;
+        char* mapped;
+        uint32_t allocations;
+        VkDeviceSize head;            // ALLOCATION_STACK
+        std::vector<FreeRange> free;  // ALLOCATION_FREE_LIST, sorted by offset
+    };
+
+    struct Pool
+    {
+        uint32_t memoryType;
+        AllocationStrategy strategy;
+        std::vector<Block> blocks;
+    };
+
+    bool allocateFromBlock(Block& block, AllocationStrategy strategy, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+    void freeToBlock(Block& block, AllocationStrategy strategy, VkDeviceSize offset, VkDeviceSize size);
+    VkDeviceMemory allocateMemory(uint32_t memoryType, VkDeviceSize size, char** mapped);
+
+    VkDevice m_device;
+    VkPhysicalDeviceMemoryProperties m_memoryProperties;
+    VkDeviceSize m_blockSize[VK_MAX_MEMORY_TYPES];
+    VkDeviceSize m_atomSize;
+    bool m_granularityConflicts;
+
+    Pool m_pools[VK_MAX_MEMORY_TYPES * ALLOCATION_KIND_COUNT * ALLOCATION_STRATEGY_COUNT];
+    uint32_t m_dedicatedCount;
+    VkDeviceSize m_dedicatedBytes;
+    std::mutex m_mutex;
+};
+
+#endif /* MEMORY_ALLOCATOR_H */
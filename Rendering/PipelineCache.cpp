@@ -0,0 +1,93 @@
+#include "PipelineCache.h"
+
+#include <assert.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "Utilities/Profiler.h"
+
+#define PIPELINE_CACHE_HEADER_SIZE (16 + VK_UUID_SIZE) // size, version, vendor, device, UUID
+
+void PipelineCache::init(VkDevice device, VkPhysicalDevice physicalDevice, const char* path)
+{
+    PROFILE_ZONE("PipelineCache::init");
+    m_device = device;
+    m_path = path;
+    m_warm = false;
+    vkGetPhysicalDeviceProperties(physicalDevice, &m_properties);
+
+    uint8_t* data = nullptr;
+    size_t size = 0;
+    FILE* file = fopen(m_path, "rb");
+    if (file)
+    {
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if (length > 0)
+        {
+            data = new uint8_t[length];
+            size = fread(data, 1, length, file);
+        }
+        fclose(file);
+        m_warm = isCompatible(data, size);
+        if (!m_warm) std::cerr << "Pipeline cache is from another device or driver, rebuilding: " << m_path << std::endl;
+    }
+
+    VkPipelineCacheCreateInfo cacheCreateInfo = {};
+    cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheCreateInfo.initialDataSize = m_warm ? size : 0;
+    cacheCreateInfo.pInitialData = m_warm ? data : nullptr;
+    assert( vkCreatePipelineCache(m_device, &cacheCreateInfo, nullptr, &m_cache) == VK_SUCCESS );
+    delete[] data;
+}
+
+void PipelineCache::cleanup()
+{
+    write();
+    vkDestroyPipelineCache(m_device, m_cache, nullptr);
+}
+
+VkPipelineCache PipelineCache::get() const
+{
+    return m_cache;
+}
+
+bool PipelineCache::isWarm() const
+{
+    return m_warm;
+}
+
+// Drivers are meant to reject foreign data themselves, not all of them do
+bool PipelineCache::isCompatible(const uint8_t* data, size_t size) const
+{
+    if (size < PIPELINE_CACHE_HEADER_SIZE) return false;
+    uint32_t header[4]; // native endianness, like the driver wrote it
+    memcpy(header, data, sizeof(header));
+    return header[0] >= PIPELINE_CACHE_HEADER_SIZE && header[0] <= size &&
+           header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+           header[2] == m_properties.vendorID &&
+           header[3] == m_properties.deviceID &&
+           memcmp(data + 16, m_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+// To a temporary file first so a crash mid write can't leave a truncated cache behind
+bool PipelineCache::write() const
+{
+    PROFILE_ZONE("PipelineCache::write");
+    size_t size = 0;
+    assert( vkGetPipelineCacheData(m_device, m_cache, &size, nullptr) == VK_SUCCESS );
+    uint8_t* data = new uint8_t[size];
+    assert( vkGetPipelineCacheData(m_device, m_cache, &size, data) == VK_SUCCESS );
+
+    char tmpPath[512];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", m_path);
+    FILE* file = fopen(tmpPath, "wb");
+    bool written = file && fwrite(data, 1, size, file) == size;
+    if (file) written = fclose(file) == 0 && written;
+    delete[] data;
+    if (written) written = rename(tmpPath, m_path) == 0;
+    if (!written) std::cerr << "Failed to write pipeline cache: " << m_path << std::endl;
+    return written;
+}
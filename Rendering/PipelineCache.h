@@ -0,0 +1,30 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <vulkan/vulkan.h> // TODO: forward declare
+#include <stdint.h>
+
+// VkPipelineCache persisted between runs. The file is only used if its header matches this
+// device (vendor, device and pipeline cache UUID, which changes with the driver), otherwise
+// the cache starts empty. Written back on cleanup, after every pipeline has been created.
+class PipelineCache
+{
+public:
+    void init(VkDevice device, VkPhysicalDevice physicalDevice, const char* path);
+    void cleanup(); // writes the file, the device has to still be alive
+
+    VkPipelineCache get() const;
+    bool isWarm() const; // loaded from disk
+
+private:
+    VkDevice m_device;
+    VkPipelineCache m_cache;
+    VkPhysicalDeviceProperties m_properties;
+    const char* m_path;
+    bool m_warm;
+
+    bool isCompatible(const uint8_t* data, size_t size) const;
+    bool write() const;
+};
+
+#endif /* PIPELINE_CACHE_H */
@@ -0,0 +1,379 @@
+#include "PipelineRegistry.h"
+
+#include <assert.h>
+#include <cstring>
+#include <thread>
+
+#include "VulkanUtilities.h"
+#include "Utilities/Archive.h"
+#include "Utilities/Hash.h"
+#include "Utilities/JobSystem.h"
+#include "Utilities/Profiler.h"
+
+/// PipelineDesc, field by field so padding and string addresses don't matter
+template<typename T>
+static uint64_t hashValue(uint64_t hash, const T& value)
+{
+    return hashData(&value, sizeof(T), hash);
+}
+
+static uint64_t hashDesc(const PipelineDesc& desc)
+{
+    uint64_t hash = hashString(desc.vertexShader);
+    hash = hashString(desc.fragmentShader, hash);
+    hash = hashValue(hash, desc.constantCount);
+    hash = hashData(desc.constants, desc.constantCount * sizeof(uint32_t), hash);
+    hash = hashValue(hash, desc.vertexStride);
+    hash = hashValue(hash, desc.attributeCount);
+    for (uint32_t i = 0; i < desc.attributeCount; ++i)
+    {
+        hash = hashValue(hash, desc.attributes[i].location);
+        hash = hashValue(hash, desc.attributes[i].format);
+        hash = hashValue(hash, desc.attributes[i].offset);
+    }
+    hash = hashValue(hash, desc.polygonMode);
+    hash = hashValue(hash, desc.cullMode);
+    hash = hashValue(hash, desc.frontFace);
+    hash = hashValue(hash, desc.depthTest);
+    hash = hashValue(hash, desc.alphaBlend);
+    hash = hashValue(hash, desc.extent.width);
+    hash = hashValue(hash, desc.extent.height);
+    hash = hashValue(hash, desc.layout);
+    hash = hashValue(hash, desc.renderPass);
+    hash = hashValue(hash, desc.subpass);
+    return hash;
+}
+
+static bool sameString(const char* lhs, const char* rhs)
+{
+    return lhs == rhs || (lhs && rhs && strcmp(lhs, rhs) == 0);
+}
+
+static bool sameDesc(const PipelineDesc& lhs, const PipelineDesc& rhs)
+{
+    if (!sameString(lhs.vertexShader, rhs.vertexShader) || !sameString(lhs.fragmentShader, rhs.fragmentShader)) return false;
+    if (lhs.constantCount != rhs.constantCount || memcmp(lhs.constants, rhs.constants, lhs.constantCount * sizeof(uint32_t)) != 0) return false;
+    if (lhs.vertexStride != rhs.vertexStride || lhs.attributeCount != rhs.attributeCount) return false;
+    for (uint32_t i = 0; i < lhs.attributeCount; ++i)
+    {
+        if (lhs.attributes[i].location != rhs.attributes[i].location ||
+            lhs.attributes[i].format != rhs.attributes[i].format ||
+            lhs.attributes[i].offset != rhs.attributes[i].offset) return false;
+    }
+    return lhs.polygonMode == rhs.polygonMode && lhs.cullMode == rhs.cullMode && lhs.frontFace == rhs.frontFace &&
+           lhs.depthTest == rhs.depthTest && lhs.alphaBlend == rhs.alphaBlend &&
+           lhs.extent.width == rhs.extent.width && lhs.extent.height == rhs.extent.height &&
+           lhs.layout == rhs.layout && lhs.renderPass == rhs.renderPass && lhs.subpass == rhs.subpass;
+}
+
+/// PipelineRegistry
+void PipelineRegistry::init(VkDevice device, VkPipelineCache cache, JobSystem& jobs, const Archive& archive, uint32_t framesInFlight)
+{
+    m_device = device;
+    m_cache = cache;
+    m_jobs = &jobs;
+    m_archive = &archive;
+    m_framesInFlight = framesInFlight;
+    m_variants = new Variant[MAX_PIPELINE_VARIANTS];
+    m_created = new JobCounter[MAX_PIPELINE_VARIANTS];
+    m_count = 0;
+}
+
+void PipelineRegistry::cleanup()
+{
+    clear();
+    delete[] m_created;
+    delete[] m_variants;
+    m_retired = std::vector<Retired>();
+}
+
+void PipelineRegistry::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t count = m_count.load(std::memory_order_relaxed);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (m_variants[i].state.load(std::memory_order_acquire) == VARIANT_LAZY) continue;
+        m_jobs->wait(m_created[i]); // rebuilds too
+        vkDestroyPipeline(m_device, m_variants[i].pipeline, nullptr);
+        if (m_variants[i].rebuild.load(std::memory_order_acquire) == REBUILD_READY) vkDestroyPipeline(m_device, m_variants[i].rebuilt, nullptr);
+    }
+    for (const Retired& retired : m_retired)
+    {
+        vkDestroyPipeline(m_device, retired.pipeline, nullptr);
+    }
+    m_retired.clear();
+    m_count.store(0, std::memory_order_relaxed);
+}
+
+PipelineId PipelineRegistry::request(const PipelineDesc& desc, bool lazy)
+{
+    assert( desc.constantCount <= PIPELINE_MAX_CONSTANTS && desc.attributeCount <= PIPELINE_MAX_ATTRIBUTES );
+    uint64_t hash = hashDesc(desc);
+    PipelineId id;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint32_t count = m_count.load(std::memory_order_relaxed);
+        for (id = 0; id < count; ++id)
+        {
+            if (m_variants[id].hash == hash && sameDesc(m_variants[id].desc, desc)) break;
+        }
+        if (id < count && (lazy || m_variants[id].state.load(std::memory_order_acquire) != VARIANT_LAZY)) return id;
+
+        if (id == count)
+        {
+            assert( count < MAX_PIPELINE_VARIANTS );
+            Variant& variant = m_variants[id];
+            variant.desc = desc;
+            variant.hash = hash;
+            variant.pipeline = VK_NULL_HANDLE;
+            variant.state.store(VARIANT_LAZY, std::memory_order_relaxed);
+            variant.rebuilt = VK_NULL_HANDLE;
+            variant.rebuild.store(REBUILD_NONE, std::memory_order_relaxed);
+            variant.stale = false;
+            m_count.store(count + 1, std::memory_order_release);
+        }
+    }
+    // New, or lazy until now and wanted up front this time
+    if (!lazy) submit(id);
+    return id;
+}
+
+VkPipeline PipelineRegistry::get(PipelineId id)
+{
+    assert( id < m_count.load(std::memory_order_acquire) );
+    Variant& variant = m_variants[id];
+    if (variant.state.load(std::memory_order_acquire) != VARIANT_READY)
+    {
+        PROFILE_ZONE("Wait for pipeline");
+        submit(id);
+        // Whoever queued it may not have submitted yet, the counter only counts once it has
+        while (variant.state.load(std::memory_order_acquire) != VARIANT_READY)
+        {
+            m_jobs->wait(m_created[id]);
+            std::this_thread::yield();
+        }
+    }
+    return variant.pipeline;
+}
+
+void PipelineRegistry::wait()
+{
+    uint32_t count = m_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        m_jobs->wait(m_created[i]);
+    }
+}
+
+void PipelineRegistry::reload(const char* shaderPath)
+{
+    uint32_t count = m_count.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        Variant& variant = m_variants[i];
+        if (variant.state.load(std::memory_order_acquire) == VARIANT_LAZY) continue; // reads the new one when it's built
+        if (sameString(variant.desc.vertexShader, shaderPath) || sameString(variant.desc.fragmentShader, shaderPath)) variant.stale = true;
+    }
+}
+
+void PipelineRegistry::swap()
+{
+    for (size_t i = 0; i < m_retired.size();)
+    {
+        if (--m_retired[i].frames > 0)
+        {
+            ++i;
+            continue;
+        }
+        vkDestroyPipeline(m_device, m_retired[i].pipeline, nullptr);
+        m_retired[i] = m_retired.back();
+        m_retired.pop_back();
+    }
+
+    uint32_t count = m_count.load(std::memory_order_acquire);
+    for (PipelineId id = 0; id < count; ++id)
+    {
+        Variant& variant = m_variants[id];
+        if (variant.rebuild.load(std::memory_order_acquire) == REBUILD_READY)
+        {
+            m_retired.push_back({ variant.pipeline, m_framesInFlight });
+            variant.pipeline = variant.rebuilt;
+            variant.rebuild.store(REBUILD_NONE, std::memory_order_relaxed);
+        }
+        // One rebuild at a time, a change during one gets another after it
+        if (!variant.stale || variant.state.load(std::memory_order_acquire) != VARIANT_READY ||
+            variant.rebuild.load(std::memory_order_relaxed) != REBUILD_NONE) continue;
+        variant.stale = false;
+        variant.rebuild.store(REBUILD_RUNNING, std::memory_order_relaxed);
+        m_jobs->submit([this, id]()
+        {
+            Variant& variant = m_variants[id];
+            variant.rebuilt = create(variant.desc);
+            variant.rebuild.store(REBUILD_READY, std::memory_order_release);
+        }, &m_created[id], JOB_PRIORITY_LOW); // frames keep the old one meanwhile
+    }
+}
+
+uint32_t PipelineRegistry::count() const
+{
+    return m_count.load(std::memory_order_acquire);
+}
+
+// Only the first caller for a lazy variant queues it
+void PipelineRegistry::submit(PipelineId id)
+{
+    uint32_t expected = VARIANT_LAZY;
+    if (!m_variants[id].state.compare_exchange_strong(expected, VARIANT_QUEUED, std::memory_order_acq_rel)) return;
+    m_jobs->submit([this, id]()
+    {
+        Variant& variant = m_variants[id];
+        variant.pipeline = create(variant.desc);
+        variant.state.store(VARIANT_READY, std::memory_order_release);
+    }, &m_created[id]);
+}
+
+// On a worker, the cache is internally synchronized
+VkPipeline PipelineRegistry::create(const PipelineDesc& desc)
+{
+    PROFILE_ZONE("Create pipeline");
+
+    // Shaders
+    VkShaderModule vert = loadShader(desc.vertexShader);
+    VkShaderModule frag = loadShader(desc.fragmentShader);
+
+    // Constant i is constant_id i, ids a stage doesn't declare are ignored
+    VkSpecializationMapEntry mapEntries[PIPELINE_MAX_CONSTANTS];
+    for (uint32_t i = 0; i < desc.constantCount; ++i)
+    {
+        mapEntries[i].constantID = i;
+        mapEntries[i].offset = i * sizeof(uint32_t);
+        mapEntries[i].size = sizeof(uint32_t);
+    }
+    VkSpecializationInfo specializationInfo = {};
+    specializationInfo.mapEntryCount = desc.constantCount;
+    specializationInfo.pMapEntries = mapEntries;
+    specializationInfo.dataSize = desc.constantCount * sizeof(uint32_t);
+    specializationInfo.pData = desc.constants;
+
+    VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vert;
+    shaderStages[0].pName = "main";
+    shaderStages[0].pSpecializationInfo = desc.constantCount > 0 ? &specializationInfo : nullptr;
+    shaderStages[1] = shaderStages[0];
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = frag;
+
+    // Vertex Input
+    VkVertexInputBindingDescription bindingDesc = {};
+    bindingDesc.binding = 0;
+    bindingDesc.stride = desc.vertexStride;
+    bindingDesc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+    VkPipelineVertexInputStateCreateInfo vertInputCreateInfo = {};
+    vertInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertInputCreateInfo.vertexBindingDescriptionCount = desc.vertexStride > 0 ? 1 : 0;
+    vertInputCreateInfo.pVertexBindingDescriptions = &bindingDesc;
+    vertInputCreateInfo.vertexAttributeDescriptionCount = desc.attributeCount;
+    vertInputCreateInfo.pVertexAttributeDescriptions = desc.attributes;
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
+    inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport + Scissor
+    VkViewport viewport = {};
+    viewport.width = desc.extent.width;
+    viewport.height = desc.extent.height;
+    viewport.minDepth = 0.0f;
+    viewport.maxDepth = 1.0f;
+
+    VkRect2D scissor = {};
+    scissor.extent = desc.extent;
+
+    VkPipelineViewportStateCreateInfo viewportCreateInfo = {};
+    viewportCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportCreateInfo.viewportCount = 1;
+    viewportCreateInfo.pViewports = &viewport;
+    viewportCreateInfo.scissorCount = 1;
+    viewportCreateInfo.pScissors = &scissor;
+
+    // Rasterizer
+    VkPipelineRasterizationStateCreateInfo rasterizerCreateInfo = {};
+    rasterizerCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizerCreateInfo.polygonMode = desc.polygonMode;
+    rasterizerCreateInfo.lineWidth = 1.0f; // > 1.0f requires wideLines
+    rasterizerCreateInfo.cullMode = desc.cullMode;
+    rasterizerCreateInfo.frontFace = desc.frontFace;
+
+    // Multisampling
+    VkPipelineMultisampleStateCreateInfo multisampleCreateInfo = {};
+    multisampleCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampleCreateInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+    multisampleCreateInfo.minSampleShading = 1.0f;
+
+    // Depth + Stencil, ignored by subpasses without a depth attachment
+    VkPipelineDepthStencilStateCreateInfo depthStencilCreateInfo = {};
+    depthStencilCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+    depthStencilCreateInfo.depthTestEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+    depthStencilCreateInfo.depthWriteEnable = desc.depthTest ? VK_TRUE : VK_FALSE;
+    depthStencilCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+    depthStencilCreateInfo.minDepthBounds = -1.0f;
+    depthStencilCreateInfo.maxDepthBounds = 1.0f;
+    depthStencilCreateInfo.stencilTestEnable = VK_FALSE; // TODO: Stencil
+
+    VkPipelineColorBlendAttachmentState blendAttachment = {};
+    blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+                                     VK_COLOR_COMPONENT_G_BIT |
+                                     VK_COLOR_COMPONENT_B_BIT |
+                                     VK_COLOR_COMPONENT_A_BIT;
+    blendAttachment.blendEnable = desc.alphaBlend ? VK_TRUE : VK_FALSE;
+    blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+    VkPipelineColorBlendStateCreateInfo blendCreateInfo = {};
+    blendCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    blendCreateInfo.logicOpEnable = VK_FALSE;
+    blendCreateInfo.logicOp = VK_LOGIC_OP_COPY;
+    blendCreateInfo.attachmentCount = 1;
+    blendCreateInfo.pAttachments = &blendAttachment;
+
+    // VkPipelineDynamicStateCreateInfo // TODO: dynamic state, the extent wouldn't need to be part of the desc
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = shaderStages;
+    pipelineCreateInfo.pVertexInputState = &vertInputCreateInfo;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+    pipelineCreateInfo.pViewportState = &viewportCreateInfo;
+    pipelineCreateInfo.pRasterizationState = &rasterizerCreateInfo;
+    pipelineCreateInfo.pMultisampleState = &multisampleCreateInfo;
+    pipelineCreateInfo.pDepthStencilState = &depthStencilCreateInfo;
+    pipelineCreateInfo.pColorBlendState = &blendCreateInfo;
+    pipelineCreateInfo.pDynamicState = nullptr;
+    pipelineCreateInfo.layout = desc.layout;
+    pipelineCreateInfo.renderPass = desc.renderPass;
+    pipelineCreateInfo.subpass = desc.subpass;
+    VkPipeline pipeline;
+    assert( vkCreateGraphicsPipelines(m_device, m_cache, 1, &pipelineCreateInfo, nullptr, &pipeline) == VK_SUCCESS );
+
+    vkDestroyShaderModule(m_device, vert, nullptr);
+    vkDestroyShaderModule(m_device, frag, nullptr);
+    return pipeline;
+}
+
+VkShaderModule PipelineRegistry::loadShader(const char* path) const
+{
+    size_t size;
+    uint32_t type;
+    const uint8_t* code = m_archive->find(path, size, type);
+    return code ? createShaderModule(m_device, code, size) : createShaderModule(m_device, path);
+}
@@ -0,0 +1,119 @@
+#ifndef PIPELINE_REGISTRY_H
+#define PIPELINE_REGISTRY_H
+
+#include <vulkan/vulkan.h> // TODO: forward declare
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#define PIPELINE_MAX_CONSTANTS 4
+#define PIPELINE_MAX_ATTRIBUTES 4
+#define MAX_PIPELINE_VARIANTS 64
+
+class JobSystem;
+class JobCounter;
+class Archive;
+
+typedef uint32_t PipelineId;
+
+// Everything a graphics pipeline variant is built from. Zero initialise it, the zeroes are
+// fill, no culling, counter clockwise, no depth test, no blending and no vertex buffer.
+struct PipelineDesc
+{
+    const char* vertexShader; // SPIR-V paths, kept by pointer (literals) and compared by content
+    const char* fragmentShader;
+    uint32_t constants[PIPELINE_MAX_CONSTANTS]; // specialization constant_id i, both stages (int, uint or VkBool32)
+    uint32_t constantCount;
+
+    uint32_t vertexStride; // binding 0, per vertex
+    VkVertexInputAttributeDescription attributes[PIPELINE_MAX_ATTRIBUTES];
+    uint32_t attributeCount;
+
+    VkPolygonMode polygonMode;
+    VkCullModeFlags cullMode;
+    VkFrontFace frontFace;
+    bool depthTest; // less, writes depth
+    bool alphaBlend;
+
+    VkExtent2D extent; // viewport and scissor are baked in
+    VkPipelineLayout layout;
+    VkRenderPass renderPass;
+    uint32_t subpass;
+};
+
+// Graphics pipelines keyed by a hash of their PipelineDesc. Identical requests share one variant.
+// Variants are created on the job system, all through the same VkPipelineCache, so everything
+// requested up front compiles in parallel. Lazy ones wait for the first get(). Variants live
+// until clear(), layouts and render passes belong to the caller.
+// reload() rebuilds the variants using a shader in the background, swap() puts them in between
+// frames, so ids stay valid and nothing waits on the compile.
+class PipelineRegistry
+{
+public:
+    // Shaders are looked up in the archive first, then on disk
+    void init(VkDevice device, VkPipelineCache cache, JobSystem& jobs, const Archive& archive, uint32_t framesInFlight);
+    void cleanup();
+    void clear(); // waits for and destroys every variant, ids are reused afterwards
+
+    // Any thread. lazy leaves creation to the first get()
+    PipelineId request(const PipelineDesc& desc, bool lazy = false);
+    // Helps the job system until the variant exists
+    VkPipeline get(PipelineId id);
+    void wait(); // everything requested so far, lazy variants excluded
+
+    // Render thread, the .spv changed on disk
+    void reload(const char* shaderPath);
+    // Render thread, once per frame after waiting on its fence. Rebuilt variants replace the old
+    // ones, which are destroyed once no frame in flight can still be using them
+    void swap();
+
+    uint32_t count() const;
+
+private:
+    enum VariantState
+    {
+        VARIANT_LAZY,
+        VARIANT_QUEUED,
+        VARIANT_READY
+    };
+    enum RebuildState
+    {
+        REBUILD_NONE,
+        REBUILD_RUNNING,
+        REBUILD_READY
+    };
+    struct Variant
+    {
+        PipelineDesc desc;
+        uint64_t hash;
+        VkPipeline pipeline;
+        std::atomic<uint32_t> state; // VariantState, READY publishes pipeline
+        VkPipeline rebuilt;
+        std::atomic<uint32_t> rebuild; // RebuildState, READY publishes rebuilt
+        bool stale; // a shader changed, rebuilt on the next swap(). Render thread only
+    };
+    struct Retired
+    {
+        VkPipeline pipeline;
+        uint32_t frames; // swaps left until it's destroyed
+    };
+
+    VkDevice m_device;
+    VkPipelineCache m_cache;
+    JobSystem* m_jobs;
+    const Archive* m_archive;
+
+    std::mutex m_mutex; // request()
+    Variant* m_variants; // MAX_PIPELINE_VARIANTS
+    JobCounter* m_created; // per variant
+    std::atomic<uint32_t> m_count;
+    uint32_t m_framesInFlight;
+    std::vector<Retired> m_retired;
+
+    void submit(PipelineId id);
+    VkPipeline create(const PipelineDesc& desc);
+    VkShaderModule loadShader(const char* path) const;
+};
+
+#endif /* PIPELINE_REGISTRY_H */
@@ -0,0 +1,58 @@
+#include "RingBuffer.h"
+
+#include <assert.h>
+
+#include "VulkanUtilities.h"
+#include "Utilities/Defines.h"
+
+void RingBuffer::create(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage)
+{
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    m_alignment = MAX(deviceProperties.limits.minUniformBufferOffsetAlignment, deviceProperties.limits.minStorageBufferOffsetAlignment);
+    m_frameSize = ALIGN(frameSize, m_alignment);
+
+    // Not asking for HOST_COHERENT, flush() covers the memory types that aren't
+    createBuffer(device, allocator,
+        m_frameSize * frameCount,
+        usage,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+        buffer, memory);
+
+    m_mapped = static_cast<char*>(memory.mapped);
+    m_frameBase = 0;
+    m_head = 0;
+}
+
+void RingBuffer::destroy(VkDevice device, MemoryAllocator& allocator)
+{
+    destroyBuffer(device, allocator, buffer, memory);
+}
+
+void RingBuffer::begin(uint32_t frame)
+{
+    m_frameBase = frameOffset(frame);
+    m_head = m_frameBase;
+}
+
+RingAllocation RingBuffer::allocate(VkDeviceSize size)
+{
+    VkDeviceSize offset = ALIGN(m_head, m_alignment);
+    assert( offset + size <= m_frameBase + m_frameSize && "Frame ring buffer region exhausted" );
+    m_head = offset + size;
+
+    RingAllocation allocation;
+    allocation.data = m_mapped + offset;
+    allocation.offset = static_cast<uint32_t>(offset);
+    return allocation;
+}
+
+void RingBuffer::flush(MemoryAllocator& allocator)
+{
+    allocator.flush(memory, m_frameBase, m_head - m_frameBase);
+}
+
+uint32_t RingBuffer::frameOffset(uint32_t frame) const
+{
+    return static_cast<uint32_t>(m_frameSize * frame);
+}
@@ -0,0 +1,37 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <vulkan/vulkan.h> // TODO: forward declare
+#include "MemoryAllocator.h"
+
+struct RingAllocation
+{
+    void* data;
+    uint32_t offset; // dynamic offset into RingBuffer::buffer
+};
+
+// Persistently mapped buffer split into one region per frame, bound with
+// VK_DESCRIPTOR_TYPE_*_BUFFER_DYNAMIC. A region is only rewritten once the frame using it has retired.
+struct RingBuffer
+{
+    VkBuffer buffer;
+    Allocation memory;
+
+    void create(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator& allocator, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage);
+    void destroy(VkDevice device, MemoryAllocator& allocator);
+
+    void begin(uint32_t frame);
+    RingAllocation allocate(VkDeviceSize size);
+    void flush(MemoryAllocator& allocator); // no-op on host coherent memory
+
+    uint32_t frameOffset(uint32_t frame) const;
+
+    private:
+    char* m_mapped;
+    VkDeviceSize m_frameSize;
+    VkDeviceSize m_alignment;
+    VkDeviceSize m_frameBase;
+    VkDeviceSize m_head;
+};
+
+#endif /* RING_BUFFER_H */
@@ -0,0 +1,183 @@
+#include "ShaderWatcher.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "Utilities/DerivedDataCache.h"
+#include "Utilities/JobSystem.h"
+#include "Utilities/Profiler.h"
+
+#define SHADER_POLL_INTERVAL 500000000ull // nanoseconds
+#define SHADER_DEFAULT_COMPILER "glslc"
+#define SHADER_BAKE_VERSION 1 // bump when the compile options change
+
+// Older than its source or missing
+static bool isStale(const char* path, time_t modified)
+{
+    char spvPath[SHADER_PATH_SIZE + 8];
+    snprintf(spvPath, sizeof(spvPath), "%s.spv", path);
+    struct stat info;
+    return stat(spvPath, &info) != 0 || info.st_mtime < modified;
+}
+
+static bool writeFile(const char* path, const void* data, size_t size)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    bool written = fwrite(data, 1, size, file) == size;
+    return fclose(file) == 0 && written;
+}
+
+static bool isShaderSource(const char* name)
+{
+    const char* extension = strrchr(name, '.');
+    return extension && (strcmp(extension, ".vert") == 0 || strcmp(extension, ".frag") == 0);
+}
+
+void ShaderWatcher::init(const char* directory, JobSystem& jobs, DerivedDataCache& cache)
+{
+    snprintf(m_directory, sizeof(m_directory), "%s", directory);
+    m_compiler = getenv("GLSLC");
+    if (!m_compiler) m_compiler = SHADER_DEFAULT_COMPILER;
+    m_jobs = &jobs;
+    m_cache = &cache;
+    m_polling = new JobCounter();
+    m_lastPoll = Profiler::now();
+    m_sources.clear();
+    m_compiled.clear();
+    poll(true);
+}
+
+void ShaderWatcher::cleanup()
+{
+    m_jobs->wait(*m_polling);
+    delete m_polling;
+    m_sources = std::vector<Source>();
+    m_compiled = std::vector<Source>();
+}
+
+void ShaderWatcher::update()
+{
+    uint64_t now = Profiler::now();
+    if (now - m_lastPoll < SHADER_POLL_INTERVAL || !m_polling->isDone()) return;
+    m_lastPoll = now;
+    m_jobs->submit([this]()
+    {
+        poll(false);
+    }, m_polling, JOB_PRIORITY_LOW);
+}
+
+bool ShaderWatcher::popCompiled(char* spvPath, size_t size)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_compiled.empty()) return false;
+    snprintf(spvPath, size, "%s", m_compiled.back().path);
+    m_compiled.pop_back();
+    return true;
+}
+
+// Sources are matched by path, new ones count as changed. The initial poll only compiles stale
+// .spv files, nothing has loaded them yet.
+void ShaderWatcher::poll(bool initial)
+{
+    PROFILE_ZONE("ShaderWatcher::poll");
+    std::vector<Source> sources;
+    scan(m_directory, sources);
+    for (Source& source : sources)
+    {
+        bool changed = !initial || isStale(source.path, source.modified);
+        for (const Source& known : m_sources)
+        {
+            if (strcmp(known.path, source.path) == 0)
+            {
+                changed = known.modified != source.modified || known.size != source.size;
+                break;
+            }
+        }
+        if (!changed || !compile(source.path) || initial) continue;
+
+        Source compiled = source;
+        snprintf(compiled.path, sizeof(compiled.path), "%s.spv", source.path);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_compiled.push_back(compiled);
+    }
+    m_sources.swap(sources); // failed compiles aren't retried until the source changes again
+}
+
+void ShaderWatcher::scan(const char* directory, std::vector<Source>& sources) const
+{
+    DIR* dir = opendir(directory);
+    if (!dir) return;
+    while (dirent* entry = readdir(dir))
+    {
+        if (entry->d_name[0] == '.') continue;
+        Source source;
+        snprintf(source.path, sizeof(source.path), "%s/%s", directory, entry->d_name);
+        struct stat info;
+        if (stat(source.path, &info) != 0) continue;
+        if (S_ISDIR(info.st_mode))
+        {
+            scan(source.path, sources);
+        }
+        else if (isShaderSource(entry->d_name))
+        {
+            source.modified = info.st_mtime;
+            source.size = info.st_size;
+            sources.push_back(source);
+        }
+    }
+    closedir(dir);
+}
+
+// Into a temporary file first, a half written .spv must never be picked up. Keyed on the
+// source's bytes, its extension (glslc's stage) and the compiler, #includes aren't followed
+// (none of the shaders use them).
+bool ShaderWatcher::compile(const char* path) const
+{
+    PROFILE_ZONE("Compile shader");
+    size_t sourceSize;
+    uint8_t* source = readFile(path, sourceSize);
+    if (!source) return false; // deleted since the scan
+    const char* stage = strrchr(path, '.');
+    char settings[SHADER_PATH_SIZE + 48];
+    snprintf(settings, sizeof(settings), "spirv %s %s v%d", stage ? stage + 1 : "", m_compiler, SHADER_BAKE_VERSION);
+    uint64_t key = DerivedDataCache::key(source, sourceSize, settings);
+    delete[] source;
+
+    char tmpPath[SHADER_PATH_SIZE + 8], spvPath[SHADER_PATH_SIZE + 8];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.spv.tmp", path);
+    snprintf(spvPath, sizeof(spvPath), "%s.spv", path);
+    size_t spirvSize;
+    uint8_t* spirv = m_cache->load(key, spirvSize);
+    bool cached = spirv != nullptr;
+    if (cached)
+    {
+        cached = writeFile(tmpPath, spirv, spirvSize);
+        delete[] spirv;
+    }
+    if (!cached)
+    {
+        char command[3 * SHADER_PATH_SIZE + 32];
+        snprintf(command, sizeof(command), "\"%s\" \"%s\" -o \"%s\"", m_compiler, path, tmpPath);
+        if (std::system(command) != 0)
+        {
+            std::cerr << "Shader failed to compile, keeping the previous one: " << path << std::endl;
+            return false;
+        }
+        spirv = readFile(tmpPath, spirvSize);
+        if (spirv) m_cache->store(key, spirv, spirvSize);
+        delete[] spirv;
+    }
+
+    if (rename(tmpPath, spvPath) != 0)
+    {
+        std::cerr << "Failed to replace " << spvPath << std::endl;
+        return false;
+    }
+    std::cout << (cached ? "Restored " : "Recompiled ") << path << std::endl;
+    return true;
+}
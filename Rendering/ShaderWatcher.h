@@ -0,0 +1,55 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+#include <mutex>
+#include <vector>
+
+#define SHADER_PATH_SIZE 256
+
+class JobSystem;
+class JobCounter;
+class DerivedDataCache;
+
+// Recompiles the GLSL under a directory (.vert, .frag) as it changes, to <source>.spv next to it
+// like Shaders/compile.sh. A low priority job stats the sources every SHADER_POLL_INTERVAL (no
+// inotify on macOS) and runs glslc ($GLSLC, otherwise from PATH) on the changed ones. A failed
+// compile prints glslc's errors and leaves the old .spv alone. SPIR-V goes through the derived
+// data cache, so reverting a change or starting with stale .spv files doesn't run glslc again.
+class ShaderWatcher
+{
+public:
+    void init(const char* directory, JobSystem& jobs, DerivedDataCache& cache); // compiles missing and stale .spv files
+    void cleanup(); // waits for a poll in progress
+    void update(); // once per frame
+
+    // Any thread, the next .spv rebuilt since the last call
+    bool popCompiled(char* spvPath, size_t size);
+
+private:
+    struct Source
+    {
+        char path[SHADER_PATH_SIZE];
+        time_t modified;
+        off_t size;
+    };
+
+    char m_directory[SHADER_PATH_SIZE];
+    const char* m_compiler;
+    JobSystem* m_jobs;
+    DerivedDataCache* m_cache;
+    JobCounter* m_polling;
+    uint64_t m_lastPoll; // Profiler::now()
+    std::vector<Source> m_sources; // only touched by the poll job
+
+    std::mutex m_mutex; // m_compiled
+    std::vector<Source> m_compiled; // .spv paths
+
+    void poll(bool initial);
+    void scan(const char* directory, std::vector<Source>& sources) const;
+    bool compile(const char* path) const;
+};
+
+#endif /* SHADER_WATCHER_H */
@@ -0,0 +1,177 @@
+#include "TextureRegistry.h"
+
+#include <assert.h>
+
+#include "VulkanUtilities.h"
+
+void TextureRegistry::init(VkDevice device, VkPhysicalDevice physicalDevice)
+{
+    m_device = device;
+
+    VkPhysicalDeviceDescriptorIndexingPropertiesEXT indexingProperties = {};
+    indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+    VkPhysicalDeviceProperties2 properties = {};
+    properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties.pNext = &indexingProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    m_capacity = MAX_BINDLESS_TEXTURES;
+    if (indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages < m_capacity)
+        m_capacity = indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages;
+    if (indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages < m_capacity)
+        m_capacity = indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages;
+
+    // Layout
+    VkDescriptorSetLayoutBinding textureLayoutBinding = {};
+    textureLayoutBinding.binding = 0;
+    textureLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    textureLayoutBinding.descriptorCount = m_capacity;
+    textureLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    textureLayoutBinding.pImmutableSamplers = nullptr;
+
+    // Unwritten slots are never sampled, writes can land while the set is bound/in flight
+    VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+                                               VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsCreateInfo = {};
+    bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+    bindingFlagsCreateInfo.bindingCount = 1;
+    bindingFlagsCreateInfo.pBindingFlags = &bindingFlags;
+
+    VkDescriptorSetLayoutCreateInfo layoutCreateInfo = {};
+    layoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutCreateInfo.pNext = &bindingFlagsCreateInfo;
+    layoutCreateInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+    layoutCreateInfo.bindingCount = 1;
+    layoutCreateInfo.pBindings = &textureLayoutBinding;
+    assert( vkCreateDescriptorSetLayout(m_device, &layoutCreateInfo, nullptr, &m_layout) == VK_SUCCESS );
+
+    // Pool + Set
+    VkDescriptorPoolSize imageDescPoolSize = {};
+    imageDescPoolSize.type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    imageDescPoolSize.descriptorCount = m_capacity;
+
+    VkDescriptorPoolCreateInfo descPoolCreateInfo = {};
+    descPoolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descPoolCreateInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+    descPoolCreateInfo.poolSizeCount = 1;
+    descPoolCreateInfo.pPoolSizes = &imageDescPoolSize;
+    descPoolCreateInfo.maxSets = 1;
+    assert( vkCreateDescriptorPool(m_device, &descPoolCreateInfo, nullptr, &m_pool) == VK_SUCCESS );
+
+    VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountAllocInfo = {};
+    variableCountAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+    variableCountAllocInfo.descriptorSetCount = 1;
+    variableCountAllocInfo.pDescriptorCounts = &m_capacity;
+
+    VkDescriptorSetAllocateInfo descSetAllocInfo = {};
+    descSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descSetAllocInfo.pNext = &variableCountAllocInfo;
+    descSetAllocInfo.descriptorPool = m_pool;
+    descSetAllocInfo.descriptorSetCount = 1;
+    descSetAllocInfo.pSetLayouts = &m_layout;
+    assert( vkAllocateDescriptorSets(m_device, &descSetAllocInfo, &m_set) == VK_SUCCESS );
+
+    m_highWater = 0;
+    m_count = 0;
+    m_frame = 0;
+}
+
+void TextureRegistry::cleanup()
+{
+    vkDestroyDescriptorPool(m_device, m_pool, nullptr);
+    vkDestroyDescriptorSetLayout(m_device, m_layout, nullptr);
+    m_freeSlots.clear();
+    m_retiredSlots.clear();
+}
+
+uint32_t TextureRegistry::add(VkImageView view)
+{
+    uint32_t slot;
+    if (!m_freeSlots.empty())
+    {
+        slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else
+    {
+        assert( m_highWater < m_capacity && "Out of texture slots" );
+        slot = m_highWater++;
+    }
+    m_count++;
+
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    imageInfo.imageView = view;
+    imageInfo.sampler = nullptr;
+
+    VkWriteDescriptorSet imageWriteDescSet = {};
+    imageWriteDescSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    imageWriteDescSet.dstSet = m_set;
+    imageWriteDescSet.dstBinding = 0;
+    imageWriteDescSet.dstArrayElement = slot;
+    imageWriteDescSet.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+    imageWriteDescSet.descriptorCount = 1;
+    imageWriteDescSet.pImageInfo = &imageInfo;
+    imageWriteDescSet.pNext = nullptr;
+    vkUpdateDescriptorSets(m_device, 1, &imageWriteDescSet, 0, nullptr);
+
+    return slot;
+}
+
+void TextureRegistry::remove(uint32_t slot)
+{
+    // The descriptor is left as is, partially bound only requires it to be valid while it's sampled
+    assert( slot < m_highWater );
+    m_retiredSlots.push_back({ slot, m_frame });
+    m_count--;
+}
+
+void TextureRegistry::update()
+{
+    m_frame++;
+    uint32_t retired = 0;
+    while (retired < m_retiredSlots.size() && isRetired(m_retiredSlots[retired].frame))
+    {
+        m_freeSlots.push_back(m_retiredSlots[retired].slot);
+        retired++;
+    }
+    m_retiredSlots.erase(m_retiredSlots.begin(), m_retiredSlots.begin() + retired);
+}
+
+uint64_t TextureRegistry::frame() const
+{
+    return m_frame;
+}
+
+bool TextureRegistry::isRetired(uint64_t frame) const
+{
+    // update() runs after the fence wait, so MAX_FRAMES_IN_FLIGHT updates later that frame has completed
+    return m_frame >= frame + MAX_FRAMES_IN_FLIGHT;
+}
+
+VkDescriptorSetLayout TextureRegistry::layout() const
+{
+    return m_layout;
+}
+
+VkDescriptorSet TextureRegistry::set() const
+{
+    return m_set;
+}
+
+uint32_t TextureRegistry::capacity() const
+{
+    return m_capacity;
+}
+
+uint32_t TextureRegistry::count() const
+{
+    return m_count;
+}
+
+bool TextureRegistry::isFull() const
+{
+    return m_freeSlots.empty() && m_highWater == m_capacity;
+}
@@ -0,0 +1,57 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <vulkan/vulkan.h> // TODO: forward declare
+#include <vector>
+
+#define MAX_BINDLESS_TEXTURES 4096
+#define TEXTURE_SET 1 // descriptor set index in the scene pipeline layout
+
+// Bindless texture table: a single update-after-bind descriptor set with a partially bound,
+// variable sized texture2D array that shaders index with the slot returned by add().
+// Adding or removing a texture is one descriptor write, the set stays bound and the command
+// buffers never need re-recording. Removed slots are only handed out again once every frame
+// that could still sample them has retired, so writes never touch a descriptor in use.
+// Render thread only.
+class TextureRegistry
+{
+public:
+    void init(VkDevice device, VkPhysicalDevice physicalDevice);
+    void cleanup();
+
+    uint32_t add(VkImageView view);
+    void remove(uint32_t slot);
+
+    // Once per frame, after waiting on the frame's fence
+    void update();
+    uint64_t frame() const;
+    // True once nothing submitted during frame can still be executing
+    bool isRetired(uint64_t frame) const;
+
+    VkDescriptorSetLayout layout() const;
+    VkDescriptorSet set() const;
+    uint32_t capacity() const;
+    uint32_t count() const;
+    bool isFull() const; // until removed slots retire, add() has to wait
+
+private:
+    struct RetiredSlot
+    {
+        uint32_t slot;
+        uint64_t frame;
+    };
+
+    VkDevice m_device;
+    VkDescriptorSetLayout m_layout;
+    VkDescriptorPool m_pool;
+    VkDescriptorSet m_set;
+
+    uint32_t m_capacity; // MAX_BINDLESS_TEXTURES clamped to the device limits
+    uint32_t m_highWater; // slots below this have been handed out at least once
+    uint32_t m_count;
+    std::vector<uint32_t> m_freeSlots;
+    std::vector<RetiredSlot> m_retiredSlots; // in frame order
+    uint64_t m_frame;
+};
+
+#endif /* TEXTURE_REGISTRY_H */
@@ -0,0 +1,372 @@
+#include "UploadQueue.h"
+
+#include <assert.h>
+#include <cstring>
+
+#include "VulkanUtilities.h"
+#include "Utilities/Defines.h"
+#include "Utilities/Profiler.h"
+
+#define STAGING_ALIGNMENT 16 // covers bufferOffset rules for every format we upload
+
+#define CONSUMER_STAGES (VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT)
+#define BUFFER_CONSUMER_ACCESS (VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT)
+
+void UploadQueue::init(VkDevice device, MemoryAllocator& allocator,
+                       uint32_t graphicsFamily, VkQueue graphicsQueue,
+                       uint32_t transferFamily, VkQueue transferQueue)
+{
+    m_device = device;
+    m_allocator = &allocator;
+    m_graphicsFamily = graphicsFamily;
+    m_transferFamily = transferFamily;
+    m_graphicsQueue = graphicsQueue;
+    m_transferQueue = transferQueue;
+    m_ownershipTransfer = transferFamily != graphicsFamily;
+
+    VkCommandPoolCreateInfo poolCreateInfo = {};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolCreateInfo.queueFamilyIndex = m_transferFamily;
+    assert( vkCreateCommandPool(m_device, &poolCreateInfo, nullptr, &m_transferPool) == VK_SUCCESS );
+    m_graphicsPool = VK_NULL_HANDLE;
+    if (m_ownershipTransfer)
+    {
+        poolCreateInfo.queueFamilyIndex = m_graphicsFamily;
+        assert( vkCreateCommandPool(m_device, &poolCreateInfo, nullptr, &m_graphicsPool) == VK_SUCCESS );
+    }
+
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+    semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VkFenceCreateInfo fenceCreateInfo = {};
+    fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+    for (int i = 0; i < UPLOAD_BATCH_COUNT; ++i)
+    {
+        Batch& batch = m_batches[i];
+        allocInfo.commandPool = m_transferPool;
+        assert( vkAllocateCommandBuffers(m_device, &allocInfo, &batch.transferCmd) == VK_SUCCESS );
+        batch.graphicsCmd = VK_NULL_HANDLE;
+        batch.transferDone = VK_NULL_HANDLE;
+        if (m_ownershipTransfer)
+        {
+            allocInfo.commandPool = m_graphicsPool;
+            assert( vkAllocateCommandBuffers(m_device, &allocInfo, &batch.graphicsCmd) == VK_SUCCESS );
+            assert( vkCreateSemaphore(m_device, &semaphoreCreateInfo, nullptr, &batch.transferDone) == VK_SUCCESS );
+        }
+        assert( vkCreateFence(m_device, &fenceCreateInfo, nullptr, &batch.fence) == VK_SUCCESS );
+        batch.ticket = 0;
+        batch.recording = false;
+        batch.submitted = false;
+
+        createBuffer(m_device, *m_allocator,
+            UPLOAD_STAGING_SIZE,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            batch.staging.buffer, batch.staging.memory);
+        batch.stagingHead = 0;
+    }
+    m_current = 0;
+    m_nextTicket = 1;
+    m_completedTicket = 0;
+}
+
+void UploadQueue::cleanup()
+{
+    wait(m_nextTicket - 1);
+    for (int i = 0; i < UPLOAD_BATCH_COUNT; ++i)
+    {
+        Batch& batch = m_batches[i];
+        destroyBuffer(m_device, *m_allocator, batch.staging.buffer, batch.staging.memory);
+        vkDestroyFence(m_device, batch.fence, nullptr);
+        if (batch.transferDone != VK_NULL_HANDLE) vkDestroySemaphore(m_device, batch.transferDone, nullptr);
+    }
+    vkDestroyCommandPool(m_device, m_transferPool, nullptr);
+    if (m_graphicsPool != VK_NULL_HANDLE) vkDestroyCommandPool(m_device, m_graphicsPool, nullptr);
+}
+
+UploadTicket UploadQueue::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    Batch& batch = openBatch(size);
+    VkBuffer src;
+    VkDeviceSize srcOffset;
+    stage(batch, data, size, src, srcOffset);
+
+    VkBufferCopy copy = {};
+    copy.srcOffset = srcOffset;
+    copy.dstOffset = dstOffset;
+    copy.size = size;
+    vkCmdCopyBuffer(batch.transferCmd, src, dst, 1, &copy);
+
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = BUFFER_CONSUMER_ACCESS;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = dst;
+    barrier.offset = dstOffset;
+    barrier.size = size;
+    batch.bufferBarriers.push_back(barrier);
+    return batch.ticket;
+}
+
+UploadTicket UploadQueue::uploadImage(VkImage dst, uint32_t width, uint32_t height, const void* data, VkDeviceSize size,
+                                      uint32_t mipLevels, const VkDeviceSize* mipOffsets)
+{
+    Batch& batch = openBatch(size);
+    VkBuffer src;
+    VkDeviceSize srcOffset;
+    stage(batch, data, size, src, srcOffset);
+
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = dst;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+
+    // Contents are discarded, so the first use needs no ownership acquire on the transfer queue
+    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(batch.transferCmd,
+        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+        0,
+        0, nullptr,
+        0, nullptr,
+        1, &barrier);
+
+    VkBufferImageCopy regions[UPLOAD_MAX_MIP_LEVELS] = {};
+    assert( mipLevels <= UPLOAD_MAX_MIP_LEVELS );
+    for (uint32_t i = 0; i < mipLevels; ++i)
+    {
+        VkBufferImageCopy& region = regions[i];
+        region.bufferOffset = srcOffset + (mipOffsets ? mipOffsets[i] : 0);
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = i;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { MAX(width >> i, 1u), MAX(height >> i, 1u), 1 };
+    }
+    vkCmdCopyBufferToImage(batch.transferCmd, src, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions);
+
+    // Transition to GPU read once the batch closes
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    batch.imageBarriers.push_back(barrier);
+    return batch.ticket;
+}
+
+UploadTicket UploadQueue::submit()
+{
+    Batch& batch = m_batches[m_current];
+    if (!batch.recording) return m_nextTicket - 1;
+    PROFILE_ZONE("UploadQueue::submit");
+
+    uint32_t bufferBarrierCount = static_cast<uint32_t>(batch.bufferBarriers.size());
+    uint32_t imageBarrierCount = static_cast<uint32_t>(batch.imageBarriers.size());
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+
+    if (m_ownershipTransfer)
+    {
+        // Release on the transfer queue, the access masks that matter live on the acquire side
+        for (VkBufferMemoryBarrier& barrier : batch.bufferBarriers)
+        {
+            barrier.srcQueueFamilyIndex = m_transferFamily;
+            barrier.dstQueueFamilyIndex = m_graphicsFamily;
+            barrier.dstAccessMask = 0;
+        }
+        for (VkImageMemoryBarrier& barrier : batch.imageBarriers)
+        {
+            barrier.srcQueueFamilyIndex = m_transferFamily;
+            barrier.dstQueueFamilyIndex = m_graphicsFamily;
+            barrier.dstAccessMask = 0;
+        }
+        vkCmdPipelineBarrier(batch.transferCmd,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0,
+            0, nullptr,
+            bufferBarrierCount, batch.bufferBarriers.data(),
+            imageBarrierCount, batch.imageBarriers.data());
+        assert( vkEndCommandBuffer(batch.transferCmd) == VK_SUCCESS );
+
+        submitInfo.pCommandBuffers = &batch.transferCmd;
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &batch.transferDone;
+        assert( vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE) == VK_SUCCESS );
+
+        // Acquire on the graphics queue, chained to the semaphore wait through the transfer stage
+        for (VkBufferMemoryBarrier& barrier : batch.bufferBarriers)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = BUFFER_CONSUMER_ACCESS;
+        }
+        for (VkImageMemoryBarrier& barrier : batch.imageBarriers)
+        {
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        }
+        vkCmdPipelineBarrier(batch.graphicsCmd,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, CONSUMER_STAGES,
+            0,
+            0, nullptr,
+            bufferBarrierCount, batch.bufferBarriers.data(),
+            imageBarrierCount, batch.imageBarriers.data());
+        assert( vkEndCommandBuffer(batch.graphicsCmd) == VK_SUCCESS );
+
+        submitInfo.pCommandBuffers = &batch.graphicsCmd;
+        submitInfo.signalSemaphoreCount = 0;
+        submitInfo.pSignalSemaphores = nullptr;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &batch.transferDone;
+        submitInfo.pWaitDstStageMask = &waitStage;
+    }
+    else
+    {
+        vkCmdPipelineBarrier(batch.transferCmd,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, CONSUMER_STAGES,
+            0,
+            0, nullptr,
+            bufferBarrierCount, batch.bufferBarriers.data(),
+            imageBarrierCount, batch.imageBarriers.data());
+        assert( vkEndCommandBuffer(batch.transferCmd) == VK_SUCCESS );
+        submitInfo.pCommandBuffers = &batch.transferCmd;
+    }
+    // Graphics queue either way, so later frame submissions are ordered after the uploads
+    assert( vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, batch.fence) == VK_SUCCESS );
+
+    batch.recording = false;
+    batch.submitted = true;
+    m_current = (m_current + 1) % UPLOAD_BATCH_COUNT;
+    return batch.ticket;
+}
+
+bool UploadQueue::isComplete(UploadTicket ticket)
+{
+    poll();
+    return ticket <= m_completedTicket;
+}
+
+void UploadQueue::wait(UploadTicket ticket)
+{
+    if (m_batches[m_current].recording && ticket >= m_batches[m_current].ticket) submit();
+    for (int i = 0; i < UPLOAD_BATCH_COUNT; ++i)
+    {
+        Batch& batch = m_batches[i];
+        if (batch.submitted && batch.ticket <= ticket)
+        {
+            vkWaitForFences(m_device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+            retire(batch);
+        }
+    }
+}
+
+void UploadQueue::update()
+{
+    submit();
+    poll();
+}
+
+UploadQueue::Batch& UploadQueue::openBatch(VkDeviceSize stagingSize)
+{
+    Batch& batch = m_batches[m_current];
+    if (batch.recording)
+    {
+        // Full, close it and move on to the next batch
+        if (stagingSize <= UPLOAD_STAGING_SIZE && ALIGN(batch.stagingHead, STAGING_ALIGNMENT) + stagingSize > UPLOAD_STAGING_SIZE)
+        {
+            submit();
+            return openBatch(stagingSize);
+        }
+        return batch;
+    }
+
+    // Batches are reused round robin, the oldest one may still be in flight
+    if (batch.submitted)
+    {
+        vkWaitForFences(m_device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        retire(batch);
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    assert( vkBeginCommandBuffer(batch.transferCmd, &beginInfo) == VK_SUCCESS );
+    if (m_ownershipTransfer)
+    {
+        assert( vkBeginCommandBuffer(batch.graphicsCmd, &beginInfo) == VK_SUCCESS );
+    }
+    batch.ticket = m_nextTicket++;
+    batch.recording = true;
+    batch.stagingHead = 0;
+    return batch;
+}
+
+void UploadQueue::stage(Batch& batch, const void* data, VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset)
+{
+    if (size > UPLOAD_STAGING_SIZE)
+    {
+        StagingBuffer staging;
+        createBuffer(m_device, *m_allocator,
+            size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            staging.buffer, staging.memory, ALLOCATION_STACK);
+        memcpy(staging.memory.mapped, data, size);
+        batch.oversized.push_back(staging);
+        buffer = staging.buffer;
+        offset = 0;
+        return;
+    }
+
+    offset = ALIGN(batch.stagingHead, STAGING_ALIGNMENT);
+    memcpy(static_cast<char*>(batch.staging.memory.mapped) + offset, data, size);
+    batch.stagingHead = offset + size;
+    buffer = batch.staging.buffer;
+}
+
+void UploadQueue::poll()
+{
+    for (int i = 0; i < UPLOAD_BATCH_COUNT; ++i)
+    {
+        Batch& batch = m_batches[i];
+        if (batch.submitted && vkGetFenceStatus(m_device, batch.fence) == VK_SUCCESS)
+        {
+            retire(batch);
+        }
+    }
+}
+
+void UploadQueue::retire(Batch& batch)
+{
+    vkResetFences(m_device, 1, &batch.fence);
+    for (StagingBuffer& staging : batch.oversized)
+    {
+        destroyBuffer(m_device, *m_allocator, staging.buffer, staging.memory);
+    }
+    batch.oversized.clear();
+    batch.bufferBarriers.clear();
+    batch.imageBarriers.clear();
+    batch.submitted = false;
+    if (batch.ticket > m_completedTicket) m_completedTicket = batch.ticket;
+}
@@ -0,0 +1,87 @@
+#ifndef UPLOAD_QUEUE_H
+#define UPLOAD_QUEUE_H
+
+#include <vulkan/vulkan.h> // TODO: forward declare
+#include <vector>
+#include "MemoryAllocator.h"
+
+#define UPLOAD_BATCH_COUNT 4
+#define UPLOAD_STAGING_SIZE (16 * 1024 * 1024)
+#define UPLOAD_MAX_MIP_LEVELS 16 // 32768 wide
+
+typedef uint64_t UploadTicket;
+
+// Records buffer/image copies into one command buffer per batch and submits them with a fence.
+// With a separate transfer family the copies run on the transfer queue and ownership is released
+// there and acquired on the graphics queue (after a semaphore), so uploads overlap with rendering.
+// Anything submitted to the graphics queue after submit() sees the uploaded data.
+// Destinations must be freshly created (or idle), not thread safe.
+class UploadQueue
+{
+public:
+    void init(VkDevice device, MemoryAllocator& allocator,
+              uint32_t graphicsFamily, VkQueue graphicsQueue,
+              uint32_t transferFamily, VkQueue transferQueue);
+    void cleanup();
+
+    // Data is copied into staging memory before returning
+    UploadTicket uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+    // Leaves the image in SHADER_READ_ONLY_OPTIMAL. Level i (half the size of the one before,
+    // at least 1) is at mipOffsets[i] into data, a single level at 0 without offsets
+    UploadTicket uploadImage(VkImage dst, uint32_t width, uint32_t height, const void* data, VkDeviceSize size,
+                             uint32_t mipLevels = 1, const VkDeviceSize* mipOffsets = nullptr);
+
+    UploadTicket submit(); // no-op when nothing was recorded
+    bool isComplete(UploadTicket ticket);
+    void wait(UploadTicket ticket);
+
+    // Once per frame: submits whatever was recorded and recycles finished batches
+    void update();
+
+private:
+    struct StagingBuffer
+    {
+        VkBuffer buffer;
+        Allocation memory;
+    };
+
+    struct Batch
+    {
+        VkCommandBuffer transferCmd;
+        VkCommandBuffer graphicsCmd; // ownership acquire, VK_NULL_HANDLE on a shared family
+        VkSemaphore transferDone;
+        VkFence fence;
+        UploadTicket ticket;
+        bool recording;
+        bool submitted;
+
+        StagingBuffer staging;
+        VkDeviceSize stagingHead;
+        std::vector<StagingBuffer> oversized; // uploads that don't fit UPLOAD_STAGING_SIZE
+
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+    };
+
+    Batch& openBatch(VkDeviceSize stagingSize);
+    void stage(Batch& batch, const void* data, VkDeviceSize size, VkBuffer& buffer, VkDeviceSize& offset);
+    void poll();
+    void retire(Batch& batch);
+
+    VkDevice m_device;
+    MemoryAllocator* m_allocator;
+    uint32_t m_graphicsFamily;
+    uint32_t m_transferFamily;
+    VkQueue m_graphicsQueue;
+    VkQueue m_transferQueue;
+    bool m_ownershipTransfer;
+
+    VkCommandPool m_transferPool;
+    VkCommandPool m_graphicsPool;
+    Batch m_batches[UPLOAD_BATCH_COUNT];
+    uint32_t m_current;
+    UploadTicket m_nextTicket;
+    UploadTicket m_completedTicket;
+};
+
+#endif /* UPLOAD_QUEUE_H */
@@ -1,22 +1,21 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler texSampler;
-layout(binding = 2) uniform texture2D mainTex[64];
-
-layout(push_constant) uniform PER_OBJECT
-{
-	layout(offset = 68) int instanceID;
-} constants;
+layout(set = 0, binding = 1) uniform sampler texSampler;
+layout(set = 1, binding = 0) uniform texture2D textures[]; // bindless, see TextureRegistry
 
 layout(location = 0) in vec3 inColor;
 layout(location = 1) in vec2 inUV;
+layout(location = 2) flat in uint inTexture;
+layout(location = 3) in vec4 inTint;
 
 layout(location = 0) out vec4 outColor;
 
 void main()
 {
-    outColor = texture(sampler2D(mainTex[constants.instanceID], texSampler), inUV);
+    // inTexture is not dynamically uniform across an instanced draw
+    outColor = texture(sampler2D(textures[nonuniformEXT(inTexture)], texSampler), inUV) * inTint;
     outColor.xyz *= inColor;
     outColor.xyz *= outColor.a;
-}
\ No newline at end of file
+}
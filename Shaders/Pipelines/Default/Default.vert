@@ -7,11 +7,17 @@ layout(set = 0, binding = 0) uniform UniformBufferObject
     float time;
 } ubo;
 
-layout(push_constant) uniform PER_OBJECT
+struct InstanceData
 {
     mat4 model;
-	int instanceID;
-} constants;
+    vec4 tint;
+    uint textureIndex;
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer Instances
+{
+    InstanceData instances[];
+};
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
@@ -19,11 +25,16 @@ layout(location = 2) in vec2 inUV;
 
 layout(location = 0) out vec3 outColor;
 layout(location = 1) out vec2 outUV;
+layout(location = 2) flat out uint outTexture;
+layout(location = 3) out vec4 outTint;
 
 void main()
 {
-    gl_Position = ubo.modelViewProj * constants.model * vec4(inPosition, 1.0);
+    InstanceData instance = instances[gl_InstanceIndex];
+    gl_Position = ubo.modelViewProj * instance.model * vec4(inPosition, 1.0);
 
     outColor = inColor;
     outUV = inUV;
+    outTexture = instance.textureIndex;
+    outTint = instance.tint;
 }
@@ -3,12 +3,7 @@
 
 layout(location = 0) out vec4 outColor;
 
-layout(push_constant) uniform PER_OBJECT
-{
-	int instanceID;
-} constants;
-
 void main()
 {
     outColor = vec4(0.1f, 0.1f, 0.1f, 1.0);
-}
\ No newline at end of file
+}
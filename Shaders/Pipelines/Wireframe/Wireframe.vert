@@ -6,15 +6,21 @@ layout(set = 0, binding = 0) uniform UniformBufferObject
     mat4 modelViewProj;
 } ubo;
 
-layout(push_constant) uniform PER_OBJECT
+struct InstanceData
 {
     mat4 model;
-	int instanceID;
-} constants;
+    vec4 tint;
+    uint textureIndex;
+};
+
+layout(std430, set = 0, binding = 3) readonly buffer Instances
+{
+    InstanceData instances[];
+};
 
 layout(location = 0) in vec3 inPosition;
 
 void main()
 {
-    gl_Position = ubo.modelViewProj * constants.model * vec4(inPosition, 1.0);
+    gl_Position = ubo.modelViewProj * instances[gl_InstanceIndex].model * vec4(inPosition, 1.0);
 }
@@ -1,5 +1,6 @@
 #include "Math/vec2.h"
 #include "Math/vec3.h"
+#include "Math/vec4.h"
 #include "Math/mat4.h"
 
 #include <glm/mat4x4.hpp>
@@ -44,13 +45,12 @@ struct UniformBufferObject
     float time;
 };
 
-struct VsPushConstants
+// std430, read with gl_InstanceIndex
+struct InstanceData
 {
     mat4 model;
-    uint32_t instanceID;
+    vec4 tint;
+    uint32_t textureIndex;
 };
 
-struct FsPushConstants
-{
-    uint32_t instanceID;
-};
\ No newline at end of file
+const uint32_t MAX_INSTANCES = 65536;
\ No newline at end of file
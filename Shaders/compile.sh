@@ -2,7 +2,7 @@
 # TODO: move glsl file here to compile?
 # TODO: might not be the best way to compile shaders...
 
-glslc="/Users/jacwilso/Documents/vulkansdk-macos-1.1.126.0/macOS/bin/glslc"
+glslc="${GLSLC:-/Users/jacwilso/Documents/vulkansdk-macos-1.1.126.0/macOS/bin/glslc}" # the engine reloads with $GLSLC too
 
 for vert in $(find . -type f -name '*.vert'); do
     eval "${glslc}" "${vert}" -o "${vert}.spv"
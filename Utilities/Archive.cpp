@@ -0,0 +1,205 @@
+#include "Archive.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "Profiler.h"
+
+#define ARCHIVE_MAGIC 0x314B4150u // "PAK1"
+#define ARCHIVE_VERSION 1
+
+struct ArchiveHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t namesSize;
+    uint64_t namesOffset;
+};
+
+bool Archive::open(const char* path)
+{
+    PROFILE_ZONE("Archive::open");
+    m_data = nullptr;
+    m_size = 0;
+    m_count = 0;
+    if (!path) return false;
+    int file = ::open(path, O_RDONLY);
+    if (file < 0) return false;
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size >= (off_t)sizeof(ArchiveHeader))
+    {
+        data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    }
+    ::close(file); // the mapping keeps it open
+    if (data == MAP_FAILED)
+    {
+        std::cerr << "Failed to map archive: " << path << std::endl;
+        return false;
+    }
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = info.st_size;
+
+    // Everything find() relies on, once, so lookups can trust the file
+    ArchiveHeader header;
+    memcpy(&header, m_data, sizeof(header));
+    uint64_t entriesEnd = sizeof(header) + (uint64_t)header.count * sizeof(Entry);
+    bool valid = header.magic == ARCHIVE_MAGIC && header.version == ARCHIVE_VERSION &&
+                 entriesEnd <= header.namesOffset && header.namesSize > 0 &&
+                 header.namesOffset + header.namesSize <= m_size;
+    if (valid)
+    {
+        m_entries = reinterpret_cast<const Entry*>(m_data + sizeof(header));
+        m_names = reinterpret_cast<const char*>(m_data + header.namesOffset);
+        valid = m_names[header.namesSize - 1] == '\0';
+        for (uint32_t i = 0; valid && i < header.count; ++i)
+        {
+            const Entry& entry = m_entries[i];
+            valid = entry.nameOffset < header.namesSize && entry.offset % ARCHIVE_ALIGNMENT == 0 &&
+                    entry.offset <= m_size && entry.size <= m_size - entry.offset &&
+                    (i == 0 || strcmp(m_names + m_entries[i - 1].nameOffset, m_names + entry.nameOffset) < 0);
+        }
+    }
+    if (!valid)
+    {
+        std::cerr << "Damaged archive: " << path << std::endl;
+        close();
+        return false;
+    }
+    m_count = header.count;
+    return true;
+}
+
+void Archive::close()
+{
+    if (m_data) munmap(const_cast<uint8_t*>(m_data), m_size);
+    m_data = nullptr;
+    m_size = 0;
+    m_count = 0;
+}
+
+bool Archive::isOpen() const
+{
+    return m_data != nullptr;
+}
+
+const uint8_t* Archive::find(const char* name, size_t& size, uint32_t& type) const
+{
+    uint32_t first = 0, last = m_count;
+    while (first < last)
+    {
+        uint32_t middle = first + (last - first) / 2;
+        int order = strcmp(m_names + m_entries[middle].nameOffset, name);
+        if (order == 0)
+        {
+            size = m_entries[middle].size;
+            type = m_entries[middle].type;
+            return m_data + m_entries[middle].offset;
+        }
+        if (order < 0) first = middle + 1;
+        else last = middle;
+    }
+    return nullptr;
+}
+
+uint32_t Archive::count() const
+{
+    return m_count;
+}
+
+void ArchiveBuilder::add(const char* name, const void* data, size_t size, ArchiveFileType type)
+{
+    File file;
+    snprintf(file.name, sizeof(file.name), "%s", name);
+    file.data = new uint8_t[size > 0 ? size : 1];
+    memcpy(file.data, data, size);
+    file.size = size;
+    file.type = type;
+    m_files.push_back(file);
+}
+
+bool ArchiveBuilder::write(const char* path)
+{
+    std::sort(m_files.begin(), m_files.end(), [](const File& a, const File& b)
+    {
+        return strcmp(a.name, b.name) < 0;
+    });
+    for (size_t i = 1; i < m_files.size(); ++i)
+    {
+        if (strcmp(m_files[i - 1].name, m_files[i].name) == 0)
+        {
+            std::cerr << "Added to the archive twice: " << m_files[i].name << std::endl;
+            return false;
+        }
+    }
+
+    // Names, then where every payload goes
+    std::vector<char> names;
+    std::vector<Archive::Entry> entries(m_files.size());
+    for (size_t i = 0; i < m_files.size(); ++i)
+    {
+        entries[i].nameOffset = names.size();
+        entries[i].type = m_files[i].type;
+        names.insert(names.end(), m_files[i].name, m_files[i].name + strlen(m_files[i].name) + 1);
+    }
+    if (names.empty()) names.push_back('\0');
+    ArchiveHeader header = {};
+    header.magic = ARCHIVE_MAGIC;
+    header.version = ARCHIVE_VERSION;
+    header.count = m_files.size();
+    header.namesSize = names.size();
+    header.namesOffset = sizeof(header) + entries.size() * sizeof(Archive::Entry);
+    uint64_t offset = header.namesOffset + header.namesSize;
+    for (size_t i = 0; i < m_files.size(); ++i)
+    {
+        offset = (offset + ARCHIVE_ALIGNMENT - 1) & ~(uint64_t)(ARCHIVE_ALIGNMENT - 1);
+        entries[i].offset = offset;
+        entries[i].size = m_files[i].size;
+        offset += m_files[i].size;
+    }
+
+    // Under a temporary name, a running build may have the old one mapped
+    char tmpPath[ARCHIVE_PATH_SIZE + 8];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+    FILE* file = fopen(tmpPath, "wb");
+    bool written = file && fwrite(&header, sizeof(header), 1, file) == 1 &&
+                   (entries.empty() || fwrite(entries.data(), sizeof(Archive::Entry), entries.size(), file) == entries.size()) &&
+                   fwrite(names.data(), 1, names.size(), file) == names.size();
+    uint64_t position = header.namesOffset + header.namesSize;
+    const uint8_t padding[ARCHIVE_ALIGNMENT] = {};
+    for (size_t i = 0; written && i < m_files.size(); ++i)
+    {
+        size_t pad = entries[i].offset - position;
+        written = fwrite(padding, 1, pad, file) == pad && fwrite(m_files[i].data, 1, m_files[i].size, file) == m_files[i].size;
+        position = entries[i].offset + m_files[i].size;
+    }
+    if (file) written = fclose(file) == 0 && written;
+    if (written) written = rename(tmpPath, path) == 0;
+    if (!written)
+    {
+        std::cerr << "Failed to write archive: " << path << std::endl;
+        remove(tmpPath);
+    }
+    return written;
+}
+
+void ArchiveBuilder::cleanup()
+{
+    for (File& file : m_files)
+    {
+        delete[] file.data;
+    }
+    m_files.clear();
+}
+
+uint32_t ArchiveBuilder::count() const
+{
+    return m_files.size();
+}
@@ -0,0 +1,73 @@
+#ifndef ARCHIVE_H
+#define ARCHIVE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define ARCHIVE_PATH_SIZE 256
+#define ARCHIVE_ALIGNMENT 64 // payload offsets, SPIR-V needs 4, copies into staging like more
+
+// What a payload holds, so the loader knows what it's been handed
+enum ArchiveFileType
+{
+    ARCHIVE_FILE, // the file as it was on disk
+    ARCHIVE_BAKED_TEXTURE // AssetLoader's BakedTexture, ready to upload
+};
+
+// Read only packed assets, mapped rather than read: a lookup is a binary search over the sorted
+// table of contents and returns a pointer into the mapping, which stays valid until close(), so
+// the only copy of a payload is the one into staging memory. Any thread once open.
+// File: header, entries sorted by name, null terminated names, payloads at ARCHIVE_ALIGNMENT.
+class Archive
+{
+public:
+    bool open(const char* path); // false if it's missing or damaged, nullptr just leaves it closed
+    void close();
+    bool isOpen() const;
+
+    // Into the mapping, nullptr if it isn't in the archive
+    const uint8_t* find(const char* name, size_t& size, uint32_t& type) const;
+    uint32_t count() const;
+
+private:
+    struct Entry
+    {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t nameOffset; // into the names
+        uint32_t type; // ArchiveFileType
+    };
+
+    const uint8_t* m_data;
+    size_t m_size;
+    const Entry* m_entries;
+    const char* m_names;
+    uint32_t m_count;
+
+    friend class ArchiveBuilder;
+};
+
+// Collects payloads and writes them as an Archive, see Rendering/AssetPacker for the tool
+class ArchiveBuilder
+{
+public:
+    void add(const char* name, const void* data, size_t size, ArchiveFileType type = ARCHIVE_FILE); // copied
+    bool write(const char* path); // false on duplicate names or IO errors
+    void cleanup();
+
+    uint32_t count() const;
+
+private:
+    struct File
+    {
+        char name[ARCHIVE_PATH_SIZE];
+        uint8_t* data;
+        size_t size;
+        ArchiveFileType type;
+    };
+
+    std::vector<File> m_files;
+};
+
+#endif /* ARCHIVE_H */
@@ -0,0 +1,111 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+
+void Benchmark::init(const BenchmarkScene& scene, const char* device)
+{
+    m_scene = scene;
+    snprintf(m_device, sizeof(m_device), "%s", device);
+    m_measuring = false;
+    m_frameTimes.clear();
+    m_renderStats.clear();
+}
+
+void Benchmark::cleanup()
+{
+    m_measuring = false;
+    m_frameTimes = std::vector<double>();
+    m_renderStats = std::vector<RenderStats>();
+}
+
+void Benchmark::start()
+{
+    m_measuring.store(true, std::memory_order_relaxed);
+}
+
+bool Benchmark::isMeasuring() const
+{
+    return m_measuring.load(std::memory_order_relaxed);
+}
+
+uint32_t Benchmark::frameCount() const
+{
+    return m_frameTimes.size();
+}
+
+void Benchmark::frame(double frameTime)
+{
+    if (isMeasuring()) m_frameTimes.push_back(frameTime);
+}
+
+void Benchmark::rendered(const RenderStats& stats)
+{
+    if (isMeasuring()) m_renderStats.push_back(stats);
+}
+
+// "name": {"mean": .., "min": .., "p50": .., ...}, nearest rank percentiles
+static void writeSummary(FILE* file, const char* name, std::vector<double> samples, bool last = false)
+{
+    fprintf(file, "  \"%s\": {", name);
+    if (!samples.empty())
+    {
+        std::sort(samples.begin(), samples.end());
+        double sum = 0.0;
+        for (double sample : samples) sum += sample;
+        const double percentiles[] = { 50.0, 90.0, 95.0, 99.0 };
+        fprintf(file, "\"mean\": %.4f, \"min\": %.4f", sum / samples.size(), samples.front());
+        for (double percentile : percentiles)
+        {
+            size_t rank = (size_t)(percentile / 100.0 * samples.size() + 0.5);
+            size_t index = rank > 0 ? rank - 1 : 0;
+            fprintf(file, ", \"p%.0f\": %.4f", percentile, samples[index < samples.size() ? index : samples.size() - 1]);
+        }
+        fprintf(file, ", \"max\": %.4f", samples.back());
+    }
+    fprintf(file, "}%s\n", last ? "" : ",");
+}
+
+bool Benchmark::write(const char* path) const
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        std::cerr << "Failed to open benchmark results: " << path << std::endl;
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"scene\": {\"sprites\": %u, \"textures\": %u, \"wireframe\": %s, \"imgui\": %s, \"pipelined\": %s},\n",
+        m_scene.sprites, m_scene.textures, m_scene.wireframe ? "true" : "false",
+        m_scene.imgui ? "true" : "false", m_scene.pipelined ? "true" : "false");
+    fprintf(file, "  \"device\": \"%s\",\n", m_device); // driver names don't contain quotes or backslashes
+    fprintf(file, "  \"frames\": %zu,\n", m_frameTimes.size());
+    fprintf(file, "  \"renderedFrames\": %zu,\n", m_renderStats.size());
+
+    // Times in milliseconds
+    size_t count = m_renderStats.size();
+    std::vector<double> uploads(count), waitForGpu(count), descriptors(count), record(count), submit(count), drawCalls(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uploads[i] = m_renderStats[i].uploads;
+        waitForGpu[i] = m_renderStats[i].waitForGpu;
+        descriptors[i] = m_renderStats[i].descriptors;
+        record[i] = m_renderStats[i].record;
+        submit[i] = m_renderStats[i].submit;
+        drawCalls[i] = m_renderStats[i].drawCalls;
+    }
+    writeSummary(file, "frameTime", m_frameTimes);
+    writeSummary(file, "uploads", uploads);
+    writeSummary(file, "waitForGpu", waitForGpu);
+    writeSummary(file, "descriptors", descriptors);
+    writeSummary(file, "record", record);
+    writeSummary(file, "submit", submit);
+    writeSummary(file, "drawCalls", drawCalls, true);
+    fprintf(file, "}\n");
+
+    bool written = ferror(file) == 0;
+    fclose(file);
+    return written;
+}
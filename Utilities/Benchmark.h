@@ -0,0 +1,54 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+struct BenchmarkScene
+{
+    uint32_t sprites;
+    uint32_t textures; // unique, generated, sprites cycle through them
+    bool wireframe; // wireframe pass under the scene, EDITOR builds only
+    bool imgui;
+    bool pipelined;
+};
+
+// Render thread timings of one frame, milliseconds
+struct RenderStats
+{
+    double uploads; // AssetLoader + UploadQueue
+    double waitForGpu;
+    double descriptors; // TextureRegistry::update
+    double record; // frame data + command buffers
+    double submit; // vkQueueSubmit, present when there is one
+    uint32_t drawCalls;
+};
+
+// Collects per frame samples once warmed up and writes them out summarised (mean, percentiles) as
+// JSON. Frame times come from the main thread, render stats from whichever thread renders.
+class Benchmark
+{
+public:
+    void init(const BenchmarkScene& scene, const char* device);
+    void cleanup();
+
+    void start(); // after warm up, nothing is recorded before
+    bool isMeasuring() const;
+    uint32_t frameCount() const; // measured so far
+
+    void frame(double frameTime); // main thread, milliseconds
+    void rendered(const RenderStats& stats); // render thread
+
+    // Once the render thread is idle
+    bool write(const char* path) const;
+
+private:
+    BenchmarkScene m_scene;
+    char m_device[256];
+    std::atomic<bool> m_measuring;
+    std::vector<double> m_frameTimes;
+    std::vector<RenderStats> m_renderStats;
+};
+
+#endif /* BENCHMARK_H */
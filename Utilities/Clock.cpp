@@ -0,0 +1,123 @@
+#include "Clock.h"
+
+#include <assert.h>
+#include <cmath>
+#include <thread>
+
+#define SPIN_TIME 0.002 // seconds, sleep_for can overshoot by about a scheduler tick
+
+void Clock::init(double stepRate, double frameLimit)
+{
+    assert( stepRate > 0.0 );
+    m_step = 1.0 / stepRate;
+    setFrameLimit(frameLimit);
+    m_frameTime = 0.0;
+    m_accumulator = 0.0;
+    m_time = 0.0;
+    m_deltaTime = 0.0;
+    m_frame = 0;
+    m_steps = 0;
+    m_stepsThisFrame = 0;
+    m_frameStart = Timer::now();
+}
+
+void Clock::tick()
+{
+    Timer::time_point now = Timer::now();
+    double delta = std::chrono::duration<double>(now - m_frameStart).count();
+    m_frameStart = now;
+    if (m_frameTime > 0.0) delta = m_frameTime;
+
+    m_deltaTime = delta < MAX_FRAME_TIME ? delta : MAX_FRAME_TIME;
+    m_accumulator += m_deltaTime;
+    m_stepsThisFrame = 0;
+    m_frame++;
+}
+
+bool Clock::advance()
+{
+    if (m_accumulator < m_step) return false;
+    if (m_stepsThisFrame == MAX_STEPS_PER_FRAME)
+    {
+        // Can't keep up, let the simulation run slow rather than spend ever longer frames catching up
+        m_accumulator = fmod(m_accumulator, m_step);
+        return false;
+    }
+    m_accumulator -= m_step;
+    m_time += m_step;
+    m_steps++;
+    m_stepsThisFrame++;
+    return true;
+}
+
+void Clock::pace()
+{
+    if (m_frameLimit <= 0.0) return;
+    Timer::time_point end = m_frameStart + std::chrono::duration_cast<Timer::duration>(std::chrono::duration<double>(m_frameLimit));
+
+    double remaining = std::chrono::duration<double>(end - Timer::now()).count();
+    if (remaining > SPIN_TIME)
+    {
+        std::this_thread::sleep_for(std::chrono::duration<double>(remaining - SPIN_TIME));
+    }
+    while (Timer::now() < end)
+    {
+        std::this_thread::yield();
+    }
+}
+
+void Clock::setFrameLimit(double frameRate)
+{
+    m_frameLimit = frameRate > 0.0 ? 1.0 / frameRate : 0.0;
+}
+
+double Clock::frameLimit() const
+{
+    return m_frameLimit > 0.0 ? 1.0 / m_frameLimit : 0.0;
+}
+
+void Clock::setFrameTime(double seconds)
+{
+    m_frameTime = seconds;
+}
+
+double Clock::time() const
+{
+    return m_time;
+}
+
+double Clock::renderTime() const
+{
+    double time = m_time - m_step + m_accumulator;
+    return time > 0.0 ? time : 0.0;
+}
+
+float Clock::fixedDelta() const
+{
+    return m_step;
+}
+
+float Clock::deltaTime() const
+{
+    return m_deltaTime;
+}
+
+float Clock::alpha() const
+{
+    return m_accumulator / m_step;
+}
+
+uint64_t Clock::frame() const
+{
+    return m_frame;
+}
+
+uint64_t Clock::steps() const
+{
+    return m_steps;
+}
+
+uint32_t Clock::stepsThisFrame() const
+{
+    return m_stepsThisFrame;
+}
@@ -0,0 +1,54 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <stdint.h>
+#include <chrono>
+
+#define MAX_FRAME_TIME 0.25     // seconds, longer frames (breakpoints, hitches) are clamped
+#define MAX_STEPS_PER_FRAME 8   // past this the simulation drops time instead of falling further behind
+
+// The engine's one time source. Real time is accumulated once per frame and consumed in fixed
+// simulation steps, rendering interpolates between the last two steps with alpha().
+//
+//     clock.tick();
+//     while (clock.advance()) simulate(clock.fixedDelta());
+//     render(clock.alpha());
+//     clock.pace();
+class Clock
+{
+public:
+    void init(double stepRate, double frameLimit = 0.0);
+
+    void tick(); // start of frame
+    bool advance(); // true while another fixed step is due, the step is counted as taken
+    void pace(); // end of frame, sleeps off whatever is left of the frame limit
+
+    void setFrameLimit(double frameRate); // 0 leaves pacing to the present mode
+    double frameLimit() const;
+    void setFrameTime(double seconds); // every frame lasts this long regardless of real time, 0 measures
+
+    double time() const; // simulation time as of the last step
+    double renderTime() const; // time() - fixedDelta() + alpha() * fixedDelta(), what gets drawn
+    float fixedDelta() const;
+    float deltaTime() const; // real time of the last frame, clamped
+    float alpha() const; // [0, 1) between the previous and the last step
+    uint64_t frame() const;
+    uint64_t steps() const;
+    uint32_t stepsThisFrame() const;
+
+private:
+    typedef std::chrono::steady_clock Timer;
+
+    Timer::time_point m_frameStart;
+    double m_step;
+    double m_frameLimit; // seconds per frame, 0 for none
+    double m_frameTime; // fixed seconds per frame, 0 for real time
+    double m_accumulator;
+    double m_time;
+    double m_deltaTime;
+    uint64_t m_frame;
+    uint64_t m_steps;
+    uint32_t m_stepsThisFrame;
+};
+
+#endif /* CLOCK_H */
@@ -3,4 +3,8 @@
 #define STRINGIFYMACRO(x) STRINGIFY(x)
 
 #define MAX(x,y) (x > y? x : y)
-#define MIN(x,y) (x < y? x : y)
\ No newline at end of file
+#define MIN(x,y) (x < y? x : y)
+
+// a is a power of two
+#define ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+#define ALIGN_DOWN(x, a) ((x) & ~((a) - 1))
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "DerivedDataCache.h"
+
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "Hash.h"
+#include "Profiler.h"
+
+#define DDC_MAGIC 0x31434444u // "DDC1"
+
+// Entry file: header then payload
+struct EntryHeader
+{
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t key;
+    uint64_t size;
+    uint64_t checksum; // of the payload, catches truncated or damaged files
+};
+
+uint8_t* readFile(const char* path, size_t& size)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) return nullptr;
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = nullptr;
+    size = 0;
+    if (length >= 0)
+    {
+        data = new uint8_t[length > 0 ? length : 1];
+        size = fread(data, 1, length, file);
+        if (size != (size_t)length)
+        {
+            delete[] data;
+            data = nullptr;
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+void DerivedDataCache::init(const char* directory)
+{
+    snprintf(m_directory, sizeof(m_directory), "%s", directory);
+    mkdir(m_directory, 0755); // fails harmlessly if it exists
+    m_tmpCount = 0;
+    m_hits = 0;
+    m_misses = 0;
+}
+
+void DerivedDataCache::cleanup()
+{
+    if (m_hits + m_misses > 0) std::cout << "Derived data cache: " << m_hits << " hits, " << m_misses << " misses" << std::endl;
+}
+
+uint64_t DerivedDataCache::key(const void* source, size_t size, const char* settings)
+{
+    return hashString(settings, hashData(source, size));
+}
+
+uint8_t* DerivedDataCache::load(uint64_t key, size_t& size) const
+{
+    PROFILE_ZONE("DerivedDataCache::load");
+    char path[320];
+    entryPath(path, sizeof(path), key);
+    size_t fileSize = 0;
+    uint8_t* file = readFile(path, fileSize);
+
+    EntryHeader header;
+    bool valid = file && fileSize >= sizeof(header);
+    if (valid)
+    {
+        memcpy(&header, file, sizeof(header));
+        valid = header.magic == DDC_MAGIC && header.key == key && header.size == fileSize - sizeof(header) &&
+                header.checksum == hashData(file + sizeof(header), header.size);
+    }
+    if (!valid)
+    {
+        if (file) std::cerr << "Damaged derived data, rebuilding: " << path << std::endl;
+        delete[] file;
+        m_misses++;
+        return nullptr;
+    }
+
+    size = header.size;
+    uint8_t* payload = new uint8_t[size > 0 ? size : 1];
+    memcpy(payload, file + sizeof(header), size);
+    delete[] file;
+    m_hits++;
+    return payload;
+}
+
+bool DerivedDataCache::store(uint64_t key, const void* payload, size_t size)
+{
+    PROFILE_ZONE("DerivedDataCache::store");
+    EntryHeader header = {};
+    header.magic = DDC_MAGIC;
+    header.key = key;
+    header.size = size;
+    header.checksum = hashData(payload, size);
+
+    char path[320], tmpPath[340];
+    entryPath(path, sizeof(path), key);
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp%u", path, m_tmpCount++);
+    FILE* file = fopen(tmpPath, "wb");
+    bool written = file && fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(payload, 1, size, file) == size;
+    if (file) written = fclose(file) == 0 && written;
+    if (written) written = rename(tmpPath, path) == 0;
+    if (!written)
+    {
+        std::cerr << "Failed to store derived data: " << path << std::endl;
+        remove(tmpPath);
+    }
+    return written;
+}
+
+uint32_t DerivedDataCache::hits() const
+{
+    return m_hits;
+}
+
+uint32_t DerivedDataCache::misses() const
+{
+    return m_misses;
+}
+
+void DerivedDataCache::entryPath(char* path, size_t size, uint64_t key) const
+{
+    snprintf(path, size, "%s/%016llx", m_directory, (unsigned long long)key);
+}
@@ -0,0 +1,41 @@
+#ifndef DERIVED_DATA_CACHE_H
+#define DERIVED_DATA_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+// What's expensive to derive from a source file (decoded textures, compiled shaders) kept on disk,
+// content addressed: the key hashes the source's bytes and a settings string naming the kind of
+// payload and everything that changes it, so edits, new settings and new versions all miss.
+// One file per entry, written under a temporary name and renamed, so any thread can load and
+// store without a shared index and a crash never leaves half an entry behind.
+class DerivedDataCache
+{
+public:
+    void init(const char* directory); // created if it's missing
+    void cleanup();
+
+    static uint64_t key(const void* source, size_t size, const char* settings);
+
+    // new[] payload, nullptr on a miss (or a damaged entry)
+    uint8_t* load(uint64_t key, size_t& size) const;
+    bool store(uint64_t key, const void* payload, size_t size);
+
+    // Since init, for the log
+    uint32_t hits() const;
+    uint32_t misses() const;
+
+private:
+    char m_directory[256];
+    std::atomic<uint32_t> m_tmpCount; // unique temporary names
+    mutable std::atomic<uint32_t> m_hits;
+    mutable std::atomic<uint32_t> m_misses;
+
+    void entryPath(char* path, size_t size, uint64_t key) const;
+};
+
+// Reads a whole file into a new[] buffer, nullptr if it can't be opened
+uint8_t* readFile(const char* path, size_t& size);
+
+#endif /* DERIVED_DATA_CACHE_H */
@@ -0,0 +1,46 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define HASH_SEED 0x9E3779B97F4A7C15ull
+#define HASH_PRIME 0x100000001B3ull
+
+// Murmur3's finalizer
+inline uint64_t hashMix(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xFF51AFD7ED558CCDull;
+    x ^= x >> 33;
+    x *= 0xC4CEB9FE1A85EC53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// Non-cryptographic, 8 bytes a step so hashing whole files stays cheap next to reading them.
+// Chain calls through seed to hash several pieces. Native endianness, not for files shared
+// between machines.
+inline uint64_t hashData(const void* data, size_t size, uint64_t seed = HASH_SEED)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    uint64_t hash = seed ^ (size * HASH_PRIME);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ hashMix(word)) * HASH_PRIME;
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    return hashMix(hash ^ hashMix(tail));
+}
+
+inline uint64_t hashString(const char* string, uint64_t seed = HASH_SEED)
+{
+    return string ? hashData(string, strlen(string), seed) : hashData("", 0, seed);
+}
+
+#endif /* HASH_H */
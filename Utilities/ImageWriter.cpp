@@ -0,0 +1,123 @@
+#include "ImageWriter.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#define PNG_MAX_STORED_BLOCK 65535 // deflate's limit for one stored block
+
+static uint32_t crcTable[256];
+
+static void initCrcTable()
+{
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+        {
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crcTable[i] = c;
+    }
+}
+
+static uint32_t crc(uint32_t c, const uint8_t* data, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        c = crcTable[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c;
+}
+
+static void putBigEndian(uint8_t* dst, uint32_t value)
+{
+    dst[0] = value >> 24;
+    dst[1] = value >> 16;
+    dst[2] = value >> 8;
+    dst[3] = value;
+}
+
+// Length, type, data, CRC of type + data
+static void writeChunk(FILE* file, const char type[4], const uint8_t* data, uint32_t size)
+{
+    uint8_t header[8];
+    putBigEndian(header, size);
+    memcpy(header + 4, type, 4);
+    fwrite(header, 1, 8, file);
+    fwrite(data, 1, size, file);
+
+    uint32_t c = crc(0xFFFFFFFFu, header + 4, 4);
+    c = crc(c, data, size) ^ 0xFFFFFFFFu;
+    uint8_t footer[4];
+    putBigEndian(footer, c);
+    fwrite(footer, 1, 4, file);
+}
+
+bool writePng(const char* path, const uint8_t* pixels, uint32_t width, uint32_t height)
+{
+    FILE* file = fopen(path, "wb");
+    if (!file)
+    {
+        std::cerr << "Failed to open image: " << path << std::endl;
+        return false;
+    }
+    if (crcTable[1] == 0) initCrcTable();
+
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 1, sizeof(signature), file);
+
+    uint8_t header[13];
+    putBigEndian(header, width);
+    putBigEndian(header + 4, height);
+    header[8] = 8;  // bit depth
+    header[9] = 6;  // RGBA
+    header[10] = 0; // deflate
+    header[11] = 0; // adaptive filtering, every row uses none
+    header[12] = 0; // not interlaced
+    writeChunk(file, "IHDR", header, sizeof(header));
+
+    // Scanlines are a filter byte then the row
+    size_t rowSize = (size_t)width * 4;
+    size_t rawSize = (rowSize + 1) * height;
+    size_t blockCount = rawSize / PNG_MAX_STORED_BLOCK + 1;
+    size_t dataSize = 2 + rawSize + blockCount * 5 + 4;
+    uint8_t* data = new uint8_t[dataSize];
+
+    uint8_t* out = data;
+    *out++ = 0x78; // zlib header, 32K window
+    *out++ = 0x01;
+    uint32_t adlerA = 1, adlerB = 0;
+    size_t row = 0, column = 0; // position in the raw scanlines
+    for (size_t remaining = rawSize; remaining > 0 || out == data + 2;)
+    {
+        uint32_t blockSize = remaining < PNG_MAX_STORED_BLOCK ? remaining : PNG_MAX_STORED_BLOCK;
+        remaining -= blockSize;
+        *out++ = remaining == 0 ? 1 : 0; // BFINAL, BTYPE 00
+        *out++ = blockSize & 0xFF;
+        *out++ = blockSize >> 8;
+        *out++ = ~blockSize & 0xFF;
+        *out++ = (~blockSize >> 8) & 0xFF;
+        for (uint32_t i = 0; i < blockSize; ++i)
+        {
+            uint8_t byte = column == 0 ? 0 : pixels[row * rowSize + column - 1];
+            if (++column == rowSize + 1)
+            {
+                column = 0;
+                row++;
+            }
+            *out++ = byte;
+            adlerA = (adlerA + byte) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+    }
+    putBigEndian(out, (adlerB << 16) | adlerA);
+    out += 4;
+    writeChunk(file, "IDAT", data, out - data);
+    delete[] data;
+
+    writeChunk(file, "IEND", nullptr, 0);
+    bool written = ferror(file) == 0;
+    fclose(file);
+    return written;
+}
@@ -0,0 +1,10 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <stdint.h>
+
+// 8 bit RGBA, rows top to bottom and tightly packed. Stored (uncompressed) deflate blocks, the
+// files are big but it needs no zlib and is only for captures and image comparisons.
+bool writePng(const char* path, const uint8_t* pixels, uint32_t width, uint32_t height);
+
+#endif /* IMAGE_WRITER_H */
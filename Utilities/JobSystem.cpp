@@ -0,0 +1,367 @@
+#include "JobSystem.h"
+
+#include <cstdio>
+
+#include "Profiler.h"
+
+#define NOT_A_WORKER UINT32_MAX
+
+struct Job
+{
+    std::function<void()> function;
+    JobCounter* counter;
+    JobPriority priority;
+    bool heap; // submitted from outside the workers, not from a pool
+    std::atomic<bool> inUse;
+};
+
+// Chase-Lev deque (with the C11 orderings from Le et al. 2013). Fixed size, push fails when it's full.
+class JobDeque
+{
+public:
+    JobDeque() : m_top(0), m_bottom(0) {}
+
+    bool push(Job* job) // owner
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        if (bottom - top >= JOB_DEQUE_SIZE) return false;
+        m_jobs[bottom & (JOB_DEQUE_SIZE - 1)].store(job, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    Job* pop() // owner
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom) // empty
+        {
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        Job* job = m_jobs[bottom & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+        if (top == bottom) // last one, race the thieves for it
+        {
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) job = nullptr;
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    Job* steal() // any thread
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom) return nullptr;
+
+        Job* job = m_jobs[top & (JOB_DEQUE_SIZE - 1)].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return nullptr; // lost the race
+        return job;
+    }
+
+private:
+    std::atomic<int64_t> m_top;
+    std::atomic<int64_t> m_bottom;
+    std::atomic<Job*> m_jobs[JOB_DEQUE_SIZE];
+};
+
+static thread_local uint32_t t_worker = NOT_A_WORKER;
+
+/// JobCounter
+JobCounter::JobCounter() : m_pending(0)
+{
+}
+
+bool JobCounter::isDone() const
+{
+    if (m_pending.load(std::memory_order_acquire) != 0) return false;
+    std::lock_guard<std::mutex> lock(m_mutex); // the last job has let go of the counter
+    return true;
+}
+
+/// JobSystem
+void JobSystem::init(uint32_t workerCount)
+{
+    if (workerCount == 0)
+    {
+        uint32_t cores = std::thread::hardware_concurrency();
+        workerCount = cores > 2 ? cores : 2; // at least one thread for low priority jobs
+    }
+    m_workerCount = workerCount;
+    m_ownerCount = m_workerCount + JOB_MAX_ATTACHED_THREADS;
+    m_deques = new JobDeque[m_ownerCount * JOB_PRIORITY_COUNT];
+    m_pools = new Job[m_ownerCount * JOB_POOL_SIZE];
+    m_poolHeads = new uint32_t[m_ownerCount];
+    for (uint32_t i = 0; i < m_ownerCount; ++i)
+    {
+        m_poolHeads[i] = 0;
+    }
+    for (uint32_t i = 0; i < m_ownerCount * JOB_POOL_SIZE; ++i)
+    {
+        m_pools[i].inUse = false;
+    }
+    for (uint32_t i = 0; i < JOB_MAX_ATTACHED_THREADS; ++i)
+    {
+        m_attached[i] = false;
+    }
+    m_injectedCount = 0;
+    m_sleeping = 0;
+    m_stopping = false;
+
+    t_worker = 0;
+    m_threads = new std::thread[m_workerCount - 1];
+    for (uint32_t i = 1; i < m_workerCount; ++i)
+    {
+        m_threads[i - 1] = std::thread(&JobSystem::workerLoop, this, i);
+    }
+}
+
+void JobSystem::cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (uint32_t i = 0; i < m_workerCount - 1; ++i)
+    {
+        m_threads[i].join();
+    }
+    delete[] m_threads;
+    delete[] m_deques;
+    delete[] m_pools;
+    delete[] m_poolHeads;
+    t_worker = NOT_A_WORKER;
+}
+
+void JobSystem::submit(std::function<void()> function, JobCounter* counter, JobPriority priority)
+{
+    Job* job = allocate();
+    job->function = std::move(function);
+    job->counter = counter;
+    job->priority = priority;
+    if (counter) counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+    schedule(job);
+}
+
+void JobSystem::submitAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter, JobPriority priority)
+{
+    Job* job = allocate();
+    job->function = std::move(function);
+    job->counter = counter;
+    job->priority = priority;
+    if (counter) counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> lock(dependency.m_mutex);
+        if (dependency.m_pending.load(std::memory_order_acquire) > 0)
+        {
+            dependency.m_continuations.push_back(job);
+            return;
+        }
+    }
+    schedule(job);
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& function)
+{
+    if (count == 0) return;
+    uint32_t rangeCount = (count + grain - 1) / grain;
+    if (rangeCount > m_workerCount) rangeCount = m_workerCount;
+    uint32_t rangeSize = (count + rangeCount - 1) / rangeCount;
+    rangeSize = (rangeSize + grain - 1) / grain * grain;
+
+    // The caller takes the first range itself
+    JobCounter counter;
+    for (uint32_t begin = rangeSize; begin < count; begin += rangeSize)
+    {
+        uint32_t end = count - begin < rangeSize ? count : begin + rangeSize;
+        submit([&function, begin, end]() { function(begin, end); }, &counter);
+    }
+    function(0, count < rangeSize ? count : rangeSize);
+    wait(counter);
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+    while (counter.m_pending.load(std::memory_order_acquire) > 0)
+    {
+        // Low priority jobs can run for milliseconds, leave those to the idle workers
+        Job* job = findJob(t_worker, JOB_PRIORITY_HIGH);
+        if (job) execute(job);
+        else std::this_thread::yield();
+    }
+    std::lock_guard<std::mutex> lock(counter.m_mutex); // the last job has let go of the counter
+}
+
+uint32_t JobSystem::workerCount() const
+{
+    return m_workerCount;
+}
+
+void JobSystem::attachThread()
+{
+    std::lock_guard<std::mutex> lock(m_attachMutex);
+    for (uint32_t i = 0; i < JOB_MAX_ATTACHED_THREADS; ++i)
+    {
+        if (m_attached[i]) continue;
+        // Jobs a previous owner left behind get stolen, pool slots still running are skipped
+        m_attached[i] = true;
+        t_worker = m_workerCount + i;
+        return;
+    }
+}
+
+void JobSystem::detachThread()
+{
+    if (t_worker == NOT_A_WORKER || t_worker < m_workerCount) return; // never attached
+    std::lock_guard<std::mutex> lock(m_attachMutex);
+    m_attached[t_worker - m_workerCount] = false;
+    t_worker = NOT_A_WORKER;
+}
+
+Job* JobSystem::allocate()
+{
+    // Ring per worker, a slot is free again once its job has run. Still running means the ring
+    // has wrapped onto a long job, those and non worker submissions go on the heap
+    Job* job = nullptr;
+    if (t_worker != NOT_A_WORKER)
+    {
+        uint32_t& head = m_poolHeads[t_worker];
+        job = &m_pools[t_worker * JOB_POOL_SIZE + (head & (JOB_POOL_SIZE - 1))];
+        if (job->inUse.load(std::memory_order_acquire)) job = nullptr;
+        else head++;
+    }
+    if (!job)
+    {
+        job = new Job();
+        job->heap = true;
+        return job;
+    }
+    job->inUse.store(true, std::memory_order_relaxed);
+    job->heap = false;
+    return job;
+}
+
+void JobSystem::schedule(Job* job)
+{
+    if (t_worker == NOT_A_WORKER)
+    {
+        std::lock_guard<std::mutex> lock(m_injectedMutex);
+        m_injected[job->priority].push_back(job);
+        m_injectedCount.fetch_add(1, std::memory_order_release);
+    }
+    else if (!m_deques[t_worker * JOB_PRIORITY_COUNT + job->priority].push(job))
+    {
+        execute(job); // full, running it now is the back pressure
+        return;
+    }
+    wake();
+}
+
+void JobSystem::wake()
+{
+    // Pairs with the sleeper bumping m_sleeping before it looks for work one last time
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_seq_cst) == 0) return;
+    std::lock_guard<std::mutex> lock(m_sleepMutex);
+    m_wake.notify_one();
+}
+
+Job* JobSystem::findJob(uint32_t worker, JobPriority lowest)
+{
+    for (uint32_t priority = 0; priority <= lowest; ++priority)
+    {
+        Job* job = nullptr;
+        if (worker != NOT_A_WORKER)
+        {
+            job = m_deques[worker * JOB_PRIORITY_COUNT + priority].pop();
+            if (job) return job;
+        }
+
+        if (m_injectedCount.load(std::memory_order_acquire) > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_injectedMutex);
+            if (!m_injected[priority].empty())
+            {
+                job = m_injected[priority].front();
+                m_injected[priority].pop_front();
+                m_injectedCount.fetch_sub(1, std::memory_order_relaxed);
+                return job;
+            }
+        }
+
+        // Start stealing from the next owner so thieves spread out
+        uint32_t start = worker == NOT_A_WORKER ? 0 : worker + 1;
+        for (uint32_t i = 0; i < m_ownerCount; ++i)
+        {
+            uint32_t victim = (start + i) % m_ownerCount;
+            if (victim == worker) continue;
+            job = m_deques[victim * JOB_PRIORITY_COUNT + priority].steal();
+            if (job) return job;
+        }
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(Job* job)
+{
+    job->function();
+    job->function = nullptr; // drop captures now rather than when the slot is reused
+
+    JobCounter* counter = job->counter;
+    if (job->heap) delete job;
+    else job->inUse.store(false, std::memory_order_release);
+
+    if (counter) retire(counter);
+}
+
+void JobSystem::retire(JobCounter* counter)
+{
+    std::vector<Job*> continuations;
+    {
+        // Decremented under the lock so a waiter can't free the counter while it's still held here
+        std::lock_guard<std::mutex> lock(counter->m_mutex);
+        if (counter->m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            continuations.swap(counter->m_continuations);
+        }
+    }
+    for (Job* continuation : continuations)
+    {
+        schedule(continuation);
+    }
+}
+
+void JobSystem::workerLoop(uint32_t worker)
+{
+    t_worker = worker;
+    char name[32];
+    snprintf(name, sizeof(name), "Worker %u", worker);
+    Profiler::setThreadName(name);
+    while (true)
+    {
+        Job* job = findJob(worker, JOB_PRIORITY_LOW);
+        if (job)
+        {
+            execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeping.fetch_add(1, std::memory_order_seq_cst);
+        job = findJob(worker, JOB_PRIORITY_LOW);
+        bool stopping = m_stopping;
+        if (!job && !stopping) m_wake.wait(lock);
+        m_sleeping.fetch_sub(1, std::memory_order_relaxed);
+        lock.unlock();
+
+        if (job) execute(job);
+        else if (stopping) return; // drained
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define JOB_DEQUE_SIZE 4096 // per worker and priority, a full one runs submissions inline, power of two
+#define JOB_POOL_SIZE 4096  // pooled jobs per worker, more in flight go on the heap, power of two
+#define JOB_MAX_ATTACHED_THREADS 4 // threads started elsewhere that submit like workers (the render thread)
+
+enum JobPriority
+{
+    JOB_PRIORITY_HIGH, // frame critical (recording, culling), helped with by wait()
+    JOB_PRIORITY_LOW,  // background work (decoding), only picked up by idle workers
+    JOB_PRIORITY_COUNT
+};
+
+struct Job;
+class JobDeque;
+
+// Counts unfinished jobs submitted against it. Jobs can be chained onto it as continuations.
+// Only destroy it once wait() has returned (or isDone() is true).
+class JobCounter
+{
+public:
+    JobCounter();
+    bool isDone() const;
+
+private:
+    friend class JobSystem;
+    std::atomic<uint32_t> m_pending;
+    mutable std::mutex m_mutex; // continuations, held while the last job retires
+    std::vector<Job*> m_continuations;
+};
+
+// Work stealing scheduler: every worker owns a lock free deque per priority, pushing and popping
+// its own jobs at one end while idle workers steal from the other. The thread calling init()
+// becomes worker 0 and only runs jobs while it's inside wait() or parallelFor(), so does an
+// attached thread. Submitting from either is wait free, other threads go through a locked queue.
+class JobSystem
+{
+public:
+    void init(uint32_t workerCount = 0); // 0: one per core, counting the main thread
+    void cleanup(); // finishes queued jobs first
+
+    void submit(std::function<void()> function, JobCounter* counter = nullptr, JobPriority priority = JOB_PRIORITY_HIGH);
+    // Queued once dependency reaches zero, no thread blocks on it
+    void submitAfter(JobCounter& dependency, std::function<void()> function, JobCounter* counter = nullptr, JobPriority priority = JOB_PRIORITY_HIGH);
+    // Splits [0, count) into ranges starting at multiples of grain and returns once all have run
+    void parallelFor(uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& function);
+    // Runs high priority jobs until counter reaches zero
+    void wait(JobCounter& counter);
+
+    uint32_t workerCount() const;
+
+    // Gives the calling thread deques and a pool of its own, before its first submit. Once all
+    // JOB_MAX_ATTACHED_THREADS are taken it stays on the locked queue
+    void attachThread();
+    void detachThread(); // before the thread exits, after waiting on everything it submitted
+
+private:
+    Job* allocate();
+    void schedule(Job* job);
+    void wake();
+    Job* findJob(uint32_t worker, JobPriority lowest);
+    void execute(Job* job);
+    void retire(JobCounter* counter);
+    void workerLoop(uint32_t worker);
+
+    uint32_t m_workerCount;
+    uint32_t m_ownerCount; // workers, then the attached thread slots
+    std::thread* m_threads; // workers 1..m_workerCount-1
+    JobDeque* m_deques; // [owner * JOB_PRIORITY_COUNT + priority]
+    Job* m_pools; // [owner * JOB_POOL_SIZE]
+    uint32_t* m_poolHeads; // only touched by the owner
+
+    std::mutex m_attachMutex;
+    bool m_attached[JOB_MAX_ATTACHED_THREADS];
+
+    std::mutex m_injectedMutex; // submissions from non worker threads
+    std::deque<Job*> m_injected[JOB_PRIORITY_COUNT];
+    std::atomic<uint32_t> m_injectedCount;
+
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<uint32_t> m_sleeping;
+    bool m_stopping;
+};
+
+#endif /* JOB_SYSTEM_H */
@@ -0,0 +1,232 @@
+#include "Profiler.h"
+
+#include <assert.h>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#define PROFILE_MAX_DEPTH 64
+
+struct ProfileThread
+{
+    char name[32];
+    ProfileEvent events[PROFILE_EVENTS_PER_THREAD];
+    std::atomic<uint64_t> head; // events ever written, the latest is at head - 1
+
+    // Open zones, owner only
+    uint32_t depth;
+    const char* names[PROFILE_MAX_DEPTH];
+    uint64_t starts[PROFILE_MAX_DEPTH];
+};
+
+static thread_local ProfileThread* t_thread = nullptr;
+static thread_local char t_threadName[32] = {};
+static thread_local bool t_unprofiled = false; // registered too late, its zones are dropped
+
+ProfileThread** Profiler::m_threads;
+uint32_t Profiler::m_maxThreads;
+std::atomic<uint32_t> Profiler::m_threadCount;
+std::mutex Profiler::m_registerMutex;
+ProfileThread* Profiler::m_gpu;
+ProfileFrame Profiler::m_frames[PROFILE_FRAMES];
+uint64_t Profiler::m_frame;
+std::atomic<bool> Profiler::m_enabled;
+
+void Profiler::init()
+{
+    // The job system starts a worker per core
+    m_maxThreads = std::thread::hardware_concurrency() + PROFILE_EXTRA_THREADS;
+    m_threads = new ProfileThread*[m_maxThreads];
+    m_threadCount = 0;
+    m_frame = 0;
+    m_enabled = true;
+    memset(m_frames, 0, sizeof(m_frames));
+    m_gpu = registerThread("GPU");
+}
+
+void Profiler::cleanup()
+{
+    std::lock_guard<std::mutex> lock(m_registerMutex);
+    for (uint32_t i = 0; i < m_threadCount; ++i)
+    {
+        delete m_threads[i];
+    }
+    delete[] m_threads;
+    m_threads = nullptr;
+    m_threadCount = 0;
+    m_gpu = nullptr;
+    t_thread = nullptr; // the calling thread's, any others have exited
+    t_unprofiled = false;
+}
+
+uint64_t Profiler::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Profiler::setThreadName(const char* name)
+{
+    snprintf(t_threadName, sizeof(t_threadName), "%s", name);
+}
+
+void Profiler::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Profiler::isEnabled()
+{
+    return m_enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::beginFrame()
+{
+    uint64_t time = now();
+    if (m_frame > 0) m_frames[(m_frame - 1) % PROFILE_FRAMES].end = time;
+    m_frames[m_frame % PROFILE_FRAMES] = { m_frame, time, 0 };
+    m_frame++;
+}
+
+void Profiler::beginZone(const char* name)
+{
+    ProfileThread* profileThread = thread();
+    if (!profileThread) return;
+    assert( profileThread->depth < PROFILE_MAX_DEPTH && "Profile zones nested too deep" );
+    profileThread->names[profileThread->depth] = name;
+    profileThread->starts[profileThread->depth] = now();
+    profileThread->depth++;
+}
+
+void Profiler::endZone()
+{
+    ProfileThread* profileThread = thread();
+    if (!profileThread) return;
+    assert( profileThread->depth > 0 );
+    profileThread->depth--;
+    uint32_t depth = profileThread->depth;
+    push(profileThread, { profileThread->names[depth], profileThread->starts[depth], now(), depth });
+}
+
+void Profiler::gpuZone(const char* name, uint64_t start, uint64_t end, uint32_t depth)
+{
+    push(m_gpu, { name, start, end, depth });
+}
+
+uint32_t Profiler::threadCount()
+{
+    return m_threadCount.load(std::memory_order_acquire);
+}
+
+const char* Profiler::threadName(uint32_t thread)
+{
+    return m_threads[thread]->name;
+}
+
+uint32_t Profiler::events(uint32_t thread, uint64_t begin, uint64_t end, ProfileEvent* out, uint32_t max)
+{
+    ProfileThread* profileThread = m_threads[thread];
+    uint64_t head = profileThread->head.load(std::memory_order_acquire);
+    // Only the newer half, the owner would have to lap it while this runs to tear an event
+    uint64_t oldest = head > PROFILE_EVENTS_PER_THREAD / 2 ? head - PROFILE_EVENTS_PER_THREAD / 2 : 0;
+
+    uint32_t count = 0;
+    for (uint64_t i = oldest; i < head && count < max; ++i)
+    {
+        const ProfileEvent& event = profileThread->events[i & (PROFILE_EVENTS_PER_THREAD - 1)];
+        if (event.end > begin && event.start < end) out[count++] = event;
+    }
+    return count;
+}
+
+uint32_t Profiler::frames(ProfileFrame* out, uint32_t max)
+{
+    uint64_t first = m_frame > PROFILE_FRAMES ? m_frame - PROFILE_FRAMES : 0;
+    uint64_t last = m_frame > 0 ? m_frame - 1 : 0; // still running
+    if (last - first > max) first = last - max;
+
+    uint32_t count = 0;
+    for (uint64_t i = first; i < last; ++i)
+    {
+        out[count++] = m_frames[i % PROFILE_FRAMES];
+    }
+    return count;
+}
+
+bool Profiler::writeChromeTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (!file)
+    {
+        std::cerr << "Failed to open trace: " << path << std::endl;
+        return false;
+    }
+
+    std::vector<ProfileEvent> events(PROFILE_EVENTS_PER_THREAD / 2);
+    uint32_t threadCount = Profiler::threadCount();
+    uint64_t base = UINT64_MAX;
+    for (uint32_t thread = 0; thread < threadCount; ++thread)
+    {
+        uint32_t count = Profiler::events(thread, 0, UINT64_MAX, events.data(), events.size());
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (events[i].start < base) base = events[i].start;
+        }
+    }
+
+    // Complete ("X") events in microseconds, names are literals and need no escaping
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (uint32_t thread = 0; thread < threadCount; ++thread)
+    {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", thread, threadName(thread));
+        first = false;
+
+        uint32_t count = Profiler::events(thread, 0, UINT64_MAX, events.data(), events.size());
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const ProfileEvent& event = events[i];
+            fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name, thread, (event.start - base) / 1000.0, (event.end - event.start) / 1000.0);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
+
+ProfileThread* Profiler::thread()
+{
+    if (!t_thread && !t_unprofiled)
+    {
+        if (!t_threadName[0]) snprintf(t_threadName, sizeof(t_threadName), "Thread %u", threadCount());
+        t_thread = registerThread(t_threadName);
+        t_unprofiled = !t_thread;
+    }
+    return t_thread;
+}
+
+ProfileThread* Profiler::registerThread(const char* name)
+{
+    std::lock_guard<std::mutex> lock(m_registerMutex);
+    uint32_t index = m_threadCount.load(std::memory_order_relaxed);
+    if (index == m_maxThreads) return nullptr;
+
+    ProfileThread* profileThread = new ProfileThread();
+    snprintf(profileThread->name, sizeof(profileThread->name), "%s", name);
+    profileThread->head = 0;
+    profileThread->depth = 0;
+    m_threads[index] = profileThread;
+    m_threadCount.store(index + 1, std::memory_order_release);
+    return profileThread;
+}
+
+void Profiler::push(ProfileThread* profileThread, const ProfileEvent& event)
+{
+    uint64_t head = profileThread->head.load(std::memory_order_relaxed);
+    profileThread->events[head & (PROFILE_EVENTS_PER_THREAD - 1)] = event;
+    profileThread->head.store(head + 1, std::memory_order_release);
+}
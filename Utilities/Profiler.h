@@ -0,0 +1,98 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+
+#ifndef PROFILE
+#define PROFILE 1 // cheap enough to leave on, -DPROFILE=0 compiles the zones out
+#endif
+
+#define PROFILE_FRAMES 128 // frame boundaries kept for the timeline
+#define PROFILE_EVENTS_PER_THREAD 65536 // ring per thread, power of two, half of it can be read back
+#define PROFILE_EXTRA_THREADS 8 // tracks on top of one per core (GPU, render thread), threads past them go unprofiled
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#if PROFILE
+// name has to outlive the profiler, string literals
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#endif
+
+struct ProfileEvent
+{
+    const char* name;
+    uint64_t start; // Profiler::now() nanoseconds
+    uint64_t end;
+    uint32_t depth; // nesting on its thread
+};
+
+struct ProfileFrame
+{
+    uint64_t index;
+    uint64_t start;
+    uint64_t end; // start of the next frame, 0 while running
+};
+
+struct ProfileThread;
+
+// Scoped CPU zones go into a ring per thread that only that thread writes (no locks or atomics
+// beyond publishing the head), readers copy the recent end of it. GPU zones are fed in by the
+// renderer once their timestamps are read back, on a thread of their own.
+class Profiler
+{
+public:
+    static void init();
+    static void cleanup(); // after every profiled thread has exited
+
+    static uint64_t now();
+    static void setThreadName(const char* name); // copied, before the thread's first zone
+    static void setEnabled(bool enabled); // zones already open still close
+    static bool isEnabled();
+    static void beginFrame(); // main thread
+
+    static void beginZone(const char* name);
+    static void endZone();
+    static void gpuZone(const char* name, uint64_t start, uint64_t end, uint32_t depth); // render thread only
+
+    // Readers, main thread
+    static uint32_t threadCount();
+    static const char* threadName(uint32_t thread);
+    // Copies up to max of the thread's events overlapping [begin, end), returns how many
+    static uint32_t events(uint32_t thread, uint64_t begin, uint64_t end, ProfileEvent* out, uint32_t max);
+    // Oldest first, frames that haven't ended are left out
+    static uint32_t frames(ProfileFrame* out, uint32_t max);
+    // Everything still readable as Chrome Trace Event JSON (chrome://tracing, ui.perfetto.dev)
+    static bool writeChromeTrace(const char* path);
+
+private:
+    static ProfileThread* thread(); // nullptr once the table is full
+    static ProfileThread* registerThread(const char* name);
+    static void push(ProfileThread* thread, const ProfileEvent& event);
+
+    static ProfileThread** m_threads; // [m_maxThreads]
+    static uint32_t m_maxThreads;
+    static std::atomic<uint32_t> m_threadCount;
+    static std::mutex m_registerMutex;
+    static ProfileThread* m_gpu;
+    static ProfileFrame m_frames[PROFILE_FRAMES];
+    static uint64_t m_frame;
+    static std::atomic<bool> m_enabled;
+};
+
+class ProfileZone
+{
+public:
+    ProfileZone(const char* name) : m_active(Profiler::isEnabled()) { if (m_active) Profiler::beginZone(name); }
+    ~ProfileZone() { if (m_active) Profiler::endZone(); }
+
+private:
+    bool m_active;
+};
+
+#endif /* PROFILER_H */
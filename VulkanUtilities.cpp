@@ -85,7 +85,8 @@ QueueFamilyIndices findQueueFamilies(const VkPhysicalDevice& device, const VkSur
         }
 #endif
         VkBool32 presentSupport = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        if (surface != VK_NULL_HANDLE) vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
+        else presentSupport = (indices.bitmask & GRAPHICS_BIT) == GRAPHICS_BIT && indices.graphicsFamily == i; // nothing is presented
         if (presentSupport)
         {
             indices.presentFamily = i;
@@ -95,6 +96,14 @@ QueueFamilyIndices findQueueFamilies(const VkPhysicalDevice& device, const VkSur
         if (indices.isComplete()) break;
         i++;
     }
+#if TRANSFER_FAMILY
+    // No dedicated transfer family, graphics queues can always transfer
+    if ((indices.bitmask & TRANSFER_BIT) != TRANSFER_BIT && (indices.bitmask & GRAPHICS_BIT) == GRAPHICS_BIT)
+    {
+        indices.transferFamily = indices.graphicsFamily;
+        indices.bitmask |= TRANSFER_BIT;
+    }
+#endif
 
     return indices;
 }
@@ -133,6 +142,7 @@ bool isDeviceSuitable(const VkPhysicalDevice& device, const VkSurfaceKHR& surfac
     VkPhysicalDeviceFeatures supportedFeatures;
     vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
     if (!supportedFeatures.samplerAnisotropy) return false; // TODO: Enum properties
+    if (!supportedFeatures.shaderSampledImageArrayDynamicIndexing) return false;
 #if EDITOR
     if (!supportedFeatures.fillModeNonSolid) return false; // TODO: Enum properties
 #endif
@@ -143,6 +153,7 @@ bool isDeviceSuitable(const VkPhysicalDevice& device, const VkSurfaceKHR& surfac
     vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions);
     for (const auto& required : requiredExtensions)
     {
+        if (surface == VK_NULL_HANDLE && strcmp(required, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) continue;
         bool found = false;
         for (const auto& available : availableExtensions)
         {
@@ -155,10 +166,28 @@ bool isDeviceSuitable(const VkPhysicalDevice& device, const VkSurfaceKHR& surfac
         if (!found) return false;
     }
 
-    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
+    // Only chained once VK_EXT_descriptor_indexing is known to be there
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {};
+    indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+    VkPhysicalDeviceFeatures2 supportedFeatures2 = {};
+    supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    supportedFeatures2.pNext = &indexingFeatures;
+    vkGetPhysicalDeviceFeatures2(device, &supportedFeatures2);
+    if (!indexingFeatures.shaderSampledImageArrayNonUniformIndexing) return false;
+    if (!indexingFeatures.descriptorBindingSampledImageUpdateAfterBind) return false;
+    if (!indexingFeatures.descriptorBindingUpdateUnusedWhilePending) return false;
+    if (!indexingFeatures.descriptorBindingPartiallyBound) return false;
+    if (!indexingFeatures.descriptorBindingVariableDescriptorCount) return false;
+    if (!indexingFeatures.runtimeDescriptorArray) return false;
 
     QueueFamilyIndices indices = findQueueFamilies(device, surface);
-    return indices.isComplete() && swapChainSupport.presentModeCount > 0;
+    if (surface == VK_NULL_HANDLE) return indices.isComplete();
+
+    SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device, surface);
+    bool canPresent = swapChainSupport.presentModeCount > 0;
+    delete[] swapChainSupport.formats;
+    delete[] swapChainSupport.presentModes;
+    return indices.isComplete() && canPresent;
 }
 
 VkSurfaceFormatKHR selectSwapSurfaceFormat(const VkSurfaceFormatKHR* const availableFormats, int availableFormatCount)
@@ -213,16 +242,22 @@ VkShaderModule createShaderModule(const VkDevice& device, const char* const shad
     // file.read(buffer.data(), size);
     file.close();
 
+    // TODO: this will cause errors https://stackoverflow.com/questions/22770255/can-i-cast-an-unsigned-char-to-an-unsigned-int
+    VkShaderModule module = createShaderModule(device, buffer, size);
+    // createInfo.pCode = reinterpret_cast<const uint32_t*>(buffer.data());
+
+    delete[] buffer;
+    return module;
+}
+
+VkShaderModule createShaderModule(const VkDevice& device, const void* code, size_t size)
+{
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.codeSize = size;
-    // TODO: this will cause errors https://stackoverflow.com/questions/22770255/can-i-cast-an-unsigned-char-to-an-unsigned-int
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(buffer);
-    // createInfo.pCode = reinterpret_cast<const uint32_t*>(buffer.data());
+    createInfo.pCode = static_cast<const uint32_t*>(code);
     VkShaderModule module;
     assert( vkCreateShaderModule(device, &createInfo, nullptr, &module) == VK_SUCCESS );
-
-    delete[] buffer;
     return module;
 }
 
@@ -262,42 +297,46 @@ VkFormat findDepthFormat(VkPhysicalDevice physicalDevice)
         VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT);
 }
 
+bool isFormatSupported(VkPhysicalDevice physicalDevice, VkFormat format, VkFormatFeatureFlags features)
+{
+    VkFormatProperties props;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+    return (props.optimalTilingFeatures & features) == features;
+}
+
 bool hasStencilComponent(VkFormat format)
 {
     return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
 void createBuffer(VkDevice device,
-                  VkPhysicalDevice physicalDevice,
+                  MemoryAllocator& allocator,
                   VkDeviceSize size, 
                   VkBufferUsageFlags usage,
                   VkMemoryPropertyFlags properties,
                   VkBuffer& buffer,
-                  VkDeviceMemory& bufferMemory)
+                  Allocation& bufferMemory,
+                  AllocationStrategy strategy)
 {
     VkBufferCreateInfo bufferCreateInfo = {};
     bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferCreateInfo.size = size;
     bufferCreateInfo.usage = usage;
-#if TRANSFER_FAMILY
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
-#else
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-#endif
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE; // UploadQueue transfers ownership
     // bufferCreateInfo.flags = 0;
     assert( vkCreateBuffer(device, &bufferCreateInfo, nullptr, &buffer) == VK_SUCCESS );
 
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
 
-    VkMemoryAllocateInfo memAllocInfo = {};
-    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllocInfo.allocationSize = memRequirements.size;
-    // TODO: VK_MEMORY_PROPERTY_HOST_COHERENT_BIT worse performance. use flushing
-    memAllocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, properties);
-    // TODO: https://github.com/GPUOpen-LibrariesAndSDKs/VulkanMemoryAllocator
-    assert( vkAllocateMemory(device, &memAllocInfo, nullptr, &bufferMemory) == VK_SUCCESS );
-    vkBindBufferMemory(device, buffer, bufferMemory, 0); // TODO: should I assert on != success?
+    bufferMemory = allocator.allocate(memRequirements, properties, ALLOCATION_LINEAR, strategy);
+    assert( vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset) == VK_SUCCESS );
+}
+
+void destroyBuffer(VkDevice device, MemoryAllocator& allocator, VkBuffer buffer, Allocation& bufferMemory)
+{
+    vkDestroyBuffer(device, buffer, nullptr);
+    allocator.free(bufferMemory);
 }
 
 VkCommandBuffer beginCommandBuffer(VkDevice device, VkCommandPool commandPool)
@@ -333,88 +372,9 @@ void endCommandBuffer(VkDevice device, VkCommandPool commandPool, VkQueue queue,
     vkFreeCommandBuffers(device, commandPool, 1, &cmdBuffer);
 }
 
-void copyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkBuffer src, VkBuffer dst, VkDeviceSize size)
-{
-    VkCommandBuffer cmdBuffer = beginCommandBuffer(device, commandPool);
-
-    VkBufferCopy copy = {};
-    copy.srcOffset = 0;
-    copy.dstOffset = 0;
-    copy.size = size;
-    vkCmdCopyBuffer(cmdBuffer, src, dst, 1, &copy);
-
-    endCommandBuffer(device, commandPool, queue, cmdBuffer);
-}
-
-void copyImage(VkDevice device, VkCommandPool commandPool, VkQueue queue, 
-    VkBuffer texBuffer, VkImage image, uint32_t width, uint32_t height, VkFormat format)
-{
-    // TODO: combine operations into single command buffer + execute async (setupCmdBuffer + flushCmdBuffer)
-    VkImageMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    // Transition CPU Write
-    barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.srcAccessMask = 0;
-    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-    VkPipelineStageFlags dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    
-    VkCommandBuffer cmdBuffer = beginCommandBuffer(device, commandPool);
-    vkCmdPipelineBarrier(cmdBuffer, 
-        srcStage, dstStage, 
-        0, 
-        0, nullptr,
-        0, nullptr,
-        1, &barrier);
-    endCommandBuffer(device, commandPool, queue, cmdBuffer);
-
-    // Copy Image
-    VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = { width, height, 1 };
-
-    cmdBuffer = beginCommandBuffer(device, commandPool);
-    vkCmdCopyBufferToImage(cmdBuffer, texBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-    endCommandBuffer(device, commandPool, queue, cmdBuffer);
-
-    // Transition GPU Read
-    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-    srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-
-    cmdBuffer = beginCommandBuffer(device, commandPool);
-    vkCmdPipelineBarrier(cmdBuffer, 
-        srcStage, dstStage, 
-        0, 
-        0, nullptr,
-        0, nullptr,
-        1, &barrier);
-    endCommandBuffer(device, commandPool, queue, cmdBuffer);
-}
-
-void createImage(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t width, uint32_t height, 
+void createImage(VkDevice device, MemoryAllocator& allocator, uint32_t width, uint32_t height, 
                 VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-                VkImage& image, VkDeviceMemory& memory)
+                VkImage& image, Allocation& memory, uint32_t mipLevels)
 {
     VkImageCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -422,7 +382,7 @@ void createImage(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t widt
     createInfo.extent.width = width;
     createInfo.extent.height = height;
     createInfo.extent.depth = 1;
-    createInfo.mipLevels = 1;
+    createInfo.mipLevels = mipLevels;
     createInfo.arrayLayers = 1;
     createInfo.format = format;
     createInfo.tiling = tiling;
@@ -436,15 +396,18 @@ void createImage(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t widt
     VkMemoryRequirements memoryRequirements;
     vkGetImageMemoryRequirements(device, image, &memoryRequirements);
 
-    VkMemoryAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memoryRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memoryRequirements.memoryTypeBits, properties);
-    assert( vkAllocateMemory(device, &allocInfo, nullptr, &memory) == VK_SUCCESS );
-    vkBindImageMemory(device, image, memory, 0);
+    memory = allocator.allocate(memoryRequirements, properties,
+        tiling == VK_IMAGE_TILING_OPTIMAL ? ALLOCATION_OPTIMAL : ALLOCATION_LINEAR);
+    assert( vkBindImageMemory(device, image, memory.memory, memory.offset) == VK_SUCCESS );
+}
+
+void destroyImage(VkDevice device, MemoryAllocator& allocator, VkImage image, Allocation& memory)
+{
+    vkDestroyImage(device, image, nullptr);
+    allocator.free(memory);
 }
 
-void createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect, VkImageView& view)
+void createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect, VkImageView& view, uint32_t mipLevels)
 {
     VkImageViewCreateInfo viewCreateInfo = {};
     viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -459,7 +422,7 @@ void createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAsp
     
     viewCreateInfo.subresourceRange.aspectMask = aspect;
     viewCreateInfo.subresourceRange.baseMipLevel = 0;
-    viewCreateInfo.subresourceRange.levelCount = 1;
+    viewCreateInfo.subresourceRange.levelCount = mipLevels;
     viewCreateInfo.subresourceRange.baseArrayLayer = 0;
     viewCreateInfo.subresourceRange.layerCount = 1;
 
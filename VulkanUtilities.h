@@ -1,9 +1,12 @@
 #ifndef VULKAN_UTILITIES_H
 #define VULKAN_UTILITIES_H
 #include <vulkan/vulkan.h>
+#include "Rendering/MemoryAllocator.h"
 
+// Swapchain first, headless devices (no surface) skip it
 const char* const requiredExtensions[] = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
 };
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
@@ -30,7 +33,7 @@ void constructDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& creat
 
 #define GRAPHICS_BIT  0b00000001
 #define PRESENT_BIT   0b00000010
-#define TRANSFER_BIT  0b00000011
+#define TRANSFER_BIT  0b00000100
 struct QueueFamilyIndices 
 {
     uint8_t bitmask = 0;
@@ -52,6 +55,7 @@ struct QueueFamilyIndices
     }    
 };
 
+// surface can be VK_NULL_HANDLE when headless, presentFamily is then the graphics family
 QueueFamilyIndices findQueueFamilies(const VkPhysicalDevice& device, const VkSurfaceKHR& surface);
 
 struct SwapChainSupportDetails
@@ -74,10 +78,12 @@ VkPresentModeKHR selectSwapPresentMode(const VkPresentModeKHR* const availablePr
 VkExtent2D selectSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, uint32_t width, uint32_t height);
 
 VkShaderModule createShaderModule(const VkDevice& device, const char* const shaderPath);
+VkShaderModule createShaderModule(const VkDevice& device, const void* code, size_t size); // 4 byte aligned
 
 uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 
 VkFormat findDepthFormat(VkPhysicalDevice physicalDevice);
+bool isFormatSupported(VkPhysicalDevice physicalDevice, VkFormat format, VkFormatFeatureFlags features); // optimal tiling
 
 bool hasStencilComponent(VkFormat format);
 
@@ -85,19 +91,19 @@ VkCommandBuffer beginCommandBuffer(VkDevice device, VkCommandPool commandPool);
 void endCommandBuffer(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkCommandBuffer cmdBuffer);
 
 void createBuffer(VkDevice device,
-                  VkPhysicalDevice physicalDevice,
+                  MemoryAllocator& allocator,
                   VkDeviceSize size, 
                   VkBufferUsageFlags usage,
                   VkMemoryPropertyFlags properties,
                   VkBuffer& buffer,
-                  VkDeviceMemory& bufferMemory);
-void copyBuffer(VkDevice device, VkCommandPool commandPool, VkQueue queue, 
-                VkBuffer src, VkBuffer dst, VkDeviceSize size);
-void copyImage(VkDevice device, VkCommandPool commandPool, VkQueue queue, VkBuffer texBuffer, VkImage image, uint32_t width, uint32_t height, VkFormat format);
+                  Allocation& bufferMemory,
+                  AllocationStrategy strategy = ALLOCATION_FREE_LIST);
+void destroyBuffer(VkDevice device, MemoryAllocator& allocator, VkBuffer buffer, Allocation& bufferMemory);
 
-void createImage(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t width, uint32_t height, 
+void createImage(VkDevice device, MemoryAllocator& allocator, uint32_t width, uint32_t height, 
                 VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-                VkImage& image, VkDeviceMemory& memory);
-void createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect, VkImageView& view);
+                VkImage& image, Allocation& memory, uint32_t mipLevels = 1);
+void destroyImage(VkDevice device, MemoryAllocator& allocator, VkImage image, Allocation& memory);
+void createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspect, VkImageView& view, uint32_t mipLevels = 1);
 
 #endif /* VULKAN_UTILITIES_H */
\ No newline at end of file
@@ -2,12 +2,10 @@
 
 #include "Engine.h"
 
-int main()
+int main(int argc, char** argv)
 {
     Engine engine;
-    engine.run();
-
-    return EXIT_SUCCESS;
+    return engine.run(argc, argv);
 }
 
 